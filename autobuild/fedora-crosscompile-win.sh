@@ -120,6 +120,7 @@ fi
 for file in \
    av*.dll \
    ffmpeg.exe \
+   ffprobe.exe \
    iconv.dll \
    libatk-\*.dll \
    libatkmm-1.6-1.dll \
@@ -440,6 +441,7 @@ mkffmpeg()
         cp -rf ffmpeg-${FFMPEG_VERSION}-win${ARCH}-dev/lib/* ${PREFIX}/lib/
         $SZIP_BINARY x -y $CACHEDIR/ffmpeg-${FFMPEG_VERSION}-win${ARCH}-shared.zip
         cp -rf ffmpeg-${FFMPEG_VERSION}-win${ARCH}-shared/bin/ffmpeg.exe ${PREFIX}/bin
+        cp -rf ffmpeg-${FFMPEG_VERSION}-win${ARCH}-shared/bin/ffprobe.exe ${PREFIX}/bin
         cp -rf ffmpeg-${FFMPEG_VERSION}-win${ARCH}-shared/bin/*.dll ${PREFIX}/bin
         mkdir -p ${PREFIX}/share/ffmpeg/presets/ || true
         cp -rf ffmpeg-${FFMPEG_VERSION}-win${ARCH}-shared/presets/* /${PREFIX}/share/ffmpeg/presets/
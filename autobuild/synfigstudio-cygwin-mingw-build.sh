@@ -753,6 +753,7 @@ mkffmpeg()
         cp -rf ffmpeg-${FFMPEG_VERSION}-win${ARCH}-dev/lib/* ${MINGWPREFIX}/lib/
         $SZIP_BINARY x ../ffmpeg-${FFMPEG_VERSION}-win${ARCH}-shared.7z
         cp -rf ffmpeg-${FFMPEG_VERSION}-win${ARCH}-shared/bin/ffmpeg.exe ${MINGWPREFIX}/bin
+        cp -rf ffmpeg-${FFMPEG_VERSION}-win${ARCH}-shared/bin/ffprobe.exe ${MINGWPREFIX}/bin
         cp -rf ffmpeg-${FFMPEG_VERSION}-win${ARCH}-shared/bin/*.dll ${MINGWPREFIX}/bin
         mkdir -p ${MINGWPREFIX}/share/ffmpeg/presets/ || true
         cp -rf ffmpeg-${FFMPEG_VERSION}-win${ARCH}-shared/presets/* ${MINGWPREFIX}/share/ffmpeg/presets/
@@ -1080,6 +1081,7 @@ cp -rf $SRCPREFIX/synfig-studio/COPYING $DISTPREFIX/licenses/synfigstudio.txt
 for file in \
    av*.dll \
    ffmpeg.exe \
+   ffprobe.exe \
    iconv.dll \
    libatk-\*.dll \
    libatkmm-1.6-1.dll \
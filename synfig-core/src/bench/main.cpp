@@ -0,0 +1,312 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file bench/main.cpp
+**	\brief Rendering benchmarks on synthetic scenes
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include <glib.h>
+
+#include <ETL/stringf>
+
+#include <synfig/general.h>
+#include <synfig/main.h>
+#include <synfig/surface.h>
+#include <synfig/target_null.h>
+#include <synfig/target_tile.h>
+#include <synfig/rendering/renderer.h>
+#include <synfig/rendering/software/surfaceswpool.h>
+
+#include "scenarios.h"
+
+#endif
+
+using namespace synfig;
+using namespace bench;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+struct Options
+{
+	int width;
+	int height;
+	int frames;
+	int threads;
+	String renderer;
+	String target;
+	String output;
+	std::vector<String> scenarios;
+
+	Options():
+		width(1920), height(1080), frames(10), threads(4), renderer("software"), target("tile") { }
+};
+
+struct Result
+{
+	String name;
+	String error;
+	double ms_per_frame;
+	double pixels_per_second;
+	long long peak_rss_kb;
+	Result(): ms_per_frame(), pixels_per_second(), peak_rss_kb() { }
+};
+
+void
+print_usage(const char *binary)
+{
+	std::cerr
+		<< "Usage: " << binary << " [options]" << std::endl
+		<< "  --scenario <name>   run only this scenario (may be repeated)" << std::endl
+		<< "  --list              print list of scenarios" << std::endl
+		<< "  --width <num>       frame width (default 1920)" << std::endl
+		<< "  --height <num>      frame height (default 1080)" << std::endl
+		<< "  --frames <num>      frames to measure for each scenario (default 10)" << std::endl
+		<< "  --threads <num>     rendering threads (default 4)" << std::endl
+		<< "  --renderer <name>   rendering engine (default software)" << std::endl
+		<< "  --target <name>     'tile' renders each frame by Target_Tile into memory," << std::endl
+		<< "                      'null' renders all frames at once by Target_Scanline" << std::endl
+		<< "                      (frame pipelining and tiling of large frames, as synfig tool does)" << std::endl
+		<< "  --output <file>     write JSON report to file instead of stdout" << std::endl;
+}
+
+//! peak resident memory of process in kilobytes, or zero if not supported
+long long
+get_peak_rss_kb()
+{
+#ifndef _WIN32
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+		#ifdef __APPLE__
+		return usage.ru_maxrss/1024; // bytes on macOS
+		#else
+		return usage.ru_maxrss;
+		#endif
+	}
+#endif
+	return 0;
+}
+
+String
+escape(const String &s)
+{
+	String r;
+	for(String::const_iterator i = s.begin(); i != s.end(); ++i)
+		if (*i == '"' || *i == '\\') { r += '\\'; r += *i; } else
+		if ((unsigned char)*i < 32) r += ' '; else
+			r += *i;
+	return r;
+}
+
+bool
+render_frame(const Canvas::Handle &canvas, RendDesc desc, Time time, const String &renderer)
+{
+	synfig::Surface surface;
+	Target_Tile::Handle target = surface_target(&surface, renderer);
+	desc.set_time(time);
+	target->set_canvas(canvas);
+	target->set_rend_desc(&desc);
+	return target->render();
+}
+
+bool
+render_frames(const Canvas::Handle &canvas, RendDesc desc, Time begin, Time end, const String &renderer)
+{
+	Target_Scanline::Handle target(static_cast<Target_Scanline*>(Target_Null::create()));
+	target->set_engine(renderer);
+	desc.set_time_start(begin);
+	desc.set_time_end(end);
+	target->set_canvas(canvas);
+	target->set_rend_desc(&desc);
+	return target->render();
+}
+
+bool
+render(const Canvas::Handle &canvas, const RendDesc &desc, int first_frame, int last_frame, const Options &options)
+{
+	if (options.target == "null")
+		return render_frames( canvas, desc,
+			Time(first_frame)/desc.get_frame_rate(),
+			Time(last_frame)/desc.get_frame_rate(),
+			options.renderer );
+	for(int i = first_frame; i <= last_frame; ++i)
+		if (!render_frame(canvas, desc, Time(i)/desc.get_frame_rate(), options.renderer))
+			return false;
+	return true;
+}
+
+Result
+run_scenario(const Scenario &scenario, const Options &options)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	Result result;
+	result.name = scenario.name;
+
+	RendDesc desc;
+	desc.set_wh(options.width, options.height);
+	Real aspect = (Real)options.width/(Real)options.height;
+	desc.set_tl(Point(-4.0, 4.0/aspect));
+	desc.set_br(Point( 4.0, -4.0/aspect));
+	desc.set_frame_rate(24);
+
+	try {
+		Canvas::Handle canvas = scenario.build(desc);
+
+		// first frame is not measured: it fills caches and pools
+		if (!render(canvas, desc, 0, 0, options))
+			throw std::runtime_error("rendering failed");
+
+		Clock::time_point begin = Clock::now();
+		if (!render(canvas, desc, 1, options.frames, options))
+			throw std::runtime_error("rendering failed");
+		double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+		result.ms_per_frame = 1000.0*seconds/options.frames;
+		result.pixels_per_second = seconds > 0.0
+		                         ? (double)options.width*options.height*options.frames/seconds : 0.0;
+	} catch(const std::exception &e) {
+		result.error = e.what();
+	}
+	result.peak_rss_kb = get_peak_rss_kb();
+	return result;
+}
+
+void
+write_report(FILE *f, const Options &options, const std::vector<Result> &results)
+{
+	rendering::SurfaceSWPool::Stats pool = rendering::SurfaceSWPool::get_stats();
+
+	fprintf(f, "{\n");
+	fprintf(f, "  \"width\": %d,\n", options.width);
+	fprintf(f, "  \"height\": %d,\n", options.height);
+	fprintf(f, "  \"frames\": %d,\n", options.frames);
+	fprintf(f, "  \"threads\": %d,\n", options.threads);
+	fprintf(f, "  \"renderer\": \"%s\",\n", escape(options.renderer).c_str());
+	fprintf(f, "  \"target\": \"%s\",\n", escape(options.target).c_str());
+	fprintf(f, "  \"tile_size\": %d,\n", rendering::Renderer::get_tile_size());
+	fprintf(f, "  \"surface_pool\": { \"hits\": %lld, \"misses\": %lld, \"peak_bytes\": %lld },\n",
+		pool.hits, pool.misses, pool.peak_bytes);
+	fprintf(f, "  \"scenarios\": [\n");
+	for(std::vector<Result>::const_iterator i = results.begin(); i != results.end(); ++i) {
+		fprintf(f, "    { \"name\": \"%s\"", escape(i->name).c_str());
+		if (!i->error.empty())
+			fprintf(f, ", \"error\": \"%s\"", escape(i->error).c_str());
+		else
+			fprintf(f, ", \"ms_per_frame\": %.3f, \"pixels_per_second\": %.0f",
+				i->ms_per_frame, i->pixels_per_second);
+		// peak memory of process, it never decreases,
+		// so run single scenario to get its own peak
+		fprintf(f, ", \"peak_rss_kb\": %lld }%s\n",
+			i->peak_rss_kb, i + 1 == results.end() ? "" : ",");
+	}
+	fprintf(f, "  ]\n");
+	fprintf(f, "}\n");
+}
+
+} // end of anonymous namespace
+
+/* === E N T R Y P O I N T ================================================= */
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	bool list = false;
+
+	for(int i = 1; i < argc; ++i) {
+		String arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (arg == "--list")                      list = true; else
+		if (arg == "--scenario" && has_value)     options.scenarios.push_back(argv[++i]); else
+		if (arg == "--width"    && has_value)     options.width    = atoi(argv[++i]); else
+		if (arg == "--height"   && has_value)     options.height   = atoi(argv[++i]); else
+		if (arg == "--frames"   && has_value)     options.frames   = atoi(argv[++i]); else
+		if (arg == "--threads"  && has_value)     options.threads  = atoi(argv[++i]); else
+		if (arg == "--renderer" && has_value)     options.renderer = argv[++i]; else
+		if (arg == "--target"   && has_value)     options.target   = argv[++i]; else
+		if (arg == "--output"   && has_value)     options.output   = argv[++i]; else
+			{ print_usage(argv[0]); return 1; }
+	}
+
+	if (options.width <= 0 || options.height <= 0 || options.frames <= 0 || options.threads <= 0)
+		{ print_usage(argv[0]); return 1; }
+	if (options.target != "tile" && options.target != "null")
+		{ print_usage(argv[0]); return 1; }
+
+	if (list) {
+		for(std::vector<Scenario>::const_iterator i = get_scenarios().begin(); i != get_scenarios().end(); ++i)
+			std::cout << i->name << " - " << i->description << std::endl;
+		return 0;
+	}
+
+	// thread count of rendering queue is fixed at initialization
+	g_setenv("SYNFIG_RENDERING_THREADS", etl::strprintf("%d", options.threads).c_str(), TRUE);
+
+	synfig::Main synfig_main(etl::dirname(synfig::get_binary_path(argv[0])));
+
+	std::vector<Result> results;
+	for(std::vector<Scenario>::const_iterator i = get_scenarios().begin(); i != get_scenarios().end(); ++i) {
+		bool selected = options.scenarios.empty();
+		for(std::vector<String>::const_iterator j = options.scenarios.begin(); j != options.scenarios.end(); ++j)
+			if (*j == i->name) selected = true;
+		if (!selected) continue;
+
+		std::cerr << "running " << i->name << "..." << std::endl;
+		results.push_back(run_scenario(*i, options));
+	}
+
+	if (results.empty()) {
+		std::cerr << "no scenarios selected, see --list" << std::endl;
+		return 1;
+	}
+
+	FILE *f = options.output.empty() ? stdout : fopen(options.output.c_str(), "w");
+	if (!f) {
+		std::cerr << "cannot open " << options.output << std::endl;
+		return 1;
+	}
+	write_report(f, options, results);
+	if (f != stdout) fclose(f);
+
+	for(std::vector<Result>::const_iterator i = results.begin(); i != results.end(); ++i)
+		if (!i->error.empty()) return 1;
+	return 0;
+}
@@ -0,0 +1,299 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file bench/scenarios.cpp
+**	\brief Synthetic scenes for rendering benchmarks
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cmath>
+#include <stdexcept>
+
+#include <synfig/blinepoint.h>
+#include <synfig/blur.h>
+#include <synfig/gradient.h>
+#include <synfig/layer.h>
+#include <synfig/surface.h>
+#include <synfig/transformation.h>
+#include <synfig/layers/layer_bitmap.h>
+#include <synfig/rendering/software/surfacesw.h>
+#include <synfig/valuenodes/valuenode_const.h>
+#include <synfig/valuenodes/valuenode_linear.h>
+
+#include "scenarios.h"
+
+#endif
+
+using namespace synfig;
+using namespace bench;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+//! Fixed pseudo-random sequence, so scenes are the same on every platform
+class Random
+{
+private:
+	unsigned int seed;
+public:
+	explicit Random(unsigned int seed): seed(seed) { }
+	Real operator()() {
+		seed = seed*1103515245u + 12345u;
+		return (Real)((seed >> 8) & 0xffff)/(Real)0xffff;
+	}
+	Real operator()(Real min, Real max)
+		{ return min + (max - min)*(*this)(); }
+	Vector operator()(const Rect &rect)
+		{ return Vector((*this)(rect.minx, rect.maxx), (*this)(rect.miny, rect.maxy)); }
+	Color color(Real alpha = 1.0)
+		{ Color c((*this)(), (*this)(), (*this)(), alpha); return c; }
+};
+
+Layer::Handle
+create_layer(const String &name)
+{
+	Layer::Handle layer = Layer::create(name);
+	if (!layer)
+		throw std::runtime_error("layer '" + name + "' is not available");
+	return layer;
+}
+
+void
+set_param(const Layer::Handle &layer, const String &param, const ValueBase &value)
+{
+	if (!layer->set_param(param, value))
+		throw std::runtime_error("cannot set param '" + param + "' of layer '" + layer->get_name() + "'");
+}
+
+Rect
+get_rect(const RendDesc &desc)
+{
+	Rect r(desc.get_tl(), desc.get_br());
+	return r;
+}
+
+Canvas::Handle
+create_canvas(const RendDesc &desc)
+{
+	Canvas::Handle canvas = Canvas::create();
+	canvas->rend_desc() = desc;
+	return canvas;
+}
+
+Layer::Handle
+create_circle(Random &random, const Rect &rect, Real radius)
+{
+	Layer::Handle layer = create_layer("circle");
+	set_param(layer, "color", random.color());
+	set_param(layer, "origin", random(rect));
+	set_param(layer, "radius", radius);
+	return layer;
+}
+
+Layer::Handle
+create_group(const Canvas::Handle &parent, Canvas::Handle &sub_canvas, const Transformation &transformation = Transformation())
+{
+	sub_canvas = Canvas::create_inline(parent);
+	Layer::Handle layer = create_layer("group");
+	set_param(layer, "canvas", sub_canvas);
+	set_param(layer, "transformation", transformation);
+	return layer;
+}
+
+Gradient
+create_gradient(Random &random)
+	{ return Gradient(random.color(), random.color(0.0), random.color()); }
+
+Canvas::Handle
+build_outlines(const RendDesc &desc)
+{
+	Random random(1);
+	Canvas::Handle canvas = create_canvas(desc);
+	Rect rect = get_rect(desc);
+	for(int i = 0; i < 300; ++i) {
+		std::vector<BLinePoint> bline(8);
+		Vector center = random(rect);
+		for(int j = 0; j < (int)bline.size(); ++j) {
+			Real a = 2.0*PI*j/bline.size();
+			Real r = random(0.2, 1.0);
+			bline[j].set_vertex(center + Vector(r*cos(a), r*sin(a)));
+			bline[j].set_tangent(Vector(-r*sin(a), r*cos(a))*random(0.5, 2.0));
+			bline[j].set_width(random(0.2, 1.0));
+		}
+		Layer::Handle layer = create_layer("outline");
+		set_param(layer, "bline", ValueBase(bline, true));
+		set_param(layer, "width", random(0.02, 0.1));
+		set_param(layer, "color", random.color());
+		canvas->push_back(layer);
+	}
+	return canvas;
+}
+
+Canvas::Handle
+build_nested_groups(const RendDesc &desc)
+{
+	Random random(2);
+	Canvas::Handle canvas = create_canvas(desc);
+	Rect rect = get_rect(desc);
+	Canvas::Handle current = canvas;
+	for(int i = 0; i < 40; ++i) {
+		Canvas::Handle sub_canvas;
+		Layer::Handle group = create_group( current, sub_canvas,
+			Transformation(Vector(0.02, 0.0), Angle::deg(5), Angle::deg(0), Vector(0.98, 0.98)) );
+		set_param(group, "amount", Real(0.95));
+		current->push_back(create_circle(random, rect, 0.5));
+		current->push_back(group);
+		current = sub_canvas;
+	}
+	current->push_back(create_circle(random, rect, 1.0));
+	return canvas;
+}
+
+Canvas::Handle
+build_big_blur(const RendDesc &desc)
+{
+	Random random(3);
+	Canvas::Handle canvas = create_canvas(desc);
+	Rect rect = get_rect(desc);
+	const int types[] = { Blur::FASTGAUSSIAN, Blur::GAUSSIAN, Blur::BOX };
+	for(int i = 0; i < (int)(sizeof(types)/sizeof(types[0])); ++i) {
+		Layer::Handle blur = create_layer("blur");
+		set_param(blur, "size", Vector(0.5, 0.5)*(i + 1));
+		set_param(blur, "type", types[i]);
+		canvas->push_back(blur);
+		for(int j = 0; j < 10; ++j)
+			canvas->push_back(create_circle(random, rect, random(0.2, 1.0)));
+	}
+	return canvas;
+}
+
+Canvas::Handle
+build_gradients(const RendDesc &desc)
+{
+	Random random(4);
+	Canvas::Handle canvas = create_canvas(desc);
+	Rect rect = get_rect(desc);
+	for(int i = 0; i < 60; ++i) {
+		Layer::Handle layer;
+		if (i % 2) {
+			layer = create_layer("linear_gradient");
+			set_param(layer, "p1", random(rect));
+			set_param(layer, "p2", random(rect));
+		} else {
+			layer = create_layer("radial_gradient");
+			set_param(layer, "center", random(rect));
+			set_param(layer, "radius", random(0.5, 3.0));
+		}
+		set_param(layer, "gradient", create_gradient(random));
+		set_param(layer, "amount", Real(0.3));
+		canvas->push_back(layer);
+	}
+	return canvas;
+}
+
+Canvas::Handle
+build_bitmaps(const RendDesc &desc)
+{
+	Random random(5);
+	Canvas::Handle canvas = create_canvas(desc);
+	Rect rect = get_rect(desc);
+
+	const int size = 512;
+	rendering::SurfaceResource::Handle surface = new rendering::SurfaceResource();
+	surface->create(size, size);
+	{
+		rendering::SurfaceResource::LockWrite<rendering::SurfaceSW> lock(surface);
+		synfig::Surface &s = lock->get_surface();
+		for(int y = 0; y < size; ++y)
+			for(int x = 0; x < size; ++x)
+				s[y][x] = Color( (Real)x/size, (Real)y/size,
+					((x/32 + y/32) % 2) ? 1.0 : 0.0,
+					0.5 + 0.5*sin(0.05*x)*cos(0.05*y) ).premult_alpha();
+	}
+
+	for(int i = 0; i < 20; ++i) {
+		Canvas::Handle sub_canvas;
+		Layer::Handle group = create_group( canvas, sub_canvas,
+			Transformation( random(rect), Angle::deg(random(0, 360)),
+				            Angle::deg(random(-20, 20)), Vector(1, 1)*random(0.5, 2.0) ));
+
+		etl::handle<Layer_Bitmap> bitmap = new Layer_Bitmap();
+		bitmap->rendering_surface = surface;
+		set_param(bitmap, "tl", Point(-1, 1));
+		set_param(bitmap, "br", Point(1, -1));
+		sub_canvas->push_back(bitmap);
+		canvas->push_back(group);
+	}
+	return canvas;
+}
+
+Canvas::Handle
+build_motion_blur(const RendDesc &desc)
+{
+	Random random(6);
+	Canvas::Handle canvas = create_canvas(desc);
+	Rect rect = get_rect(desc);
+
+	Layer::Handle motion_blur = create_layer("MotionBlur");
+	set_param(motion_blur, "aperture", Time(0.5));
+	canvas->push_back(motion_blur);
+
+	for(int i = 0; i < 10; ++i) {
+		Layer::Handle circle = create_circle(random, rect, random(0.2, 0.6));
+		ValueNode_Linear::Handle origin = ValueNode_Linear::create(circle->get_param("origin"));
+		origin->set_link("slope", ValueNode_Const::create(Vector(random(-2, 2), random(-2, 2))));
+		circle->connect_dynamic_param("origin", ValueNode::LooseHandle(origin));
+		canvas->push_back(circle);
+	}
+	return canvas;
+}
+
+} // end of anonymous namespace
+
+/* === P R O C E D U R E S ================================================= */
+
+const std::vector<Scenario>&
+bench::get_scenarios()
+{
+	static const Scenario scenarios[] = {
+		{ "outlines",      "300 closed outlines with variable width",       build_outlines      },
+		{ "nested_groups", "40 nested groups with transformation and amount", build_nested_groups },
+		{ "big_blur",      "fast gaussian, gaussian and box blurs of large size", build_big_blur  },
+		{ "gradients",     "60 linear and radial gradients",                build_gradients     },
+		{ "bitmaps",       "20 transformed 512x512 bitmaps",                build_bitmaps       },
+		{ "motion_blur",   "motion blur of 10 moving circles",              build_motion_blur   }
+	};
+	static const std::vector<Scenario> list(
+		scenarios, scenarios + sizeof(scenarios)/sizeof(scenarios[0]) );
+	return list;
+}
+
+/* === M E T H O D S ======================================================= */
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,59 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file bench/scenarios.h
+**	\brief Synthetic scenes for rendering benchmarks
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_BENCH_SCENARIOS_H
+#define __SYNFIG_BENCH_SCENARIOS_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <vector>
+
+#include <synfig/canvas.h>
+#include <synfig/renddesc.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace bench {
+
+//! Scene built in code, so benchmark don't depend on any external files.
+//! Builders throw std::runtime_error when required layer is not available
+//! (module is not loaded).
+struct Scenario
+{
+	const char *name;
+	const char *description;
+	synfig::Canvas::Handle (*build)(const synfig::RendDesc &desc);
+};
+
+const std::vector<Scenario>& get_scenarios();
+
+} // END of namespace bench
+
+/* === E N D =============================================================== */
+
+#endif
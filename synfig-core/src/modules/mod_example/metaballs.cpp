@@ -42,6 +42,10 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/software/task/tasksw.h>
+
 #include "metaballs.h"
 
 #endif
@@ -62,6 +66,89 @@ SYNFIG_LAYER_SET_VERSION(Metaballs,"0.1");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class TaskMetaballs: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskMetaballs> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	Metaballs::Params params;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+};
+
+
+class TaskMetaballsSW: public TaskMetaballs, public rendering::TaskSW,
+	public rendering::TaskInterfaceBlendToTarget,
+	public rendering::TaskInterfaceSplit
+{
+public:
+	typedef etl::handle<TaskMetaballsSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual void on_target_set_as_source() {
+		Task::Handle &subtask = sub_task(0);
+		if ( subtask
+		  && subtask->target_surface == target_surface
+		  && !Color::is_straight(blend_method) )
+		{
+			trunc_by_bounds();
+			subtask->source_rect = source_rect;
+			subtask->target_rect = target_rect;
+		}
+	}
+
+	virtual Color::BlendMethodFlags get_supported_blend_methods() const
+		{ return Color::BLEND_METHODS_ALL; }
+
+	virtual bool run(RunParams&) const {
+		if (!is_valid())
+			return true;
+
+		Vector ppu = get_pixels_per_unit();
+
+		Matrix bounds_transfromation;
+		bounds_transfromation.m00 = ppu[0];
+		bounds_transfromation.m11 = ppu[1];
+		bounds_transfromation.m20 = target_rect.minx - ppu[0]*source_rect.minx;
+		bounds_transfromation.m21 = target_rect.miny - ppu[1]*source_rect.miny;
+
+		Matrix matrix = bounds_transfromation * transformation->matrix;
+		Matrix inv_matrix = matrix.get_inverted();
+
+		int tw = target_rect.get_width();
+		Vector dx = inv_matrix.axis_x();
+		Vector dy = inv_matrix.axis_y() - dx*(Real)tw;
+		Vector p = inv_matrix.get_transformed( Vector((Real)target_rect.minx, (Real)target_rect.miny) );
+
+		LockWrite la(this);
+		if (!la)
+			return false;
+
+		Surface::alpha_pen apen(la->get_surface().get_pen(target_rect.minx, target_rect.miny));
+		ColorReal amount = blend ? this->amount : ColorReal(1.0);
+		apen.set_blend_method(blend ? blend_method : Color::BLEND_COMPOSITE);
+		for(int iy = target_rect.miny; iy < target_rect.maxy; ++iy, p += dy, apen.inc_y(), apen.dec_x(tw))
+			for(int ix = target_rect.minx; ix < target_rect.maxx; ++ix, p += dx, apen.inc_x())
+				apen.put_value(params.gradient(Metaballs::totaldensity(params, p)), amount);
+
+		return true;
+	}
+};
+
+rendering::Task::Token TaskMetaballs::token(
+	DescAbstract<TaskMetaballs>("Metaballs") );
+rendering::Task::Token TaskMetaballsSW::token(
+	DescReal<TaskMetaballsSW, TaskMetaballs>("MetaballsSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -88,6 +175,8 @@ Metaballs::Metaballs():
 	
 	SET_INTERPOLATION_DEFAULTS();
 	SET_STATIC_DEFAULTS();
+
+	fill_params(params);
 }
 
 bool
@@ -160,7 +249,7 @@ Metaballs::get_param_vocab()const
 synfig::Layer::Handle
 Metaballs::hit_check(synfig::Context context, const synfig::Point &point)const
 {
-	Real density(totaldensity(point));
+	Real density(totaldensity(params, point));
 
 	if (density <= 0 || density > 1 || get_amount() == 0)
 		return context.hit_check(point);
@@ -176,10 +265,29 @@ Metaballs::hit_check(synfig::Context context, const synfig::Point &point)const
 	return const_cast<Metaballs*>(this);
 }
 
+void
+Metaballs::fill_params(Params &params)const
+{
+	params.gradient = param_gradient.get(Gradient());
+	params.centers = param_centers.get_list_of(synfig::Point());
+	params.radii = param_radii.get_list_of(synfig::Real());
+	params.weights = param_weights.get_list_of(synfig::Real());
+	params.threshold = param_threshold.get(Real());
+	params.threshold2 = param_threshold2.get(Real());
+	params.positive = param_positive.get(bool());
+}
+
+void
+Metaballs::on_static_param_changed(const String &param)
+{
+	Layer_Composite::on_static_param_changed(param);
+	fill_params(params);
+}
+
 Real
-Metaballs::densityfunc(const synfig::Point &p, const synfig::Point &c, Real R)const
+Metaballs::densityfunc(const Params &params, const synfig::Point &p, const synfig::Point &c, Real R)
 {
-	bool positive=param_positive.get(bool());
+	bool positive=params.positive;
 	
 	const Real dx = p[0] - c[0];
 	const Real dy = p[1] - c[1];
@@ -199,19 +307,19 @@ Metaballs::densityfunc(const synfig::Point &p, const synfig::Point &c, Real R)co
 }
 
 Real
-Metaballs::totaldensity(const Point &pos)const
+Metaballs::totaldensity(const Params &params, const Point &pos)
 {
-	std::vector<synfig::Point> centers(param_centers.get_list_of(synfig::Point()));
-	std::vector<synfig::Real> radii(param_radii.get_list_of(synfig::Real()));
-	std::vector<synfig::Real> weights(param_weights.get_list_of(synfig::Real()));
-	synfig::Real threshold=param_threshold.get(Real());
-	synfig::Real threshold2=param_threshold2.get(Real());
+	const std::vector<synfig::Point> &centers = params.centers;
+	const std::vector<synfig::Real> &radii = params.radii;
+	const std::vector<synfig::Real> &weights = params.weights;
+	synfig::Real threshold = params.threshold;
+	synfig::Real threshold2 = params.threshold2;
 
 	Real density = 0;
 
 	//sum up weighted functions
 	for(unsigned int i=0;i<centers.size();i++)
-		density += weights[i] * densityfunc(pos,centers[i], radii[i]);
+		density += weights[i] * densityfunc(params, pos, centers[i], radii[i]);
 
 	return (density - threshold) / (threshold2 - threshold);
 }
@@ -219,21 +327,19 @@ Metaballs::totaldensity(const Point &pos)const
 Color
 Metaballs::get_color(Context context, const Point &pos)const
 {
-	Gradient gradient=param_gradient.get(Gradient());
 	if(get_amount()==1.0 && get_blend_method()==Color::BLEND_STRAIGHT)
-		return gradient(totaldensity(pos));
+		return params.gradient(totaldensity(params, pos));
 	else
-		return Color::blend(gradient(totaldensity(pos)),context.get_color(pos),get_amount(),get_blend_method());
+		return Color::blend(params.gradient(totaldensity(params, pos)),context.get_color(pos),get_amount(),get_blend_method());
 }
 
 CairoColor
 Metaballs::get_cairocolor(Context context, const Point &pos)const
 {
-	Gradient gradient=param_gradient.get(Gradient());
 	if(get_amount()==1.0 && get_blend_method()==Color::BLEND_STRAIGHT)
-		return CairoColor(gradient(totaldensity(pos)));
+		return CairoColor(params.gradient(totaldensity(params, pos)));
 	else
-		return CairoColor::blend(CairoColor(gradient(totaldensity(pos))),context.get_cairocolor(pos),get_amount(),get_blend_method());
+		return CairoColor::blend(CairoColor(params.gradient(totaldensity(params, pos))),context.get_cairocolor(pos),get_amount(),get_blend_method());
 }
 
 
@@ -242,8 +348,6 @@ Metaballs::accelerated_render(Context context,Surface *surface,int quality, cons
 {
 	RENDER_TRANSFORMED_IF_NEED(__FILE__, __LINE__)
 
-	Gradient gradient=param_gradient.get(Gradient());
-	
 	// Width and Height of a pixel
 	const Point /*br(renddesc.get_br()),*/ tl(renddesc.get_tl());
 	const int 	 w(renddesc.get_w()), 	h(renddesc.get_h());
@@ -263,7 +367,7 @@ Metaballs::accelerated_render(Context context,Surface *surface,int quality, cons
 	{
 		pos[0] = tl[0];
 		for(int x = 0; x < w; x++, pos[0] += pw)
-			(*surface)[y][x] = Color::blend(gradient(totaldensity(pos)),(*surface)[y][x],get_amount(),get_blend_method());
+			(*surface)[y][x] = Color::blend(params.gradient(totaldensity(params, pos)),(*surface)[y][x],get_amount(),get_blend_method());
 	}
 
 	// Mark our progress as finished
@@ -272,3 +376,11 @@ Metaballs::accelerated_render(Context context,Surface *surface,int quality, cons
 
 	return true;
 }
+
+rendering::Task::Handle
+Metaballs::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	TaskMetaballs::Handle task(new TaskMetaballs());
+	task->params = params;
+	return task;
+}
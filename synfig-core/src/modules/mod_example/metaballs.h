@@ -43,6 +43,18 @@ class Metaballs : public synfig::Layer_Composite, public synfig::Layer_NoDeform
 {
 	SYNFIG_LAYER_MODULE_EXT
 
+public:
+	struct Params {
+		synfig::Gradient gradient;
+		std::vector<synfig::Point> centers;
+		std::vector<synfig::Real> radii;
+		std::vector<synfig::Real> weights;
+		synfig::Real threshold;
+		synfig::Real threshold2;
+		bool positive;
+		inline Params(): threshold(), threshold2(), positive() { }
+	};
+
 private:
 	//! Parameter: (Gradient)
 	synfig::ValueBase param_gradient;
@@ -59,11 +71,15 @@ private:
 	//! Parameter: (bool)
 	synfig::ValueBase param_positive;
 
-	synfig::Real densityfunc(const synfig::Point &p, const synfig::Point &c, synfig::Real R)const;
+	void fill_params(Params &params)const;
 
-	synfig::Real totaldensity(const synfig::Point &pos)const;
+	//! Parameters of color functions, updated on every change of layer parameters
+	Params params;
+
+	static synfig::Real densityfunc(const Params &params, const synfig::Point &p, const synfig::Point &c, synfig::Real R);
 
 public:
+	static synfig::Real totaldensity(const Params &params, const synfig::Point &pos);
 
 	Metaballs();
 
@@ -79,6 +95,10 @@ public:
 	virtual Vocab get_param_vocab()const;
 
 	virtual synfig::Layer::Handle hit_check(synfig::Context context, const synfig::Point &point)const;
+
+protected:
+	virtual void on_static_param_changed(const synfig::String &param);
+	virtual synfig::rendering::Task::Handle build_composite_task_vfunc(synfig::ContextParams context_params)const;
 }; // END of class Metaballs
 
 /* === E N D =============================================================== */
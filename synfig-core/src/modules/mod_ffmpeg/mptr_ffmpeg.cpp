@@ -33,6 +33,8 @@
 #endif
 
 #include "mptr_ffmpeg.h"
+#include <algorithm>
+#include <cassert>
 #include <cstdio>
 #include <sys/types.h>
 #include <synfig/general.h>
@@ -49,7 +51,9 @@
 #if HAVE_FCNTL_H
  #include <fcntl.h>
 #endif
+#include <csignal>
 #include <iostream>
+#include <ETL/misc>
 #endif
 
 /* === M A C R O S ========================================================= */
@@ -81,176 +85,349 @@ bool ffmpeg_mptr::is_animated()
 }
 
 bool
-ffmpeg_mptr::seek_to(const Time& time)
+ffmpeg_mptr::open_process(const std::vector<std::string> &args)
 {
-	//if(frame<cur_frame || !file)
-	//{
-		if(file)
-		{
-#if defined(WIN32_PIPE_TO_PROCESSES)
-			_pclose(file);
-#elif defined(UNIX_PIPE_TO_PROCESSES)
-			fclose(file);
-			int status;
-			waitpid(pid,&status,0);
-#endif
-		}
-		
-		// FIXME: 24 fps is hardcoded now, but in fact we have to get it from canvas
-		//float position = (frame+1)/24; // ffmpeg didn't work with 0 frame
-		//float position = 1000/24; // ffmpeg didn't work with 0 frame
-		const std::string position = time.get_string(Time::FORMAT_NORMAL);
+	assert(!file && !args.empty());
 
 #if defined(WIN32_PIPE_TO_PROCESSES)
 
-		string command;
-		
-		String binary_path = synfig::get_binary_path("");
-		if (binary_path != "")
-			binary_path = etl::dirname(binary_path)+ETL_DIRECTORY_SEPARATOR;
-		binary_path += "ffmpeg.exe";
+	String binary_path = synfig::get_binary_path("");
+	if (binary_path != "")
+		binary_path = etl::dirname(binary_path)+ETL_DIRECTORY_SEPARATOR;
+	binary_path += args.front() + ".exe";
+
+	string command = "\"" + binary_path + "\"";
+	for(std::vector<std::string>::const_iterator i = args.begin() + 1; i != args.end(); ++i)
+		command += " \"" + *i + "\"";
 
-		command=strprintf("\"%s\" -ss %s -i \"%s\" -vframes 1 -an -f image2pipe -vcodec ppm -\n", binary_path.c_str(), position.c_str(), identifier.filename.c_str());
-		
-		// This covers the dumb cmd.exe behavior.
-		// See: http://eli.thegreenplace.net/2011/01/28/on-spaces-in-the-paths-of-programs-and-files-on-windows/
-		command = "\"" + command + "\"";
+	// This covers the dumb cmd.exe behavior.
+	// See: http://eli.thegreenplace.net/2011/01/28/on-spaces-in-the-paths-of-programs-and-files-on-windows/
+	command = "\"" + command + "\"";
 
-		file=_popen(command.c_str(),POPEN_BINARY_READ_TYPE);
+	file=_popen(command.c_str(),POPEN_BINARY_READ_TYPE);
 
 #elif defined(UNIX_PIPE_TO_PROCESSES)
 
-		int p[2];
+	// prepare arguments before fork, child process should only call exec
+	std::vector<const char*> argv;
+	for(std::vector<std::string>::const_iterator i = args.begin(); i != args.end(); ++i)
+		argv.push_back(i->c_str());
+	argv.push_back(NULL);
 
-		if (pipe(p)) {
-			cerr<<"Unable to open pipe to ffmpeg (no pipe)"<<endl;
-			return false;
-		};
+	int p[2];
 
-		pid = fork();
+	if (pipe(p)) {
+		cerr<<"Unable to open pipe to "<<args.front()<<" (no pipe)"<<endl;
+		return false;
+	};
 
-		if (pid == -1) {
-			cerr<<"Unable to open pipe to ffmpeg (pid == -1)"<<endl;
-			return false;
-		}
+	pid = fork();
 
-		if (pid == 0){
-			// Child process
-			// Close pipein, not needed
-			close(p[0]);
-			// Dup pipein to stdout
-			if( dup2( p[1], STDOUT_FILENO ) == -1 ){
-				cerr<<"Unable to open pipe to ffmpeg (dup2( p[1], STDOUT_FILENO ) == -1)"<<endl;
-				return false;
-			}
-			// Close the unneeded pipein
-			close(p[1]);
-			/*std::string command = strprintf("\"%s\" -ss '%s' -i \"%s\" -vframes 1 -an -f image2pipe -vcodec ppm -\n", "ffmpeg", position2, identifier.filename.c_str());
-			synfig::warning("ffmpeg command: '%s'", command.c_str());*/
-			execlp("ffmpeg", "ffmpeg", "-ss", position.c_str(), "-i", identifier.filename.c_str(), "-vframes", "1","-an", "-f", "image2pipe", "-vcodec", "ppm", "-", (const char *)NULL);
-			// We should never reach here unless the exec failed
-			cerr<<"Unable to open pipe to ffmpeg (exec failed)"<<endl;
+	if (pid == -1) {
+		close(p[0]);
+		close(p[1]);
+		cerr<<"Unable to open pipe to "<<args.front()<<" (pid == -1)"<<endl;
+		return false;
+	}
+
+	if (pid == 0){
+		// Child process
+		// Close pipein, not needed
+		close(p[0]);
+		// Dup pipein to stdout
+		if( dup2( p[1], STDOUT_FILENO ) == -1 ){
+			cerr<<"Unable to open pipe to "<<args.front()<<" (dup2( p[1], STDOUT_FILENO ) == -1)"<<endl;
 			_exit(1);
-		} else {
-			// Parent process
-			// Close pipeout, not needed
-			close(p[1]);
-			// Save pipein to file handle, will read from it later
-			file = fdopen(p[0], "rb");
 		}
+		// Close the unneeded pipein
+		close(p[1]);
+		execvp(argv.front(), const_cast<char* const*>(&argv.front()));
+		// We should never reach here unless the exec failed
+		cerr<<"Unable to open pipe to "<<args.front()<<" (exec failed)"<<endl;
+		_exit(1);
+	} else {
+		// Parent process
+		// Close pipeout, not needed
+		close(p[1]);
+		// Save pipein to file handle, will read from it later
+		file = fdopen(p[0], "rb");
+	}
 
 #else
 	#error There are no known APIs for creating child processes
 #endif
 
-		if(!file)
-		{
-			cerr<<"Unable to open pipe to ffmpeg"<<endl;
-			return false;
-		}
-		cur_frame=-1;
-	//}
-
-	//while(cur_frame<frame-1)
-	//{
-	//	cerr<<"Seeking to..."<<frame<<'('<<cur_frame<<')'<<endl;
-	//	if(!grab_frame())
-	//		return false;
-	//}
+	if(!file)
+	{
+		cerr<<"Unable to open pipe to "<<args.front()<<endl;
+		return false;
+	}
 	return true;
 }
 
-bool
-ffmpeg_mptr::grab_frame(void)
+void
+ffmpeg_mptr::close_process()
 {
 	if(!file)
+		return;
+#if defined(WIN32_PIPE_TO_PROCESSES)
+	_pclose(file);
+#elif defined(UNIX_PIPE_TO_PROCESSES)
+	fclose(file);
+	int status;
+	waitpid(pid,&status,0);
+	pid = -1;
+#endif
+	file = NULL;
+}
+
+bool
+ffmpeg_mptr::probe()
+{
+	if (probed)
+		return width > 0 && height > 0 && fps > 0;
+	probed = true;
+
+	std::vector<std::string> args;
+	args.push_back("ffprobe");
+	args.push_back("-v");
+	args.push_back("error");
+	args.push_back("-select_streams");
+	args.push_back("v:0");
+	args.push_back("-show_entries");
+	args.push_back("stream=width,height,r_frame_rate");
+	args.push_back("-of");
+	args.push_back("csv=p=0");
+	args.push_back(identifier.filename);
+	if (!open_process(args))
 	{
-		cerr<<"unable to open "<<identifier.filename.c_str()<<endl;
+		cerr<<"ffprobe is unavailable, "<<identifier.filename.c_str()<<" will be decoded frame by frame"<<endl;
 		return false;
 	}
-	int w,h;
-	float divisor;
-	char cookie[2];
-	cookie[0]=fgetc(file);
 
-	if(feof(file))
+	// output looks like "1920,1080,30000/1001"
+	char line[256] = { };
+	int w = 0, h = 0, num = 0, den = 0;
+	if (fgets(line, sizeof(line), file))
+		sscanf(line, "%d,%d,%d/%d", &w, &h, &num, &den);
+	close_process();
+
+	if (w <= 0 || h <= 0 || num <= 0 || den <= 0)
+	{
+		cerr<<"Unable to get video size and frame rate of "<<identifier.filename.c_str()<<", it will be decoded frame by frame"<<endl;
 		return false;
+	}
 
-	cookie[1]=fgetc(file);
+	width = w;
+	height = h;
+	fps = (float)num/(float)den;
+	rate = strprintf("%d/%d", num, den);
+	return true;
+}
 
-	if(cookie[0]!='P' || cookie[1]!='6')
-	{
-		cerr<<"stream not in PPM format \""<<cookie[0]<<cookie[1]<<'"'<<endl;
+bool
+ffmpeg_mptr::seek_to(int frame)
+{
+	close_stream();
+
+	// Decoder starts from given frame and then outputs all following frames
+	// at constant rate, so position of every frame in the pipe is known
+	// and sequential requests don't need to restart ffmpeg.
+	const std::string position = Time(frame/fps).get_string(Time::FORMAT_NORMAL);
+	const std::string size = strprintf("%dx%d", width, height);
+
+	std::vector<std::string> args;
+	args.push_back("ffmpeg");
+	args.push_back("-nostdin");
+	args.push_back("-loglevel");
+	args.push_back("error");
+	args.push_back("-ss");
+	args.push_back(position);
+	args.push_back("-i");
+	args.push_back(identifier.filename);
+	args.push_back("-an");
+	args.push_back("-r");
+	args.push_back(rate);
+	// force probed size, the reader relies on it
+	args.push_back("-s");
+	args.push_back(size);
+	args.push_back("-f");
+	args.push_back("rawvideo");
+	args.push_back("-pix_fmt");
+	args.push_back("rgba");
+	args.push_back("-");
+	if (!open_process(args))
 		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stream_begin = decoded_end = requested = frame;
+		stream_eof = false;
+		stop = false;
+		std::fill(ring_frame.begin(), ring_frame.end(), -1);
+	}
+	reader = std::thread(&ffmpeg_mptr::read_frames, this);
+	return true;
+}
+
+void
+ffmpeg_mptr::close_stream()
+{
+	if (reader.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		cond.notify_all();
+#if defined(UNIX_PIPE_TO_PROCESSES)
+		// reader may wait inside of fread for frame which is not needed anymore
+		if (pid > 0)
+			kill(pid, SIGTERM);
+#endif
+		reader.join();
 	}
+	close_process();
+}
+
+bool
+ffmpeg_mptr::grab_frame(std::vector<unsigned char> &buffer)
+{
+	buffer.resize(4*width*height);
+	return fread(&buffer.front(), 1, buffer.size(), file) == buffer.size();
+}
 
-	fgetc(file);
-	fscanf(file,"%d %d\n",&w,&h);
-	fscanf(file,"%f",&divisor);
-	fgetc(file);
+bool
+ffmpeg_mptr::grab_single_frame(const Time &time, synfig::Surface &surface)
+{
+	close_stream();
+
+	// One ffmpeg run per frame, slow but it needs neither ffprobe nor known size.
+	std::vector<std::string> args;
+	args.push_back("ffmpeg");
+	args.push_back("-nostdin");
+	args.push_back("-loglevel");
+	args.push_back("error");
+	args.push_back("-ss");
+	args.push_back(time.get_string(Time::FORMAT_NORMAL));
+	args.push_back("-i");
+	args.push_back(identifier.filename);
+	args.push_back("-vframes");
+	args.push_back("1");
+	args.push_back("-an");
+	args.push_back("-f");
+	args.push_back("image2pipe");
+	args.push_back("-vcodec");
+	args.push_back("ppm");
+	args.push_back("-");
+	if (!open_process(args))
+		return false;
 
-	if(feof(file))
+	int w = 0, h = 0, maxval = 0;
+	bool success = fscanf(file, "P6 %d %d %d", &w, &h, &maxval) == 3
+	            && w > 0 && h > 0 && maxval > 0 && maxval < 256
+	            && fgetc(file) != EOF;
+	if (!success)
+		cerr<<"stream not in PPM format"<<endl;
+
+	std::vector<unsigned char> buffer(3*w*h);
+	if (success && fread(&buffer.front(), 1, buffer.size(), file) != buffer.size())
+		success = false;
+	close_process();
+	if (!success)
 		return false;
 
-	frame.set_wh(w, h);
+	surface.set_wh(w, h);
+	const ColorReal k = 1/(ColorReal)maxval;
+	const unsigned char *src = &buffer.front();
+	for(int y = 0; y < h; ++y)
+	{
+		Color *dst = surface[y];
+		for(int x = 0; x < w; ++x, ++dst, src += 3)
+			*dst = Color(k*src[0], k*src[1], k*src[2]);
+	}
+	return true;
+}
+
+void
+ffmpeg_mptr::read_frames()
+{
+	std::vector<unsigned char> buffer;
 	const ColorReal k = 1/255.0;
-	for(int y = 0; y < frame.get_h(); ++y)
-		for(int x = 0; x < frame.get_w(); ++x)
+
+	while(true)
+	{
+		int index;
+		bool skip;
 		{
-			if(feof(file))
-				return false;
-			ColorReal r = k*(unsigned char)fgetc(file);
-			ColorReal g = k*(unsigned char)fgetc(file);
-			ColorReal b = k*(unsigned char)fgetc(file);
-			frame[y][x] = Color(r, g, b);
+			std::unique_lock<std::mutex> lock(mutex);
+			while(!stop && decoded_end >= requested + ring_ahead)
+				cond.wait(lock);
+			if (stop)
+				return;
+			index = decoded_end;
+			// frame will leave the ring before it can be requested, so don't convert it
+			skip = index < requested - ring_keep;
+			// release the slot, get_frame reads only slots marked with their frame
+			ring_frame[index % ring_size] = -1;
 		}
-	cur_frame++;
-	return true;
+
+		if (!grab_frame(buffer))
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stream_eof = true;
+			cond.notify_all();
+			return;
+		}
+
+		if (!skip)
+		{
+			Surface &decoded = ring[index % ring_size];
+			decoded.set_wh(width, height);
+			const unsigned char *src = &buffer.front();
+			for(int y = 0; y < height; ++y)
+			{
+				Color *dst = decoded[y];
+				for(int x = 0; x < width; ++x, ++dst, src += 4)
+					*dst = Color(k*src[0], k*src[1], k*src[2], k*src[3]);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stop)
+				return;
+			if (!skip)
+				ring_frame[index % ring_size] = index;
+			decoded_end = index + 1;
+		}
+		cond.notify_all();
+	}
 }
 
 ffmpeg_mptr::ffmpeg_mptr(const synfig::FileSystem::Identifier &identifier):
-	synfig::Importer(identifier)
+	synfig::Importer(identifier),
+	file(NULL),
+	fps(0),
+	width(0),
+	height(0),
+	probed(false),
+	ring(ring_size),
+	ring_frame(ring_size, -1),
+	stream_begin(0),
+	decoded_end(0),
+	requested(0),
+	stream_eof(false),
+	stop(false)
 {
 #ifdef HAVE_TERMIOS_H
 	tcgetattr (0, &oldtty);
 #endif
-	file=NULL;
-	fps=23.98;
-	cur_frame=-1;
 }
 
 ffmpeg_mptr::~ffmpeg_mptr()
 {
-	if(file)
-	{
-#if defined(WIN32_PIPE_TO_PROCESSES)
-		_pclose(file);
-#elif defined(UNIX_PIPE_TO_PROCESSES)
-		fclose(file);
-		int status;
-		waitpid(pid,&status,0);
-#endif
-	}
+	close_stream();
 #ifdef HAVE_TERMIOS_H
 	tcsetattr(0,TCSANOW,&oldtty);
 #endif
@@ -259,12 +436,47 @@ ffmpeg_mptr::~ffmpeg_mptr()
 bool
 ffmpeg_mptr::get_frame(synfig::Surface &surface, const synfig::RendDesc &/*renddesc*/, Time time, synfig::ProgressCallback *)
 {
-	synfig::warning("time: %f", (float)time);
-	if(!seek_to(time))
-		return false;
-	if(!grab_frame())
-		return false;
+	std::lock_guard<std::mutex> get_lock(get_mutex);
 
-	surface=frame;
-	return true;
+	// without size and frame rate the stream can't be split into frames
+	if (!probe())
+		return grab_single_frame(time, surface);
+
+	const int frame = std::max(0, (int)round_to_int(time*fps));
+	const int max_skip = std::max(ring_size, (int)round_to_int(max_skip_time*fps));
+
+	for(int attempt = 0; attempt < 2; ++attempt)
+	{
+		if (file)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			const int slot = frame % ring_size;
+			if (ring_frame[slot] == frame)
+			{
+				surface = ring[slot];
+				return true;
+			}
+
+			// continue current session for small jumps forward
+			if (frame >= decoded_end && frame <= decoded_end + max_skip)
+			{
+				requested = frame;
+				cond.notify_all();
+				while(decoded_end <= frame && !stream_eof)
+					cond.wait(lock);
+				if (ring_frame[slot] == frame)
+				{
+					surface = ring[slot];
+					return true;
+				}
+				if (stream_eof)
+					return false;
+			}
+		}
+
+		// backward or long jump, restart decoder at requested frame
+		if (!seek_to(frame))
+			return false;
+	}
+	return false;
 }
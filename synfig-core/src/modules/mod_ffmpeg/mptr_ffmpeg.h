@@ -32,6 +32,11 @@
 #include <synfig/importer.h>
 #include <sys/types.h>
 #include <cstdio>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #ifdef HAVE_TERMIOS_H
 #include <termios.h>
 #endif
@@ -47,20 +52,50 @@ class ffmpeg_mptr : public synfig::Importer
 {
 	SYNFIG_IMPORTER_MODULE_EXT
 public:
+	//! Count of decoded frames kept before the last requested one
+	static const int ring_keep = 4;
+	//! Count of frames decoded ahead of the last requested one
+	static const int ring_ahead = 4;
+	static const int ring_size = ring_keep + ring_ahead;
+	//! Forward jump (in seconds) that is still cheaper to decode through than to seek
+	static constexpr float max_skip_time = 2.f;
+
 private:
 #ifdef HAVE_FORK
 	pid_t pid = -1;
 #endif
 	FILE *file;
-	int cur_frame;
-	synfig::Surface frame;
+	std::string rate;
 	float fps;
+	int width;
+	int height;
+	bool probed;
 #ifdef HAVE_TERMIOS_H
 	struct termios oldtty;
 #endif
 
-	bool seek_to(const synfig::Time& time);
-	bool grab_frame(void);
+	// decode session, frames are numbered from start of video at probed fps
+	std::mutex get_mutex;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::thread reader;
+	std::vector<synfig::Surface> ring;
+	std::vector<int> ring_frame;
+	int stream_begin;
+	int decoded_end;
+	int requested;
+	bool stream_eof;
+	bool stop;
+
+	bool open_process(const std::vector<std::string> &args);
+	void close_process();
+
+	bool probe();
+	bool seek_to(int frame);
+	void close_stream();
+	bool grab_frame(std::vector<unsigned char> &buffer);
+	bool grab_single_frame(const synfig::Time &time, synfig::Surface &surface);
+	void read_frames();
 
 public:
 	ffmpeg_mptr(const synfig::FileSystem::Identifier &identifier);
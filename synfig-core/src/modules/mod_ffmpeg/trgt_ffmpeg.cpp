@@ -37,10 +37,15 @@
 #include <synfig/general.h>
 #include <synfig/soundprocessor.h>
 
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <glib/gstdio.h>
 #include <thread>
 
+#include <synfig/color/pixelformat.h>
+
 #include "trgt_ffmpeg.h"
 
 #if HAVE_SYS_WAIT_H
@@ -72,6 +77,31 @@ SYNFIG_TARGET_SET_NAME(ffmpeg_trgt,"ffmpeg");
 SYNFIG_TARGET_SET_EXT(ffmpeg_trgt,"mpg");
 SYNFIG_TARGET_SET_VERSION(ffmpeg_trgt,"0.1");
 
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+
+inline void
+put_uint16_le(unsigned char *dst, ColorReal x)
+{
+	unsigned int v = (unsigned int)(synfig::clamp(x, ColorReal(0), ColorReal(1))*65535.f + 0.5f);
+	dst[0] = (unsigned char)(v & 0xff);
+	dst[1] = (unsigned char)(v >> 8);
+}
+
+inline void
+put_float_le(unsigned char *dst, float x)
+{
+	uint32_t v;
+	memcpy(&v, &x, sizeof(v));
+	dst[0] = (unsigned char)(v & 0xff);
+	dst[1] = (unsigned char)((v >> 8) & 0xff);
+	dst[2] = (unsigned char)((v >> 16) & 0xff);
+	dst[3] = (unsigned char)(v >> 24);
+}
+
+}
+
 /* === M E T H O D S ======================================================= */
 
 ffmpeg_trgt::ffmpeg_trgt(const char *Filename, const synfig::TargetParam &params):
@@ -81,11 +111,13 @@ ffmpeg_trgt::ffmpeg_trgt(const char *Filename, const synfig::TargetParam &params
 	filename(Filename),
 	sound_filename(""),
 	buffer(NULL),
+	buffer_size(0),
 	color_buffer(NULL),
-	bitrate()
+	curr_scanline(0),
+	bitrate(),
+	raw_format(RAW_RGB24),
+	failed(false)
 {
-	set_alpha_mode(TARGET_ALPHA_MODE_FILL);
-
 	// Set default video codec and bitrate if they weren't given.
 	if (params.video_codec == "none")
 		video_codec = "mpeg1video";
@@ -96,6 +128,52 @@ ffmpeg_trgt::ffmpeg_trgt(const char *Filename, const synfig::TargetParam &params
 		bitrate = 200;
 	else
 		bitrate = params.bitrate;
+
+	// Mastering codecs get 16 bits per channel with alpha,
+	// others are fed by 8-bit RGB
+	if (video_codec == "prores_ks" || video_codec == "ffv1")
+		raw_format = RAW_RGBA64LE;
+
+	// Pixel format of the pipe may be forced, e.g. float for HDR masters
+	if (const char *s = getenv("SYNFIG_FFMPEG_RAW_FORMAT"))
+	{
+		const RawFormat formats[] = { RAW_RGB24, RAW_RGBA64LE, RAW_GBRPF32LE, RAW_GBRAPF32LE };
+		for(size_t i = 0; i < sizeof(formats)/sizeof(formats[0]); ++i)
+			if (String(s) == get_raw_format_name(formats[i]))
+				raw_format = formats[i];
+	}
+
+	set_alpha_mode(get_raw_format_alpha(raw_format) ? TARGET_ALPHA_MODE_KEEP : TARGET_ALPHA_MODE_FILL);
+}
+
+const char*
+ffmpeg_trgt::get_raw_format_name(RawFormat format)
+{
+	switch(format)
+	{
+		case RAW_RGBA64LE:   return "rgba64le";
+		case RAW_GBRPF32LE:  return "gbrpf32le";
+		case RAW_GBRAPF32LE: return "gbrapf32le";
+		default: break;
+	}
+	return "rgb24";
+}
+
+bool
+ffmpeg_trgt::get_raw_format_alpha(RawFormat format)
+	{ return format == RAW_RGBA64LE || format == RAW_GBRAPF32LE; }
+
+size_t
+ffmpeg_trgt::get_raw_format_pixel_size(RawFormat format)
+{
+	switch(format)
+	{
+		case RAW_RGBA64LE:   return 8;
+		case RAW_GBRPF32LE:  return 12;
+		case RAW_GBRAPF32LE: return 16;
+		default: break;
+	}
+	return 3;
 }
 
 ffmpeg_trgt::~ffmpeg_trgt()
@@ -241,10 +319,14 @@ ffmpeg_trgt::init(ProgressCallback *cb=NULL)
 		vargs.emplace_back(sound_filename);
 #endif
 	}
+	// Frames are piped as raw video, so size, rate and pixel format
+	// should be given explicitly
 	vargs.emplace_back("-f");
-	vargs.emplace_back("image2pipe");
-	vargs.emplace_back("-vcodec");
-	vargs.emplace_back("ppm");
+	vargs.emplace_back("rawvideo");
+	vargs.emplace_back("-pix_fmt");
+	vargs.emplace_back(get_raw_format_name(raw_format));
+	vargs.emplace_back("-s");
+	vargs.emplace_back(etl::strprintf("%dx%d", desc.get_w(), desc.get_h()));
 	vargs.emplace_back("-r");
 	vargs.emplace_back(etl::strprintf("%f", desc.get_frame_rate()));
 	vargs.emplace_back("-i");
@@ -263,6 +345,12 @@ ffmpeg_trgt::init(ProgressCallback *cb=NULL)
 		vargs.emplace_back("-qp");
 		vargs.emplace_back("0");
 	}
+	if (video_codec == "prores_ks") {
+		vargs.emplace_back("-profile:v");
+		vargs.emplace_back("4444");
+		vargs.emplace_back("-pix_fmt");
+		vargs.emplace_back("yuva444p10le");
+	}
 	vargs.emplace_back("-acodec");
 	// MPEG-1 cannot work with 'le' audio, it requires 'be'
 	vargs.emplace_back(video_codec == "mpeg1video" ? "pcm_s16be" : "pcm_s16le");
@@ -368,47 +456,103 @@ ffmpeg_trgt::init(ProgressCallback *cb=NULL)
 void
 ffmpeg_trgt::end_frame()
 {
-	//fprintf(file, " ");
-	fflush(file);
+	// whole frame is sent by one write call
+	if(file)
+	{
+		if(buffer && fwrite(buffer,1,buffer_size,file)!=buffer_size)
+		{
+			synfig::error(_("Unable to write frame to ffmpeg"));
+			failed=true;
+		}
+		if(fflush(file))
+			failed=true;
+	}
 	imagecount++;
 }
 
 bool
-ffmpeg_trgt::start_frame(synfig::ProgressCallback */*callback*/)
+ffmpeg_trgt::start_frame(synfig::ProgressCallback *callback)
 {
 	int w=desc.get_w(),h=desc.get_h();
 
 	if(!file)
 		return false;
 
-	fprintf(file, "P6\n");
-	fprintf(file, "%d %d\n", w, h);
-	fprintf(file, "%d\n", 255);
+	// end_frame() can't return error, so it is reported here
+	if(failed)
+	{
+		if(callback) callback->error(_("Unable to write previous frame to ffmpeg"));
+		return false;
+	}
 
-	delete [] buffer;
-	buffer=new unsigned char[3*w];
-	delete [] color_buffer;
-	color_buffer=new Color[w];
+	size_t size = get_raw_format_pixel_size(raw_format)*w*h;
+	if (!buffer || buffer_size != size)
+	{
+		delete [] buffer;
+		buffer=new unsigned char[size];
+		buffer_size=size;
+		delete [] color_buffer;
+		color_buffer=new Color[w];
+	}
+	curr_scanline=0;
 
 	return true;
 }
 
 Color *
-ffmpeg_trgt::start_scanline(int /*scanline*/)
+ffmpeg_trgt::start_scanline(int y)
 {
+	curr_scanline=y;
 	return color_buffer;
 }
 
 bool
 ffmpeg_trgt::end_scanline()
 {
-	if(!file)
+	if(!file || failed || curr_scanline < 0 || curr_scanline >= desc.get_h())
 		return false;
 
-	color_to_pixelformat(buffer, color_buffer, PF_RGB, 0, desc.get_w());
+	const int w=desc.get_w();
+	const size_t pixels=(size_t)w*desc.get_h();
+	const size_t offset=(size_t)w*curr_scanline;
+	const Color *src=color_buffer;
 
-	if(!fwrite(buffer,1,desc.get_w()*3,file))
-		return false;
+	switch(raw_format)
+	{
+	case RAW_RGBA64LE:
+		{
+			unsigned char *dst=buffer+8*offset;
+			for(int x=0; x<w; ++x, ++src, dst+=8)
+			{
+				put_uint16_le(dst+0, src->get_r());
+				put_uint16_le(dst+2, src->get_g());
+				put_uint16_le(dst+4, src->get_b());
+				put_uint16_le(dst+6, src->get_a());
+			}
+		}
+		break;
+	case RAW_GBRPF32LE:
+	case RAW_GBRAPF32LE:
+		{
+			// planes follow one by one: G, B, R and optional A
+			unsigned char *g=buffer+4*offset;
+			unsigned char *b=g+4*pixels;
+			unsigned char *r=b+4*pixels;
+			unsigned char *a=r+4*pixels;
+			const bool alpha=raw_format==RAW_GBRAPF32LE;
+			for(int x=0; x<w; ++x, ++src, g+=4, b+=4, r+=4, a+=4)
+			{
+				put_float_le(g, src->get_g());
+				put_float_le(b, src->get_b());
+				put_float_le(r, src->get_r());
+				if (alpha) put_float_le(a, src->get_a());
+			}
+		}
+		break;
+	default:
+		color_to_pixelformat(buffer+3*offset, color_buffer, PF_RGB, 0, w);
+		break;
+	}
 
 	return true;
 }
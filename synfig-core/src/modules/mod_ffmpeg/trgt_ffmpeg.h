@@ -51,20 +51,40 @@ private:
 #ifdef HAVE_FORK
 	pid_t pid = -1;
 #endif
+	//! Pixel format of raw video frames piped to ffmpeg
+	enum RawFormat
+	{
+		RAW_RGB24,      //!< 8-bit packed RGB
+		RAW_RGBA64LE,   //!< 16-bit packed RGBA
+		RAW_GBRPF32LE,  //!< 32-bit float planar GBR
+		RAW_GBRAPF32LE  //!< 32-bit float planar GBRA
+	};
+
 	int imagecount;
 	bool multi_image;
 	FILE *file;
 	synfig::String filename;
 	synfig::String sound_filename;
+	//! Whole frame in raw_format, written to pipe at end_frame()
 	unsigned char *buffer;
+	size_t buffer_size;
 	synfig::Color *color_buffer;
+	int curr_scanline;
 	std::string video_codec;
 	int bitrate;
+	RawFormat raw_format;
+	//! Writing of some frame to pipe failed, next frames are refused
+	bool failed;
+
+	static const char* get_raw_format_name(RawFormat format);
+	static bool get_raw_format_alpha(RawFormat format);
+	static size_t get_raw_format_pixel_size(RawFormat format);
 public:
 	ffmpeg_trgt(const char *filename,
 				const synfig::TargetParam& params);
 
 	virtual bool set_rend_desc(synfig::RendDesc *desc);
+	virtual bool supports_async_output()const { return true; }
 	virtual bool start_frame(synfig::ProgressCallback *cb);
 	virtual void end_frame();
 
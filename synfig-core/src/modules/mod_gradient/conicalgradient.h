@@ -49,6 +49,13 @@ class ConicalGradient : public Layer_Composite, public Layer_NoDeform
 {
 	SYNFIG_LAYER_MODULE_EXT
 
+public:
+	struct Params {
+		CompiledGradient gradient;
+		Point center;
+		Angle angle;
+	};
+
 private:
 	//! Parameter: (Gradient)
 	ValueBase param_gradient;
@@ -62,11 +69,15 @@ private:
 	CompiledGradient compiled_gradient;
 
 	void compile();
-	Color color_func(const Point &x, Real supersample=0)const;
-	Real calc_supersample(const Point &x, Real pw, Real ph)const;
+	void fill_params(Params &params)const;
+
+	//! Parameters of color functions, updated on every change of layer parameters
+	Params params;
 	bool compile_mesh(cairo_pattern_t* pattern, Gradient gradient, Real radius)const;
 
 public:
+	static Color color_func(const Params &params, const Point &x, Real supersample=0);
+	static Real calc_supersample(const Params &params, const Point &x, Real pw, Real ph);
 
 	ConicalGradient();
 
@@ -81,6 +92,10 @@ public:
 	Layer::Handle hit_check(Context context, const Point &point)const;
 
 	virtual Vocab get_param_vocab()const;
+
+protected:
+	virtual void on_static_param_changed(const String &param);
+	virtual rendering::Task::Handle build_composite_task_vfunc(ContextParams context_params)const;
 }; // END of class ConicalGradient
 
 /* === E N D =============================================================== */
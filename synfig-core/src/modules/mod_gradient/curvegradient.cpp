@@ -51,6 +51,10 @@
 #include <ETL/hermite>
 #include <ETL/calculus>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/software/task/tasksw.h>
+
 #endif
 
 /* === M A C R O S ========================================================= */
@@ -196,6 +200,91 @@ find_closest(bool fast, const std::vector<synfig::BLinePoint>& bline,const Point
 	return ret;
 }
 
+namespace {
+
+class TaskCurveGradient: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskCurveGradient> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	CurveGradient::Params params;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+};
+
+
+class TaskCurveGradientSW: public TaskCurveGradient, public rendering::TaskSW,
+	public rendering::TaskInterfaceBlendToTarget,
+	public rendering::TaskInterfaceSplit
+{
+public:
+	typedef etl::handle<TaskCurveGradientSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual void on_target_set_as_source() {
+		Task::Handle &subtask = sub_task(0);
+		if ( subtask
+		  && subtask->target_surface == target_surface
+		  && !Color::is_straight(blend_method) )
+		{
+			trunc_by_bounds();
+			subtask->source_rect = source_rect;
+			subtask->target_rect = target_rect;
+		}
+	}
+
+	virtual Color::BlendMethodFlags get_supported_blend_methods() const
+		{ return Color::BLEND_METHODS_ALL; }
+
+	virtual bool run(RunParams&) const {
+		if (!is_valid())
+			return true;
+
+		Vector ppu = get_pixels_per_unit();
+
+		Matrix bounds_transfromation;
+		bounds_transfromation.m00 = ppu[0];
+		bounds_transfromation.m11 = ppu[1];
+		bounds_transfromation.m20 = target_rect.minx - ppu[0]*source_rect.minx;
+		bounds_transfromation.m21 = target_rect.miny - ppu[1]*source_rect.miny;
+
+		Matrix matrix = bounds_transfromation * transformation->matrix;
+		Matrix inv_matrix = matrix.get_inverted();
+
+		int tw = target_rect.get_width();
+		Vector dx = inv_matrix.axis_x();
+		Vector dy = inv_matrix.axis_y() - dx*(Real)tw;
+		Vector p = inv_matrix.get_transformed( Vector((Real)target_rect.minx, (Real)target_rect.miny) );
+		Real pw = inv_matrix.axis_x().mag();
+		Real ph = inv_matrix.axis_y().mag();
+
+		LockWrite la(this);
+		if (!la)
+			return false;
+
+		Surface::alpha_pen apen(la->get_surface().get_pen(target_rect.minx, target_rect.miny));
+		ColorReal amount = blend ? this->amount : ColorReal(1.0);
+		apen.set_blend_method(blend ? blend_method : Color::BLEND_COMPOSITE);
+		for(int iy = target_rect.miny; iy < target_rect.maxy; ++iy, p += dy, apen.inc_y(), apen.dec_x(tw))
+			for(int ix = target_rect.minx; ix < target_rect.maxx; ++ix, p += dx, apen.inc_x())
+				apen.put_value(CurveGradient::color_func(params, p, 4, CurveGradient::calc_supersample(params, p, pw, ph)), amount);
+
+		return true;
+	}
+};
+
+rendering::Task::Token TaskCurveGradient::token(
+	DescAbstract<TaskCurveGradient>("CurveGradient") );
+rendering::Task::Token TaskCurveGradientSW::token(
+	DescReal<TaskCurveGradientSW, TaskCurveGradient>("CurveGradientSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 inline void
@@ -246,17 +335,42 @@ CurveGradient::CurveGradient():
 
 	SET_INTERPOLATION_DEFAULTS();
 	SET_STATIC_DEFAULTS();
+
+	fill_params(params);
 }
 
-inline Color
-CurveGradient::color_func(const Point &point_, int quality, Real supersample)const
+void
+CurveGradient::fill_params(Params &params)const
 {
-	Point origin=param_origin.get(Point());
-	Real width=param_width.get(Real());
-	std::vector<synfig::BLinePoint> bline(param_bline.get_list_of(BLinePoint()));
-	bool loop=param_loop.get(bool());
-	bool perpendicular=param_perpendicular.get(bool());
-	bool fast=param_fast.get(bool());
+	params.origin = param_origin.get(Point());
+	params.width = param_width.get(Real());
+	params.bline = param_bline.get_list_of(BLinePoint());
+	params.loop = param_loop.get(bool());
+	params.perpendicular = param_perpendicular.get(bool());
+	params.fast = param_fast.get(bool());
+	params.bline_loop = bline_loop;
+	params.curve_length = curve_length_;
+	params.gradient = compiled_gradient;
+}
+
+void
+CurveGradient::on_static_param_changed(const String &param)
+{
+	Layer_Composite::on_static_param_changed(param);
+	fill_params(params);
+}
+
+Color
+CurveGradient::color_func(const Params &params, const Point &point_, int quality, Real supersample)
+{
+	const Point &origin = params.origin;
+	const Real width = params.width;
+	const std::vector<synfig::BLinePoint> &bline = params.bline;
+	const bool loop = params.loop;
+	const bool perpendicular = params.perpendicular;
+	const bool fast = params.fast;
+	const bool bline_loop = params.bline_loop;
+	const Real curve_length_ = params.curve_length;
 
 	Vector tangent;
 	Vector diff;
@@ -452,11 +566,11 @@ CurveGradient::color_func(const Point &point_, int quality, Real supersample)con
 	}
 
 	supersample *= 0.5;
-	return compiled_gradient.average(dist - supersample, dist + supersample);
+	return params.gradient.average(dist - supersample, dist + supersample);
 }
 
 Real
-CurveGradient::calc_supersample(const synfig::Point &/*x*/, Real pw, Real /*ph*/)const
+CurveGradient::calc_supersample(const Params &/*params*/, const synfig::Point &/*x*/, Real pw, Real /*ph*/)
 {
 	return pw;
 }
@@ -468,7 +582,7 @@ CurveGradient::hit_check(synfig::Context context, const synfig::Point &point)con
 		return const_cast<CurveGradient*>(this);
 	if(get_amount()==0.0)
 		return context.hit_check(point);
-	if((get_blend_method()==Color::BLEND_STRAIGHT || get_blend_method()==Color::BLEND_COMPOSITE|| get_blend_method()==Color::BLEND_ONTO) && color_func(point).get_a()>0.5)
+	if((get_blend_method()==Color::BLEND_STRAIGHT || get_blend_method()==Color::BLEND_COMPOSITE|| get_blend_method()==Color::BLEND_ONTO) && color_func(params, point).get_a()>0.5)
 		return const_cast<CurveGradient*>(this);
 	return context.hit_check(point);
 }
@@ -485,6 +599,7 @@ CurveGradient::set_param(const String & param, const ValueBase &value)
 		param_bline=value;
 		bline_loop=value.get_loop();
 		sync();
+		fill_params(params);
 		return true;
 	}
 	IMPORT_VALUE_PLUS(param_gradient, compile());
@@ -564,7 +679,7 @@ CurveGradient::get_param_vocab()const
 Color
 CurveGradient::get_color(Context context, const Point &point)const
 {
-	const Color color(color_func(point,0));
+	const Color color(color_func(params,point,0));
 
 	if(get_amount()==1.0 && get_blend_method()==Color::BLEND_STRAIGHT)
 		return color;
@@ -605,13 +720,13 @@ CurveGradient::accelerated_render(Context context,Surface *surface,int quality,
 	{
 		for(y=0,pos[1]=tl[1];y<h;y++,pen.inc_y(),pen.dec_x(x),pos[1]+=ph)
 			for(x=0,pos[0]=tl[0];x<w;x++,pen.inc_x(),pos[0]+=pw)
-				pen.put_value(color_func(pos,quality,calc_supersample(pos,pw,ph)));
+				pen.put_value(color_func(params,pos,quality,calc_supersample(params,pos,pw,ph)));
 	}
 	else
 	{
 		for(y=0,pos[1]=tl[1];y<h;y++,pen.inc_y(),pen.dec_x(x),pos[1]+=ph)
 			for(x=0,pos[0]=tl[0];x<w;x++,pen.inc_x(),pos[0]+=pw)
-				pen.put_value(Color::blend(color_func(pos,quality,calc_supersample(pos,pw,ph)),pen.get_value(),get_amount(),get_blend_method()));
+				pen.put_value(Color::blend(color_func(params,pos,quality,calc_supersample(params,pos,pw,ph)),pen.get_value(),get_amount(),get_blend_method()));
 	}
 
 	// Mark our progress as finished
@@ -621,6 +736,14 @@ CurveGradient::accelerated_render(Context context,Surface *surface,int quality,
 	return true;
 }
 
+rendering::Task::Handle
+CurveGradient::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	TaskCurveGradient::Handle task(new TaskCurveGradient());
+	task->params = params;
+	return task;
+}
+
 ////
 bool
 CurveGradient::accelerated_cairorender(Context context, cairo_t *cr,int quality, const RendDesc &renddesc_, ProgressCallback *cb)const
@@ -668,7 +791,7 @@ CurveGradient::accelerated_cairorender(Context context, cairo_t *cr,int quality,
 	}
 	for(y=0,pos[1]=tl[1];y<h;y++,pos[1]+=ph)
 		for(x=0,pos[0]=tl[0];x<w;x++,pos[0]+=pw)
-			csurface[y][x]=CairoColor(color_func(pos,calc_supersample(pos,pw,ph))).premult_alpha();
+			csurface[y][x]=CairoColor(color_func(params,pos,calc_supersample(params,pos,pw,ph))).premult_alpha();
 	csurface.unmap_cairo_image();
 	
 	// paint surface on cr
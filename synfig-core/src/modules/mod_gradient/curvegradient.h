@@ -49,6 +49,20 @@ class CurveGradient : public Layer_Composite, public Layer_NoDeform
 {
 	SYNFIG_LAYER_MODULE_EXT
 
+public:
+	struct Params {
+		Point origin;
+		Real width;
+		std::vector<synfig::BLinePoint> bline;
+		bool loop;
+		bool perpendicular;
+		bool fast;
+		bool bline_loop;
+		Real curve_length;
+		CompiledGradient gradient;
+		inline Params(): width(), loop(), perpendicular(), fast(), bline_loop(), curve_length() { }
+	};
+
 private:
 	//! Parameter: (Point)
 	ValueBase param_origin;
@@ -74,10 +88,15 @@ private:
 
 	void compile();
 	void sync();
-	Color color_func(const Point &x, int quality=10, Real supersample=0)const;
-	Real calc_supersample(const Point &x, Real pw, Real ph)const;
+	void fill_params(Params &params)const;
+
+	//! Parameters of color functions, updated on every change of layer parameters
+	Params params;
 
 public:
+	static Color color_func(const Params &params, const Point &x, int quality=10, Real supersample=0);
+	static Real calc_supersample(const Params &params, const Point &x, Real pw, Real ph);
+
 	CurveGradient();
 
 	virtual bool set_param(const String &param, const ValueBase &value);
@@ -88,6 +107,10 @@ public:
 	Layer::Handle hit_check(synfig::Context context, const synfig::Point &point)const;
 
 	virtual Vocab get_param_vocab()const;
+
+protected:
+	virtual void on_static_param_changed(const String &param);
+	virtual rendering::Task::Handle build_composite_task_vfunc(ContextParams context_params)const;
 };
 
 /* === E N D =============================================================== */
@@ -46,6 +46,10 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/software/task/tasksw.h>
+
 #endif
 
 /* === M A C R O S ========================================================= */
@@ -60,6 +64,90 @@ SYNFIG_LAYER_SET_VERSION(LinearGradient,"0.0");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class TaskLinearGradient: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskLinearGradient> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	LinearGradient::Params params;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+};
+
+
+class TaskLinearGradientSW: public TaskLinearGradient, public rendering::TaskSW,
+	public rendering::TaskInterfaceBlendToTarget,
+	public rendering::TaskInterfaceSplit
+{
+public:
+	typedef etl::handle<TaskLinearGradientSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual void on_target_set_as_source() {
+		Task::Handle &subtask = sub_task(0);
+		if ( subtask
+		  && subtask->target_surface == target_surface
+		  && !Color::is_straight(blend_method) )
+		{
+			trunc_by_bounds();
+			subtask->source_rect = source_rect;
+			subtask->target_rect = target_rect;
+		}
+	}
+
+	virtual Color::BlendMethodFlags get_supported_blend_methods() const
+		{ return Color::BLEND_METHODS_ALL; }
+
+	virtual bool run(RunParams&) const {
+		if (!is_valid())
+			return true;
+
+		Vector ppu = get_pixels_per_unit();
+
+		Matrix bounds_transfromation;
+		bounds_transfromation.m00 = ppu[0];
+		bounds_transfromation.m11 = ppu[1];
+		bounds_transfromation.m20 = target_rect.minx - ppu[0]*source_rect.minx;
+		bounds_transfromation.m21 = target_rect.miny - ppu[1]*source_rect.miny;
+
+		Matrix matrix = bounds_transfromation * transformation->matrix;
+		Matrix inv_matrix = matrix.get_inverted();
+
+		int tw = target_rect.get_width();
+		Vector dx = inv_matrix.axis_x();
+		Vector dy = inv_matrix.axis_y() - dx*(Real)tw;
+		Vector p = inv_matrix.get_transformed( Vector((Real)target_rect.minx, (Real)target_rect.miny) );
+		Real supersample = LinearGradient::calc_supersample(params, inv_matrix.axis_x().mag(), inv_matrix.axis_y().mag());
+
+		LockWrite la(this);
+		if (!la)
+			return false;
+
+		Surface::alpha_pen apen(la->get_surface().get_pen(target_rect.minx, target_rect.miny));
+		ColorReal amount = blend ? this->amount : ColorReal(1.0);
+		apen.set_blend_method(blend ? blend_method : Color::BLEND_COMPOSITE);
+		for(int iy = target_rect.miny; iy < target_rect.maxy; ++iy, p += dy, apen.inc_y(), apen.dec_x(tw))
+			for(int ix = target_rect.minx; ix < target_rect.maxx; ++ix, p += dx, apen.inc_x())
+				apen.put_value(LinearGradient::color_func(params, p, supersample), amount);
+
+		return true;
+	}
+};
+
+rendering::Task::Token TaskLinearGradient::token(
+	DescAbstract<TaskLinearGradient>("LinearGradient") );
+rendering::Task::Token TaskLinearGradientSW::token(
+	DescReal<TaskLinearGradientSW, TaskLinearGradient>("LinearGradientSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 inline void
@@ -81,6 +169,8 @@ LinearGradient::LinearGradient():
 {
 	SET_INTERPOLATION_DEFAULTS();
 	SET_STATIC_DEFAULTS();
+
+	fill_params(params);
 }
 
 inline void
@@ -94,16 +184,23 @@ LinearGradient::fill_params(Params &params)const
 	params.calc_diff();
 }
 
-inline Color
-LinearGradient::color_func(const Params &params, const Point &point, synfig::Real supersample)const
+void
+LinearGradient::on_static_param_changed(const String &param)
+{
+	Layer_Composite::on_static_param_changed(param);
+	fill_params(params);
+}
+
+Color
+LinearGradient::color_func(const Params &params, const Point &point, synfig::Real supersample)
 {
 	Real dist(point*params.diff - params.p1*params.diff);
 	supersample *= 0.5;
 	return params.gradient.average(dist - supersample, dist + supersample);
 }
 
-inline synfig::Real
-LinearGradient::calc_supersample(const Params &params, synfig::Real pw, synfig::Real /*ph*/)const
+synfig::Real
+LinearGradient::calc_supersample(const Params &params, synfig::Real pw, synfig::Real /*ph*/)
 {
 	// it's copy of code
 	// see also other calc_supersample overload
@@ -118,9 +215,6 @@ LinearGradient::hit_check(synfig::Context context, const synfig::Point &point)co
 	if(get_amount()==0.0)
 		return context.hit_check(point);
 
-	Params params;
-	fill_params(params);
-
 	if((get_blend_method()==Color::BLEND_STRAIGHT || get_blend_method()==Color::BLEND_COMPOSITE) && color_func(params, point).get_a()>0.5)
 		return const_cast<LinearGradient*>(this);
 	return context.hit_check(point);
@@ -187,9 +281,6 @@ LinearGradient::get_param_vocab()const
 Color
 LinearGradient::get_color(Context context, const Point &point)const
 {
-	Params params;
-	fill_params(params);
-
 	const Color color(color_func(params, point));
 
 	if(get_amount()==1.0 && get_blend_method()==Color::BLEND_STRAIGHT)
@@ -201,8 +292,8 @@ LinearGradient::get_color(Context context, const Point &point)const
 bool
 LinearGradient::accelerated_render(Context context,Surface *surface,int quality, const RendDesc &renddesc, ProgressCallback *cb)const
 {
-	Params params;
-	fill_params(params);
+	// points are adjusted to transformation below
+	Params params(this->params);
 
 	if (!renddesc.get_transformation_matrix().is_identity())
 	{
@@ -270,6 +361,13 @@ LinearGradient::accelerated_render(Context context,Surface *surface,int quality,
 	return true;
 }
 
+rendering::Task::Handle
+LinearGradient::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	TaskLinearGradient::Handle task(new TaskLinearGradient());
+	task->params = params;
+	return task;
+}
 
 bool
 LinearGradient::accelerated_cairorender(Context context, cairo_t *cr, int quality, const RendDesc &renddesc, ProgressCallback *cb)const
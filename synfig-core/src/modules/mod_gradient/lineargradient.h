@@ -48,16 +48,7 @@ class LinearGradient : public Layer_Composite, public Layer_NoDeform
 {
 	SYNFIG_LAYER_MODULE_EXT
 
-private:
-	//! Parameter: (Point)
-	ValueBase param_p1,param_p2;
-	//! Parameter: (Gradient)
-	ValueBase param_gradient;
-	//! Parameter: (bool)
-	ValueBase param_loop;
-	//! Parameter: (bool)
-	ValueBase param_zigzag;
-
+public:
 	struct Params {
 		Point p1;
 		Point p2;
@@ -69,12 +60,26 @@ private:
 		void calc_diff();
 	};
 
+private:
+	//! Parameter: (Point)
+	ValueBase param_p1,param_p2;
+	//! Parameter: (Gradient)
+	ValueBase param_gradient;
+	//! Parameter: (bool)
+	ValueBase param_loop;
+	//! Parameter: (bool)
+	ValueBase param_zigzag;
+
 	void fill_params(Params &params)const;
-	synfig::Color color_func(const Params &params, const synfig::Point &x, synfig::Real supersample = 0.0)const;
-	synfig::Real calc_supersample(const Params &params, synfig::Real pw, synfig::Real ph)const;
+
+	//! Parameters of color functions, updated on every change of layer parameters
+	Params params;
 	bool compile_gradient(cairo_pattern_t* pattern, Gradient gradient)const;
 
 public:
+	static synfig::Color color_func(const Params &params, const synfig::Point &x, synfig::Real supersample = 0.0);
+	static synfig::Real calc_supersample(const Params &params, synfig::Real pw, synfig::Real ph);
+
 	LinearGradient();
 
 	virtual bool set_param(const String &param, const ValueBase &value);
@@ -86,6 +91,10 @@ public:
 	synfig::Layer::Handle hit_check(synfig::Context context, const synfig::Point &point)const;
 
 	virtual Vocab get_param_vocab()const;
+
+protected:
+	virtual void on_static_param_changed(const String &param);
+	virtual rendering::Task::Handle build_composite_task_vfunc(ContextParams context_params)const;
 };
 
 /* === E N D =============================================================== */
@@ -43,6 +43,10 @@
 #include <synfig/value.h>
 #include <synfig/valuenode.h>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/software/task/tasksw.h>
+
 #include "radialgradient.h"
 
 #endif
@@ -63,6 +67,91 @@ SYNFIG_LAYER_SET_VERSION(RadialGradient,"0.1");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class TaskRadialGradient: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskRadialGradient> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	RadialGradient::Params params;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+};
+
+
+class TaskRadialGradientSW: public TaskRadialGradient, public rendering::TaskSW,
+	public rendering::TaskInterfaceBlendToTarget,
+	public rendering::TaskInterfaceSplit
+{
+public:
+	typedef etl::handle<TaskRadialGradientSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual void on_target_set_as_source() {
+		Task::Handle &subtask = sub_task(0);
+		if ( subtask
+		  && subtask->target_surface == target_surface
+		  && !Color::is_straight(blend_method) )
+		{
+			trunc_by_bounds();
+			subtask->source_rect = source_rect;
+			subtask->target_rect = target_rect;
+		}
+	}
+
+	virtual Color::BlendMethodFlags get_supported_blend_methods() const
+		{ return Color::BLEND_METHODS_ALL; }
+
+	virtual bool run(RunParams&) const {
+		if (!is_valid())
+			return true;
+
+		Vector ppu = get_pixels_per_unit();
+
+		Matrix bounds_transfromation;
+		bounds_transfromation.m00 = ppu[0];
+		bounds_transfromation.m11 = ppu[1];
+		bounds_transfromation.m20 = target_rect.minx - ppu[0]*source_rect.minx;
+		bounds_transfromation.m21 = target_rect.miny - ppu[1]*source_rect.miny;
+
+		Matrix matrix = bounds_transfromation * transformation->matrix;
+		Matrix inv_matrix = matrix.get_inverted();
+
+		int tw = target_rect.get_width();
+		Vector dx = inv_matrix.axis_x();
+		Vector dy = inv_matrix.axis_y() - dx*(Real)tw;
+		Vector p = inv_matrix.get_transformed( Vector((Real)target_rect.minx, (Real)target_rect.miny) );
+		Real pw = inv_matrix.axis_x().mag();
+		Real ph = inv_matrix.axis_y().mag();
+
+		LockWrite la(this);
+		if (!la)
+			return false;
+
+		Surface::alpha_pen apen(la->get_surface().get_pen(target_rect.minx, target_rect.miny));
+		ColorReal amount = blend ? this->amount : ColorReal(1.0);
+		apen.set_blend_method(blend ? blend_method : Color::BLEND_COMPOSITE);
+		for(int iy = target_rect.miny; iy < target_rect.maxy; ++iy, p += dy, apen.inc_y(), apen.dec_x(tw))
+			for(int ix = target_rect.minx; ix < target_rect.maxx; ++ix, p += dx, apen.inc_x())
+				apen.put_value(RadialGradient::color_func(params, p, RadialGradient::calc_supersample(params, p, pw, ph)), amount);
+
+		return true;
+	}
+};
+
+rendering::Task::Token TaskRadialGradient::token(
+	DescAbstract<TaskRadialGradient>("RadialGradient") );
+rendering::Task::Token TaskRadialGradientSW::token(
+	DescReal<TaskRadialGradientSW, TaskRadialGradient>("RadialGradientSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -77,6 +166,8 @@ RadialGradient::RadialGradient():
 {
 	SET_INTERPOLATION_DEFAULTS();
 	SET_STATIC_DEFAULTS();
+
+	fill_params(params);
 }
 
 bool
@@ -151,25 +242,36 @@ RadialGradient::compile()
 		param_zigzag.get(bool()) );
 }
 
-inline Color
-RadialGradient::color_func(const Point &point, Real supersample)const
+void
+RadialGradient::fill_params(Params &params)const
 {
-	Point center = param_center.get(Point());
-	Real radius = param_radius.get(Real());
+	params.gradient = compiled_gradient;
+	params.center = param_center.get(Point());
+	params.radius = param_radius.get(Real());
+}
 
-	Real dist((point-center).mag()/radius);
+void
+RadialGradient::on_static_param_changed(const String &param)
+{
+	Layer_Composite::on_static_param_changed(param);
+	fill_params(params);
+}
+
+Color
+RadialGradient::color_func(const Params &params, const Point &point, Real supersample)
+{
+	Real dist((point-params.center).mag()/params.radius);
 
 	supersample *= 0.5;
-	return compiled_gradient.average(dist - supersample, dist + supersample);
+	return params.gradient.average(dist - supersample, dist + supersample);
 }
 
 
 Real
-RadialGradient::calc_supersample(const synfig::Point &/*x*/, Real pw, Real /*ph*/)const
+RadialGradient::calc_supersample(const Params &params, const synfig::Point &/*x*/, Real pw, Real /*ph*/)
 {
-	Real radius=param_radius.get(Real());
-//	return sqrt(pw*pw+ph*ph)/radius;
-	return 1.2*pw/radius;
+//	return sqrt(pw*pw+ph*ph)/params.radius;
+	return 1.2*pw/params.radius;
 }
 
 synfig::Layer::Handle
@@ -179,7 +281,8 @@ RadialGradient::hit_check(synfig::Context context, const synfig::Point &point)co
 		return const_cast<RadialGradient*>(this);
 	if(get_amount()==0.0)
 		return context.hit_check(point);
-	if((get_blend_method()==Color::BLEND_STRAIGHT || get_blend_method()==Color::BLEND_COMPOSITE) && color_func(point).get_a()>0.5)
+
+	if((get_blend_method()==Color::BLEND_STRAIGHT || get_blend_method()==Color::BLEND_COMPOSITE) && color_func(params, point).get_a()>0.5)
 		return const_cast<RadialGradient*>(this);
 	return context.hit_check(point);
 }
@@ -187,7 +290,7 @@ RadialGradient::hit_check(synfig::Context context, const synfig::Point &point)co
 Color
 RadialGradient::get_color(Context context, const Point &pos)const
 {
-	const Color color(color_func(pos));
+	const Color color(color_func(params, pos));
 
 	if(get_amount()==1.0 && get_blend_method()==Color::BLEND_STRAIGHT)
 		return color;
@@ -228,13 +331,13 @@ RadialGradient::accelerated_render(Context context,Surface *surface,int quality,
 	{
 		for(y=0,pos[1]=tl[1];y<h;y++,pen.inc_y(),pen.dec_x(x),pos[1]+=ph)
 			for(x=0,pos[0]=tl[0];x<w;x++,pen.inc_x(),pos[0]+=pw)
-				pen.put_value(color_func(pos,calc_supersample(pos,pw,ph)));
+				pen.put_value(color_func(params,pos,calc_supersample(params,pos,pw,ph)));
 	}
 	else
 	{
 		for(y=0,pos[1]=tl[1];y<h;y++,pen.inc_y(),pen.dec_x(x),pos[1]+=ph)
 			for(x=0,pos[0]=tl[0];x<w;x++,pen.inc_x(),pos[0]+=pw)
-				pen.put_value(Color::blend(color_func(pos,calc_supersample(pos,pw,ph)),pen.get_value(),get_amount(),get_blend_method()));
+				pen.put_value(Color::blend(color_func(params,pos,calc_supersample(params,pos,pw,ph)),pen.get_value(),get_amount(),get_blend_method()));
 	}
 
 	// Mark our progress as finished
@@ -244,6 +347,13 @@ RadialGradient::accelerated_render(Context context,Surface *surface,int quality,
 	return true;
 }
 
+rendering::Task::Handle
+RadialGradient::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	TaskRadialGradient::Handle task(new TaskRadialGradient());
+	task->params = params;
+	return task;
+}
 
 bool
 RadialGradient::accelerated_cairorender(Context context,cairo_t *cr, int quality, const RendDesc &renddesc, ProgressCallback *cb)const
@@ -43,6 +43,10 @@
 #include <synfig/valuenode.h>
 #include <synfig/cairo_renddesc.h>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/software/task/tasksw.h>
+
 #include "spiralgradient.h"
 
 #endif
@@ -63,6 +67,91 @@ SYNFIG_LAYER_SET_VERSION(SpiralGradient,"0.1");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class TaskSpiralGradient: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskSpiralGradient> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	SpiralGradient::Params params;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+};
+
+
+class TaskSpiralGradientSW: public TaskSpiralGradient, public rendering::TaskSW,
+	public rendering::TaskInterfaceBlendToTarget,
+	public rendering::TaskInterfaceSplit
+{
+public:
+	typedef etl::handle<TaskSpiralGradientSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual void on_target_set_as_source() {
+		Task::Handle &subtask = sub_task(0);
+		if ( subtask
+		  && subtask->target_surface == target_surface
+		  && !Color::is_straight(blend_method) )
+		{
+			trunc_by_bounds();
+			subtask->source_rect = source_rect;
+			subtask->target_rect = target_rect;
+		}
+	}
+
+	virtual Color::BlendMethodFlags get_supported_blend_methods() const
+		{ return Color::BLEND_METHODS_ALL; }
+
+	virtual bool run(RunParams&) const {
+		if (!is_valid())
+			return true;
+
+		Vector ppu = get_pixels_per_unit();
+
+		Matrix bounds_transfromation;
+		bounds_transfromation.m00 = ppu[0];
+		bounds_transfromation.m11 = ppu[1];
+		bounds_transfromation.m20 = target_rect.minx - ppu[0]*source_rect.minx;
+		bounds_transfromation.m21 = target_rect.miny - ppu[1]*source_rect.miny;
+
+		Matrix matrix = bounds_transfromation * transformation->matrix;
+		Matrix inv_matrix = matrix.get_inverted();
+
+		int tw = target_rect.get_width();
+		Vector dx = inv_matrix.axis_x();
+		Vector dy = inv_matrix.axis_y() - dx*(Real)tw;
+		Vector p = inv_matrix.get_transformed( Vector((Real)target_rect.minx, (Real)target_rect.miny) );
+		Real pw = inv_matrix.axis_x().mag();
+		Real ph = inv_matrix.axis_y().mag();
+
+		LockWrite la(this);
+		if (!la)
+			return false;
+
+		Surface::alpha_pen apen(la->get_surface().get_pen(target_rect.minx, target_rect.miny));
+		ColorReal amount = blend ? this->amount : ColorReal(1.0);
+		apen.set_blend_method(blend ? blend_method : Color::BLEND_COMPOSITE);
+		for(int iy = target_rect.miny; iy < target_rect.maxy; ++iy, p += dy, apen.inc_y(), apen.dec_x(tw))
+			for(int ix = target_rect.minx; ix < target_rect.maxx; ++ix, p += dx, apen.inc_x())
+				apen.put_value(SpiralGradient::color_func(params, p, SpiralGradient::calc_supersample(params, p, pw, ph)), amount);
+
+		return true;
+	}
+};
+
+rendering::Task::Token TaskSpiralGradient::token(
+	DescAbstract<TaskSpiralGradient>("SpiralGradient") );
+rendering::Task::Token TaskSpiralGradientSW::token(
+	DescReal<TaskSpiralGradientSW, TaskSpiralGradient>("SpiralGradientSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 /* === E N T R Y P O I N T ================================================= */
@@ -77,6 +166,8 @@ SpiralGradient::SpiralGradient():
 {
 	SET_INTERPOLATION_DEFAULTS();
 	SET_STATIC_DEFAULTS();
+
+	fill_params(params);
 }
 
 bool
@@ -147,38 +238,47 @@ void
 SpiralGradient::compile()
 	{ compiled_gradient.set(param_gradient.get(Gradient()), true); }
 
-inline Color
-SpiralGradient::color_func(const Point &pos, Real supersample)const
+void
+SpiralGradient::fill_params(Params &params)const
 {
-	Point center=param_center.get(Point());
-	Real radius=param_radius.get(Real());
-	Angle angle=param_angle.get(Angle());
-	bool clockwise=param_clockwise.get(bool());
-	
-	const Point centered(pos-center);
+	params.gradient = compiled_gradient;
+	params.center = param_center.get(Point());
+	params.radius = param_radius.get(Real());
+	params.angle = param_angle.get(Angle());
+	params.clockwise = param_clockwise.get(bool());
+}
+
+void
+SpiralGradient::on_static_param_changed(const String &param)
+{
+	Layer_Composite::on_static_param_changed(param);
+	fill_params(params);
+}
+
+Color
+SpiralGradient::color_func(const Params &params, const Point &pos, Real supersample)
+{
+	const Point centered(pos-params.center);
 	Angle a;
 	a=Angle::tan(-centered[1],centered[0]).mod();
-	a=a+angle;
+	a=a+params.angle;
 
 	if(supersample<0.00001)supersample=0.00001;
 
-	Real dist((pos-center).mag()/radius);
-	if(clockwise)
+	Real dist((pos-params.center).mag()/params.radius);
+	if(params.clockwise)
 		dist+=Angle::rot(a.mod()).get();
 	else
 		dist-=Angle::rot(a.mod()).get();
 
 	supersample *= 0.5;
-	return compiled_gradient.average(dist - supersample, dist + supersample);
+	return params.gradient.average(dist - supersample, dist + supersample);
 }
 
 Real
-SpiralGradient::calc_supersample(const synfig::Point &x, Real pw, Real /*ph*/)const
+SpiralGradient::calc_supersample(const Params &params, const synfig::Point &x, Real pw, Real /*ph*/)
 {
-	Point center=param_center.get(Point());
-	Real radius=param_radius.get(Real());
-
-	return (1.41421*pw/radius+(1.41421*pw/Point(x-center).mag())/(PI*2))*0.5;
+	return (1.41421*pw/params.radius+(1.41421*pw/Point(x-params.center).mag())/(PI*2))*0.5;
 }
 
 synfig::Layer::Handle
@@ -188,7 +288,8 @@ SpiralGradient::hit_check(synfig::Context context, const synfig::Point &point)co
 		return const_cast<SpiralGradient*>(this);
 	if(get_amount()==0.0)
 		return context.hit_check(point);
-	if((get_blend_method()==Color::BLEND_STRAIGHT || get_blend_method()==Color::BLEND_COMPOSITE) && color_func(point).get_a()>0.5)
+
+	if((get_blend_method()==Color::BLEND_STRAIGHT || get_blend_method()==Color::BLEND_COMPOSITE) && color_func(params, point).get_a()>0.5)
 		return const_cast<SpiralGradient*>(this);
 	return context.hit_check(point);
 }
@@ -196,7 +297,7 @@ SpiralGradient::hit_check(synfig::Context context, const synfig::Point &point)co
 Color
 SpiralGradient::get_color(Context context, const Point &pos)const
 {
-	const Color color(color_func(pos));
+	const Color color(color_func(params, pos));
 
 	if(get_amount()==1.0 && get_blend_method()==Color::BLEND_STRAIGHT)
 		return color;
@@ -237,13 +338,13 @@ SpiralGradient::accelerated_render(Context context,Surface *surface,int quality,
 	{
 		for(y=0,pos[1]=tl[1];y<h;y++,pen.inc_y(),pen.dec_x(x),pos[1]+=ph)
 			for(x=0,pos[0]=tl[0];x<w;x++,pen.inc_x(),pos[0]+=pw)
-				pen.put_value(color_func(pos,calc_supersample(pos,pw,ph)));
+				pen.put_value(color_func(params,pos,calc_supersample(params,pos,pw,ph)));
 	}
 	else
 	{
 		for(y=0,pos[1]=tl[1];y<h;y++,pen.inc_y(),pen.dec_x(x),pos[1]+=ph)
 			for(x=0,pos[0]=tl[0];x<w;x++,pen.inc_x(),pos[0]+=pw)
-				pen.put_value(Color::blend(color_func(pos,calc_supersample(pos,pw,ph)),pen.get_value(),get_amount(),get_blend_method()));
+				pen.put_value(Color::blend(color_func(params,pos,calc_supersample(params,pos,pw,ph)),pen.get_value(),get_amount(),get_blend_method()));
 	}
 
 	// Mark our progress as finished
@@ -253,6 +354,14 @@ SpiralGradient::accelerated_render(Context context,Surface *surface,int quality,
 	return true;
 }
 
+rendering::Task::Handle
+SpiralGradient::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	TaskSpiralGradient::Handle task(new TaskSpiralGradient());
+	task->params = params;
+	return task;
+}
+
 ////
 bool
 SpiralGradient::accelerated_cairorender(Context context, cairo_t *cr,int quality, const RendDesc &renddesc_, ProgressCallback *cb)const
@@ -300,7 +409,7 @@ SpiralGradient::accelerated_cairorender(Context context, cairo_t *cr,int quality
 	}
 	for(y=0,pos[1]=tl[1];y<h;y++,pos[1]+=ph)
 		for(x=0,pos[0]=tl[0];x<w;x++,pos[0]+=pw)
-			csurface[y][x]=CairoColor(color_func(pos,calc_supersample(pos,pw,ph))).premult_alpha();
+			csurface[y][x]=CairoColor(color_func(params,pos,calc_supersample(params,pos,pw,ph))).premult_alpha();
 	csurface.unmap_cairo_image();
 	
 	// paint surface on cr
@@ -48,6 +48,16 @@ class SpiralGradient : public Layer_Composite, public Layer_NoDeform
 {
 	SYNFIG_LAYER_MODULE_EXT
 
+public:
+	struct Params {
+		CompiledGradient gradient;
+		Point center;
+		Real radius;
+		Angle angle;
+		bool clockwise;
+		inline Params(): radius(), clockwise() { }
+	};
+
 private:
 	//! Parameter: (Gradient)
 	ValueBase param_gradient;
@@ -63,10 +73,14 @@ private:
 	CompiledGradient compiled_gradient;
 
 	void compile();
-	Color color_func(const Point &x, Real supersample=0)const;
-	Real calc_supersample(const Point &x, Real pw, Real ph)const;
+	void fill_params(Params &params)const;
+
+	//! Parameters of color functions, updated on every change of layer parameters
+	Params params;
 
 public:
+	static Color color_func(const Params &params, const Point &x, Real supersample=0);
+	static Real calc_supersample(const Params &params, const Point &x, Real pw, Real ph);
 
 	SpiralGradient();
 
@@ -81,6 +95,10 @@ public:
 	Layer::Handle hit_check(Context context, const Point &point)const;
 
 	virtual Vocab get_param_vocab()const;
+
+protected:
+	virtual void on_static_param_changed(const String &param);
+	virtual rendering::Task::Handle build_composite_task_vfunc(ContextParams context_params)const;
 }; // END of class SpiralGradient
 
 /* === E N D =============================================================== */
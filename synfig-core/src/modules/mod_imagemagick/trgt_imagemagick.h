@@ -63,6 +63,7 @@ public:
 	virtual ~imagemagick_trgt();
 
 	virtual bool set_rend_desc(synfig::RendDesc *desc);
+	virtual bool supports_async_output()const { return true; }
 	virtual bool init(synfig::ProgressCallback *cb);
 	virtual bool start_frame(synfig::ProgressCallback *cb);
 	virtual void end_frame();
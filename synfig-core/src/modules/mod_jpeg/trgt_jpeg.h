@@ -65,6 +65,7 @@ public:
 	virtual ~jpeg_trgt();
 
 	virtual bool set_rend_desc(synfig::RendDesc *desc);
+	virtual bool supports_async_output()const { return true; }
 	virtual bool start_frame(synfig::ProgressCallback *cb);
 	virtual void end_frame();
 
@@ -46,6 +46,10 @@
 #include <synfig/valuenode.h>
 #include <time.h>
 
+#include <synfig/rendering/common/task/tasktransformation.h>
+#include <synfig/rendering/common/task/taskblend.h>
+#include <synfig/rendering/software/task/tasksw.h>
+
 #endif
 
 /* === M A C R O S ========================================================= */
@@ -64,6 +68,93 @@ SYNFIG_LAYER_SET_VERSION(Noise,"0.0");
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+class TaskNoise: public rendering::Task, public rendering::TaskInterfaceTransformation
+{
+public:
+	typedef etl::handle<TaskNoise> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	Noise::Params params;
+	Time time_mark;
+	rendering::Holder<rendering::TransformationAffine> transformation;
+
+	virtual rendering::Transformation::Handle get_transformation() const
+		{ return transformation.handle(); }
+};
+
+
+class TaskNoiseSW: public TaskNoise, public rendering::TaskSW,
+	public rendering::TaskInterfaceBlendToTarget,
+	public rendering::TaskInterfaceSplit
+{
+public:
+	typedef etl::handle<TaskNoiseSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual void on_target_set_as_source() {
+		Task::Handle &subtask = sub_task(0);
+		if ( subtask
+		  && subtask->target_surface == target_surface
+		  && !Color::is_straight(blend_method) )
+		{
+			trunc_by_bounds();
+			subtask->source_rect = source_rect;
+			subtask->target_rect = target_rect;
+		}
+	}
+
+	virtual Color::BlendMethodFlags get_supported_blend_methods() const
+		{ return Color::BLEND_METHODS_ALL; }
+
+	virtual bool run(RunParams&) const {
+		if (!is_valid())
+			return true;
+
+		Vector ppu = get_pixels_per_unit();
+
+		Matrix bounds_transfromation;
+		bounds_transfromation.m00 = ppu[0];
+		bounds_transfromation.m11 = ppu[1];
+		bounds_transfromation.m20 = target_rect.minx - ppu[0]*source_rect.minx;
+		bounds_transfromation.m21 = target_rect.miny - ppu[1]*source_rect.miny;
+
+		Matrix matrix = bounds_transfromation * transformation->matrix;
+		Matrix inv_matrix = matrix.get_inverted();
+
+		int tw = target_rect.get_width();
+		Vector dx = inv_matrix.axis_x();
+		Vector dy = inv_matrix.axis_y() - dx*(Real)tw;
+		Vector p = inv_matrix.get_transformed( Vector((Real)target_rect.minx, (Real)target_rect.miny) );
+		Real pw = inv_matrix.axis_x().mag();
+		Real ph = inv_matrix.axis_y().mag();
+		float supersample_radius = (float)((pw + ph)*0.5);
+
+		LockWrite la(this);
+		if (!la)
+			return false;
+
+		Surface::alpha_pen apen(la->get_surface().get_pen(target_rect.minx, target_rect.miny));
+		ColorReal amount = blend ? this->amount : ColorReal(1.0);
+		apen.set_blend_method(blend ? blend_method : Color::BLEND_COMPOSITE);
+		for(int iy = target_rect.miny; iy < target_rect.maxy; ++iy, p += dy, apen.inc_y(), apen.dec_x(tw))
+			for(int ix = target_rect.minx; ix < target_rect.maxx; ++ix, p += dx, apen.inc_x())
+				apen.put_value(Noise::color_func(params, time_mark, p, supersample_radius), amount);
+
+		return true;
+	}
+};
+
+rendering::Task::Token TaskNoise::token(
+	DescAbstract<TaskNoise>("Noise") );
+rendering::Task::Token TaskNoiseSW::token(
+	DescReal<TaskNoiseSW, TaskNoise>("NoiseSW") );
+
+} // namespace
+
 /* === M E T H O D S ======================================================= */
 
 Noise::Noise():
@@ -82,6 +173,8 @@ Noise::Noise():
 	//do_displacement=false;
 	SET_INTERPOLATION_DEFAULTS();
 	SET_STATIC_DEFAULTS();
+
+	fill_params(params);
 }
 
 
@@ -90,19 +183,39 @@ void
 Noise::compile()
 	{ compiled_gradient.set(param_gradient.get(Gradient()) ); }
 
-inline Color
-Noise::color_func(const Point &point, float pixel_size,Context /*context*/)const
+void
+Noise::fill_params(Params &params)const
 {
-	Vector size=param_size.get(Vector());
-	RandomNoise random;
-	random.set_seed(param_random.get(int()));
-	int smooth_=param_smooth.get(int());
-	int detail=param_detail.get(int());
-	Real speed=param_speed.get(Real());
-	bool turbulent=param_turbulent.get(bool());
-	bool do_alpha=param_do_alpha.get(bool());
-	bool super_sample=param_super_sample.get(bool());
-	
+	params.gradient = compiled_gradient;
+	params.random.set_seed(param_random.get(int()));
+	params.size = param_size.get(Vector());
+	params.smooth = param_smooth.get(int());
+	params.detail = param_detail.get(int());
+	params.speed = param_speed.get(Real());
+	params.turbulent = param_turbulent.get(bool());
+	params.do_alpha = param_do_alpha.get(bool());
+	params.super_sample = param_super_sample.get(bool());
+}
+
+void
+Noise::on_static_param_changed(const String &param)
+{
+	Layer_Composite::on_static_param_changed(param);
+	fill_params(params);
+}
+
+Color
+Noise::color_func(const Params &params, Time time_mark, const Point &point, float pixel_size)
+{
+	const Vector &size = params.size;
+	const RandomNoise &random = params.random;
+	int smooth_ = params.smooth;
+	int detail = params.detail;
+	Real speed = params.speed;
+	bool turbulent = params.turbulent;
+	bool do_alpha = params.do_alpha;
+	bool super_sample = params.super_sample;
+
 
 	Color ret(0,0,0,0);
 
@@ -118,7 +231,7 @@ Noise::color_func(const Point &point, float pixel_size,Context /*context*/)const
 
 	int i;
 	Time time;
-	time=speed*get_time_mark();
+	time=speed*time_mark;
 	int smooth((!speed && smooth_ == (int)RandomNoise::SMOOTH_SPLINE) ? (int)RandomNoise::SMOOTH_FAST_SPLINE : smooth_);
 
 	float ftime(time);
@@ -186,9 +299,9 @@ Noise::color_func(const Point &point, float pixel_size,Context /*context*/)const
 
 		if(super_sample && pixel_size) {
 			Real da = max(amount3, max(amount,amount2)) - min(amount3, min(amount,amount2));
-			ret = compiled_gradient.average(amount - da, amount + da);
+			ret = params.gradient.average(amount - da, amount + da);
 		} else {
-			ret = compiled_gradient.color(amount);
+			ret = params.gradient.color(amount);
 		}
 
 		if(do_alpha)
@@ -197,8 +310,8 @@ Noise::color_func(const Point &point, float pixel_size,Context /*context*/)const
 	return ret;
 }
 
-inline float
-Noise::calc_supersample(const synfig::Point &/*x*/, float /*pw*/,float /*ph*/)const
+float
+Noise::calc_supersample(const Params &/*params*/, const synfig::Point &/*x*/, float /*pw*/,float /*ph*/)
 {
 	return 0.0f;
 }
@@ -210,7 +323,7 @@ Noise::hit_check(synfig::Context context, const synfig::Point &point)const
 		return const_cast<Noise*>(this);
 	if(get_amount()==0.0)
 		return context.hit_check(point);
-	if(color_func(point,0,context).get_a()>0.5)
+	if(color_func(params,get_time_mark(),point,0).get_a()>0.5)
 		return const_cast<Noise*>(this);
 	return synfig::Layer::Handle();
 }
@@ -312,7 +425,7 @@ Noise::get_param_vocab()const
 Color
 Noise::get_color(Context context, const Point &point)const
 {
-	const Color color(color_func(point,0,context));
+	const Color color(color_func(params,get_time_mark(),point,0));
 
 	if(get_amount()==1.0 && get_blend_method()==Color::BLEND_STRAIGHT)
 		return color;
@@ -323,7 +436,7 @@ Noise::get_color(Context context, const Point &point)const
 CairoColor
 Noise::get_cairocolor(Context context, const Point &point)const
 {
-	const CairoColor color(color_func(point,0,context));
+	const CairoColor color(color_func(params,get_time_mark(),point,0));
 	
 	if(get_amount()==1.0 && get_blend_method()==Color::BLEND_STRAIGHT)
 		return color;
@@ -367,13 +480,13 @@ Noise::accelerated_render(Context context,Surface *surface,int quality, const Re
 	{
 		for(y=0,pos[1]=tl[1];y<h;y++,pen.inc_y(),pen.dec_x(x),pos[1]+=ph)
 			for(x=0,pos[0]=tl[0];x<w;x++,pen.inc_x(),pos[0]+=pw)
-				pen.put_value(color_func(pos,supersampleradius,context));
+				pen.put_value(color_func(params,get_time_mark(),pos,supersampleradius));
 	}
 	else
 	{
 		for(y=0,pos[1]=tl[1];y<h;y++,pen.inc_y(),pen.dec_x(x),pos[1]+=ph)
 			for(x=0,pos[0]=tl[0];x<w;x++,pen.inc_x(),pos[0]+=pw)
-				pen.put_value(Color::blend(color_func(pos,supersampleradius,context),pen.get_value(),get_amount(),get_blend_method()));
+				pen.put_value(Color::blend(color_func(params,get_time_mark(),pos,supersampleradius),pen.get_value(),get_amount(),get_blend_method()));
 	}
 
 	// Mark our progress as finished
@@ -382,3 +495,12 @@ Noise::accelerated_render(Context context,Surface *surface,int quality, const Re
 
 	return true;
 }
+
+rendering::Task::Handle
+Noise::build_composite_task_vfunc(ContextParams /*context_params*/)const
+{
+	TaskNoise::Handle task(new TaskNoise());
+	task->params = params;
+	task->time_mark = get_time_mark();
+	return task;
+}
@@ -47,6 +47,21 @@ class Noise : public synfig::Layer_Composite, public synfig::Layer_NoDeform
 {
 	SYNFIG_LAYER_MODULE_EXT
 
+public:
+	struct Params {
+		synfig::CompiledGradient gradient;
+		RandomNoise random;
+		synfig::Vector size;
+		int smooth;
+		int detail;
+		synfig::Real speed;
+		bool turbulent;
+		bool do_alpha;
+		bool super_sample;
+		inline Params():
+			smooth(), detail(), speed(), turbulent(), do_alpha(), super_sample() { }
+	};
+
 private:
 	//!Parameter: (Gradient)
 	synfig::ValueBase param_gradient;
@@ -70,10 +85,15 @@ private:
 	synfig::CompiledGradient compiled_gradient;
 
 	void compile();
-	synfig::Color color_func(const synfig::Point &x, float supersample,synfig::Context context)const;
-	float calc_supersample(const synfig::Point &x, float pw,float ph)const;
+	void fill_params(Params &params)const;
+
+	//! Parameters of color functions, updated on every change of layer parameters
+	Params params;
 
 public:
+	static synfig::Color color_func(const Params &params, synfig::Time time_mark, const synfig::Point &x, float supersample);
+	static float calc_supersample(const Params &params, const synfig::Point &x, float pw,float ph);
+
 	Noise();
 
 	virtual bool set_param(const synfig::String &param, const synfig::ValueBase &value);
@@ -83,6 +103,10 @@ public:
 	virtual bool accelerated_render(synfig::Context context,synfig::Surface *surface,int quality, const synfig::RendDesc &renddesc, synfig::ProgressCallback *cb)const;
 	synfig::Layer::Handle hit_check(synfig::Context context, const synfig::Point &point)const;
 	virtual Vocab get_param_vocab()const;
+
+protected:
+	virtual void on_static_param_changed(const synfig::String &param);
+	virtual synfig::rendering::Task::Handle build_composite_task_vfunc(synfig::ContextParams context_params)const;
 };
 
 /* === E N D =============================================================== */
@@ -34,10 +34,12 @@
 
 #include <synfig/localization.h>
 #include <synfig/general.h>
+#include <synfig/threadpool.h>
 
 #include <glib/gstdio.h>
 #include "trgt_png.h"
 #include <png.h>
+#include <algorithm>
 #include <cstdio>
 #include <ETL/misc>
 #include <string.h>
@@ -60,43 +62,60 @@ SYNFIG_TARGET_SET_VERSION(png_trgt,"0.1");
 /* === M E T H O D S ======================================================= */
 
 void
-png_trgt::png_out_error(png_struct *png_data,const char *msg)
+png_trgt::png_out_error(png_struct * /* png_data */,const char *msg)
 {
-	png_trgt *me=(png_trgt*)png_get_error_ptr(png_data);
+	// libpng jumps to the setjmp point of write_image() when this returns
 	synfig::error(strprintf("png_trgt: error: %s",msg));
-	me->ready=false;
 }
 
 void
-png_trgt::png_out_warning(png_struct *png_data,const char *msg)
+png_trgt::png_out_warning(png_struct * /* png_data */,const char *msg)
 {
-	png_trgt *me=(png_trgt*)png_get_error_ptr(png_data);
 	synfig::warning(strprintf("png_trgt: warning: %s",msg));
-	me->ready=false;
 }
 
 
 //Target *png_trgt::New(const char *filename){	return new png_trgt(filename);}
 
 png_trgt::png_trgt(const char *Filename, const synfig::TargetParam &params):
-	file(NULL),
-	png_ptr(NULL),
-	info_ptr(NULL),
 	multi_image(),
-	ready(false),
 	imagecount(),
 	filename(Filename),
-	buffer(NULL),
 	color_buffer(NULL),
-	sequence_separator(params.sequence_separator)
-{ }
+	sequence_separator(params.sequence_separator),
+	compression_level(params.compression_level),
+	filter(PNG_FILTER_NONE),
+	bit_depth(params.bit_depth == 16 ? 16 : 8),
+	image(NULL),
+	curr_scanline(),
+	running_jobs(),
+	failed()
+{
+	if (params.png_filter == "sub")
+		filter = PNG_FILTER_SUB;
+	else if (params.png_filter == "up")
+		filter = PNG_FILTER_UP;
+	else if (params.png_filter == "avg")
+		filter = PNG_FILTER_AVG;
+	else if (params.png_filter == "paeth")
+		filter = PNG_FILTER_PAETH;
+	else if (params.png_filter == "all")
+		filter = PNG_ALL_FILTERS;
+	else if (!params.png_filter.empty() && params.png_filter != "none")
+		synfig::warning("png_trgt: unknown filter '%s', using 'none'", params.png_filter.c_str());
+}
 
 png_trgt::~png_trgt()
 {
-	if(file)
-		fclose(file);
-	file=NULL;
-	delete [] buffer;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while(running_jobs > 0)
+			ThreadPool::instance().wait(cond, lock);
+		if (failed)
+			synfig::error("png_trgt: unable to write some frames of \"%s\"", filename.c_str());
+	}
+	close_image(image);
+	image=NULL;
 	delete [] color_buffer;
 }
 
@@ -113,94 +132,82 @@ png_trgt::set_rend_desc(RendDesc *given_desc)
 	return true;
 }
 
-void
-png_trgt::end_frame()
+bool
+png_trgt::init(synfig::ProgressCallback * /* cb */)
 {
-	if(ready && file)
-	{
-		png_write_end(png_ptr,info_ptr);
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-	}
-
-	if(file && file!=stdout)
-		fclose(file);
-	file=NULL;
-	imagecount++;
-	ready=false;
+	title=get_canvas()->get_name();
+	description=get_canvas()->get_description();
+	return true;
 }
 
 bool
-png_trgt::start_frame(synfig::ProgressCallback *callback)
+png_trgt::is_failed()
 {
-	int w=desc.get_w(),h=desc.get_h();
+	std::lock_guard<std::mutex> lock(mutex);
+	return failed;
+}
 
-	if(file && file!=stdout)
-		fclose(file);
-	if(filename=="-")
-	{
-		if(callback)callback->task(strprintf("(stdout) %d",imagecount).c_str());
-		file=stdout;
-	}
-	else if(multi_image)
-	{
-		String newfilename(filename_sans_extension(filename) +
-						   sequence_separator +
-						   etl::strprintf("%04d",imagecount) +
-						   filename_extension(filename));
-		file=g_fopen(newfilename.c_str(),POPEN_BINARY_WRITE_TYPE);
-		if(callback)callback->task(newfilename);
-	}
-	else
-	{
-		file=g_fopen(filename.c_str(),POPEN_BINARY_WRITE_TYPE);
-		if(callback)callback->task(filename);
-	}
+void
+png_trgt::set_failed()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	failed = true;
+}
 
-	if(!file)
+void
+png_trgt::close_image(Image *image)
+{
+	if (!image)
+		return;
+	if (image->file && image->file!=stdout)
+		fclose(image->file);
+	delete image;
+}
+
+bool
+png_trgt::write_image(const Image &image, int compression_level, int filter)
+{
+	if (!image.file)
 		return false;
 
-	delete [] buffer;
-	buffer=new unsigned char[4*w];
+	// prepared before setjmp, longjmp skips destructors
+	std::vector<png_bytep> rows(image.height);
+	for(int y = 0; y < image.height; ++y)
+		rows[y] = const_cast<png_bytep>(&image.pixels[y*image.get_row_size()]);
 
-	delete [] color_buffer;
-	color_buffer=new Color[w];
-
-	png_ptr=png_create_write_struct(PNG_LIBPNG_VER_STRING, (png_voidp)this,png_out_error, png_out_warning);
+	png_structp png_ptr=png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, png_out_error, png_out_warning);
 	if (!png_ptr)
 	{
 		synfig::error("Unable to setup PNG struct");
-		fclose(file);
 		return false;
 	}
 
-	info_ptr= png_create_info_struct(png_ptr);
+	png_infop info_ptr= png_create_info_struct(png_ptr);
 	if (!info_ptr)
 	{
 		synfig::error("Unable to setup PNG info struct");
-		fclose(file);
 		png_destroy_write_struct(&png_ptr,(png_infopp)NULL);
 		return false;
 	}
 
 	if (setjmp(png_jmpbuf(png_ptr)))
 	{
-		synfig::error("Unable to setup longjump");
 		png_destroy_write_struct(&png_ptr, &info_ptr);
-		fclose(file);
 		return false;
 	}
-	png_init_io(png_ptr,file);
-	png_set_filter(png_ptr,0,PNG_FILTER_NONE);
 
-	setjmp(png_jmpbuf(png_ptr));
-	if (get_alpha_mode()==TARGET_ALPHA_MODE_KEEP)
-		png_set_IHDR(png_ptr,info_ptr,w,h,8,PNG_COLOR_TYPE_RGBA,PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
-	else
-		png_set_IHDR(png_ptr,info_ptr,w,h,8,PNG_COLOR_TYPE_RGB,PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
+	png_init_io(png_ptr,image.file);
+	png_set_filter(png_ptr,0,filter);
+	if (compression_level >= 0)
+		png_set_compression_level(png_ptr,compression_level);
+
+	png_set_IHDR(png_ptr,info_ptr,image.width,image.height,image.depth,
+		image.channels == 4 ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB,
+		PNG_INTERLACE_NONE,PNG_COMPRESSION_TYPE_DEFAULT,PNG_FILTER_TYPE_DEFAULT);
 
 	// Write the physical size
-	png_set_pHYs(png_ptr,info_ptr,round_to_int(desc.get_x_res()),round_to_int(desc.get_y_res()),PNG_RESOLUTION_METER);
-	
+	png_set_pHYs(png_ptr,info_ptr,round_to_int(image.x_res),round_to_int(image.y_res),PNG_RESOLUTION_METER);
+
 	// Explicit set gamma value to 2.2 (it's a default value)
 	png_set_gAMA(png_ptr,info_ptr,1/2.2);
 
@@ -215,12 +222,12 @@ png_trgt::start_frame(synfig::ProgressCallback *callback)
 
 	comments[0].compression = PNG_TEXT_COMPRESSION_NONE;
 	comments[0].key         = title;
-	comments[0].text        = const_cast<char *>(get_canvas()->get_name().c_str());
+	comments[0].text        = const_cast<char *>(image.title.c_str());
 	comments[0].text_length = strlen(comments[0].text);
 
 	comments[1].compression = PNG_TEXT_COMPRESSION_NONE;
 	comments[1].key         = description;
-	comments[1].text        = const_cast<char *>(get_canvas()->get_description().c_str());
+	comments[1].text        = const_cast<char *>(image.description.c_str());
 	comments[1].text_length = strlen(comments[1].text);
 
 	comments[2].compression = PNG_TEXT_COMPRESSION_NONE;
@@ -230,29 +237,156 @@ png_trgt::start_frame(synfig::ProgressCallback *callback)
 
 	png_set_text(png_ptr, info_ptr, comments, sizeof(comments)/sizeof(png_text));
 
-	png_write_info_before_PLTE(png_ptr, info_ptr);
 	png_write_info(png_ptr, info_ptr);
-	ready=true;
+	png_write_image(png_ptr, &rows.front());
+	png_write_end(png_ptr, info_ptr);
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+	return true;
+}
+
+void
+png_trgt::write_image_job(Image *image)
+{
+	bool success = write_image(*image, compression_level, filter);
+	close_image(image);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!success) failed = true;
+	--running_jobs;
+	cond.notify_all();
+}
+
+void
+png_trgt::end_frame()
+{
+	imagecount++;
+	if (!image)
+		return;
+
+	Image *ready_image = image;
+	image = NULL;
+
+	if (multi_image && ready_image->file != stdout)
+	{
+		// don't keep more frames in memory than pool can compress at once
+		int max_jobs = std::max(1, ThreadPool::instance().get_max_threads());
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while(running_jobs >= max_jobs)
+				ThreadPool::instance().wait(cond, lock);
+			++running_jobs;
+		}
+		ThreadPool::instance().enqueue(
+			sigc::bind(sigc::mem_fun(*this, &png_trgt::write_image_job), ready_image) );
+	}
+	else
+	{
+		if (!write_image(*ready_image, compression_level, filter))
+			set_failed();
+		close_image(ready_image);
+	}
+}
+
+bool
+png_trgt::start_frame(synfig::ProgressCallback *callback)
+{
+	int w=desc.get_w(),h=desc.get_h();
+
+	close_image(image);
+	image=NULL;
+
+	// frames are compressed asynchronously, so failure of previous
+	// frame is reported here
+	if(is_failed())
+	{
+		if(callback)callback->error(_("Unable to write previous frame"));
+		return false;
+	}
+
+	image = new Image();
+
+	if(filename=="-")
+	{
+		if(callback)callback->task(strprintf("(stdout) %d",imagecount).c_str());
+		image->file=stdout;
+	}
+	else if(multi_image)
+	{
+		String newfilename(filename_sans_extension(filename) +
+						   sequence_separator +
+						   etl::strprintf("%04d",imagecount) +
+						   filename_extension(filename));
+		image->file=g_fopen(newfilename.c_str(),POPEN_BINARY_WRITE_TYPE);
+		if(callback)callback->task(newfilename);
+	}
+	else
+	{
+		image->file=g_fopen(filename.c_str(),POPEN_BINARY_WRITE_TYPE);
+		if(callback)callback->task(filename);
+	}
+
+	if(!image->file)
+	{
+		close_image(image);
+		image=NULL;
+		return false;
+	}
+
+	image->width=w;
+	image->height=h;
+	image->channels=get_alpha_mode()==TARGET_ALPHA_MODE_KEEP ? 4 : 3;
+	image->depth=bit_depth;
+	image->x_res=desc.get_x_res();
+	image->y_res=desc.get_y_res();
+	image->title=title;
+	image->description=description;
+	image->pixels.resize(image->get_row_size()*h);
+
+	delete [] color_buffer;
+	color_buffer=new Color[w];
+	curr_scanline=0;
+
 	return true;
 }
 
 Color *
-png_trgt::start_scanline(int /*scanline*/)
+png_trgt::start_scanline(int scanline)
 {
+	curr_scanline=scanline;
 	return color_buffer;
 }
 
 bool
 png_trgt::end_scanline()
 {
-	if(!file || !ready)
+	if(!image || curr_scanline < 0 || curr_scanline >= image->height)
+		return false;
+	if(is_failed())
 		return false;
 
-	PixelFormat pf = get_alpha_mode()==TARGET_ALPHA_MODE_KEEP ? PF_RGB|PF_A : PF_RGB;
-	color_to_pixelformat(buffer, color_buffer, pf, 0, desc.get_w());
+	unsigned char *dst=&image->pixels[curr_scanline*image->get_row_size()];
 
-	setjmp(png_jmpbuf(png_ptr));
-	png_write_row(png_ptr,buffer);
+	if (image->depth == 16)
+	{
+		// PNG stores 16-bit samples in network byte order
+		const Color *src=color_buffer;
+		for(int x=0; x<image->width; ++x, ++src)
+			for(int c=0; c<image->channels; ++c, dst+=2)
+			{
+				ColorReal v=c == 0 ? src->get_r()
+						  : c == 1 ? src->get_g()
+						  : c == 2 ? src->get_b()
+						  : src->get_a();
+				unsigned int i=(unsigned int)(synfig::clamp(v, ColorReal(0), ColorReal(1))*65535.f + 0.5f);
+				dst[0]=(unsigned char)(i >> 8);
+				dst[1]=(unsigned char)(i & 0xff);
+			}
+	}
+	else
+	{
+		PixelFormat pf = image->channels == 4 ? PF_RGB|PF_A : PF_RGB;
+		color_to_pixelformat(dst, color_buffer, pf, 0, image->width);
+	}
 
 	return true;
 }
@@ -33,6 +33,9 @@
 #include <synfig/target_scanline.h>
 #include <synfig/targetparam.h>
 #include <cstdio>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 
 /* === M A C R O S ========================================================= */
 
@@ -44,24 +47,63 @@ class png_trgt : public synfig::Target_Scanline
 {
 	SYNFIG_TARGET_MODULE_EXT
 private:
-	FILE *file;
-	//int w,h;
-	png_structp png_ptr;
-	png_infop info_ptr;
+	//! Rendered frame converted to PNG pixels, waiting for compression
+	struct Image
+	{
+		FILE *file;
+		int width;
+		int height;
+		int channels;
+		int depth;
+		double x_res;
+		double y_res;
+		synfig::String title;
+		synfig::String description;
+		std::vector<unsigned char> pixels;
+
+		Image(): file(), width(), height(), channels(), depth(), x_res(), y_res() { }
+		size_t get_row_size() const { return (size_t)width*channels*depth/8; }
+	};
 
 	static void png_out_error(png_struct *png,const char *msg);
 	static void png_out_warning(png_struct *png,const char *msg);
-	bool multi_image,ready;
+	bool multi_image;
 	int imagecount;
 	synfig::String filename;
-	unsigned char *buffer;
 	synfig::Color *color_buffer;
 	synfig::String sequence_separator;
+	int compression_level;
+	int filter;
+	int bit_depth;
+	// copied from canvas in init(), because frames may be started by writer thread
+	synfig::String title;
+	synfig::String description;
+
+	Image *image;
+	int curr_scanline;
+
+	// frames of image sequence are compressed by ThreadPool,
+	// each one into its own file
+	std::mutex mutex;
+	std::condition_variable cond;
+	int running_jobs;
+	// writing of some frame failed, next frames are refused
+	bool failed;
+
+	bool is_failed();
+	void set_failed();
+
+	static bool write_image(const Image &image, int compression_level, int filter);
+	void write_image_job(Image *image);
+	static void close_image(Image *image);
+
 public:
-	png_trgt(const char *filename, const synfig::TargetParam& /* params */);
+	png_trgt(const char *filename, const synfig::TargetParam &params);
 	virtual ~png_trgt();
 
 	virtual bool set_rend_desc(synfig::RendDesc *desc);
+	virtual bool supports_async_output()const { return true; }
+	virtual bool init(synfig::ProgressCallback *cb);
 	virtual bool start_frame(synfig::ProgressCallback *cb);
 	virtual void end_frame();
 
@@ -0,0 +1,211 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file debug/trace.cpp
+**	\brief Trace of rendering tasks in Chrome trace format
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <ETL/stringf>
+
+#include <synfig/general.h>
+#include <synfig/localization.h>
+
+#include "trace.h"
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace etl;
+using namespace synfig;
+using namespace debug;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+struct Event {
+	const char *category;
+	const char *name;
+	long long begin;
+	long long end;
+	RectInt rect;
+};
+
+// mutex of buffer is locked only by own thread and by start() and stop(),
+// so usually it's not contended
+struct ThreadBuffer {
+	std::mutex mutex;
+	int id;
+	String name;
+	std::vector<Event> events;
+	long long count;
+	ThreadBuffer(int id): id(id), events(Trace::buffer_size), count() { }
+};
+
+std::mutex mutex;
+String filename;
+long long start_time;
+
+// buffers are never removed, because threads keep pointers to them,
+// start() just clears them
+std::vector<std::unique_ptr<ThreadBuffer> > buffers;
+thread_local ThreadBuffer *thread_buffer;
+thread_local String thread_name;
+
+ThreadBuffer& get_thread_buffer() {
+	if (!thread_buffer) {
+		std::lock_guard<std::mutex> lock(mutex);
+		buffers.emplace_back(new ThreadBuffer((int)buffers.size() + 1));
+		buffers.back()->name = thread_name;
+		thread_buffer = buffers.back().get();
+	}
+	return *thread_buffer;
+}
+
+String escape(const String &s) {
+	String r;
+	for(String::const_iterator i = s.begin(); i != s.end(); ++i)
+		if (*i == '"' || *i == '\\') { r += '\\'; r += *i; } else
+		if ((unsigned char)*i < 32) r += ' '; else
+			r += *i;
+	return r;
+}
+
+} // end of anonymous namespace
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+std::atomic<bool> Trace::enabled;
+
+long long
+Trace::get_time()
+	{ return g_get_monotonic_time(); }
+
+void
+Trace::start(const String &filename)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for(std::vector<std::unique_ptr<ThreadBuffer> >::const_iterator i = buffers.begin(); i != buffers.end(); ++i) {
+		std::lock_guard<std::mutex> buffer_lock((*i)->mutex);
+		(*i)->count = 0;
+	}
+	::filename = filename;
+	start_time = get_time();
+	enabled = true;
+}
+
+bool
+Trace::stop()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!enabled) return false;
+	// add() checks this flag under lock of thread buffer,
+	// so buffers will not be changed after they are locked below
+	enabled = false;
+
+	FILE *f = g_fopen(::filename.c_str(), "w");
+	if (!f) {
+		synfig::error(_("Cannot write trace file '%s'"), ::filename.c_str());
+		return false;
+	}
+
+	fprintf(f, "{\"traceEvents\":[\n");
+	bool first = true;
+	for(std::vector<std::unique_ptr<ThreadBuffer> >::const_iterator i = buffers.begin(); i != buffers.end(); ++i) {
+		ThreadBuffer &b = **i;
+		std::lock_guard<std::mutex> buffer_lock(b.mutex);
+		if (!b.count) continue;
+
+		String name = b.name.empty() ? strprintf("thread %d", b.id) : b.name;
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",\n", b.id, escape(name).c_str() );
+		first = false;
+
+		long long count = b.count;
+		for(long long j = std::max(0ll, count - buffer_size); j < count; ++j) {
+			const Event &e = b.events[j % buffer_size];
+			fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld",
+				escape(e.name).c_str(), escape(e.category).c_str(), b.id,
+				e.begin - start_time, e.end - e.begin );
+			if (e.rect.is_valid())
+				fprintf(f, ",\"args\":{\"rect\":\"%d %d %d %d\",\"pixels\":%lld}",
+					e.rect.minx, e.rect.miny, e.rect.maxx, e.rect.maxy,
+					(long long)e.rect.get_width()*e.rect.get_height() );
+			fprintf(f, "}");
+		}
+	}
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	bool success = !ferror(f);
+	fclose(f);
+	return success;
+}
+
+void
+Trace::set_thread_name(const String &name)
+{
+	thread_name = name;
+	if (!enabled) return;
+	ThreadBuffer &b = get_thread_buffer();
+	std::lock_guard<std::mutex> lock(b.mutex);
+	b.name = name;
+}
+
+void
+Trace::add(
+	const char *category,
+	const char *name,
+	long long begin,
+	long long end,
+	const RectInt &rect )
+{
+	if (!enabled) return;
+	ThreadBuffer &b = get_thread_buffer();
+	std::lock_guard<std::mutex> lock(b.mutex);
+	if (!enabled) return;
+	Event &e = b.events[b.count % buffer_size];
+	e.category = category;
+	e.name = name;
+	e.begin = begin;
+	e.end = end;
+	e.rect = rect;
+	++b.count;
+}
+
+/* === E N T R Y P O I N T ================================================= */
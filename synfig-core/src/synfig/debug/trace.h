@@ -0,0 +1,98 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file debug/trace.h
+**	\brief Trace of rendering tasks in Chrome trace format
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_DEBUG_TRACE_H
+#define __SYNFIG_DEBUG_TRACE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <atomic>
+
+#include <synfig/rect.h>
+#include <synfig/string.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig {
+namespace debug {
+
+//! Collects time intervals of rendering tasks and writes them
+//! into JSON file in Chrome trace format (chrome://tracing, Perfetto).
+//! Each thread has own ring buffer with own mutex, so recording threads don't wait for each other.
+//! Category and name of event should be static strings (like names of task tokens).
+class Trace {
+public:
+	//! maximum count of events stored for each thread, older events are overwritten
+	static const int buffer_size = 65536;
+
+	class Scope {
+	private:
+		const char *category;
+		const char *name;
+		long long begin;
+		Scope(const Scope&): category(), name(), begin() { }
+		Scope& operator= (const Scope&) { return *this; }
+	public:
+		Scope(const char *category, const char *name):
+			category(category), name(name), begin(is_enabled() ? get_time() : 0) { }
+		~Scope()
+			{ if (begin) add(category, name, begin, get_time()); }
+	};
+
+private:
+	static std::atomic<bool> enabled;
+
+public:
+	static bool is_enabled()
+		{ return enabled; }
+
+	//! monotonic time in microseconds
+	static long long get_time();
+
+	//! Starts recording of events, events will be written into \a filename by stop()
+	static void start(const String &filename);
+	//! Stops recording and writes file, returns false if trace was not started or file was not written
+	static bool stop();
+
+	//! Sets name of current thread for trace viewer
+	static void set_thread_name(const String &name);
+
+	static void add(
+		const char *category,
+		const char *name,
+		long long begin,
+		long long end,
+		const RectInt &rect = RectInt::zero() );
+};
+
+}; // END of namespace debug
+}; // END of namespace synfig
+
+/* === E N D =============================================================== */
+
+#endif
@@ -38,6 +38,7 @@
 #include <map>
 
 #include <glibmm.h>
+#include <sigc++/bind.h>
 
 #include "general.h"
 #include <synfig/localization.h>
@@ -46,6 +47,7 @@
 #include "importer.h"
 #include "string.h"
 #include "surface.h"
+#include "threadpool.h"
 
 #include <synfig/rendering/software/surfacesw.h>
 #include <synfig/rendering/software/surfaceswpacked.h>
@@ -63,6 +65,8 @@ using namespace synfig;
 Importer::Book* synfig::Importer::book_;
 
 static map<FileSystem::Identifier,Importer::LooseHandle> *__open_importers;
+// importers may be released by preloading threads, see Importer::unref()
+static std::mutex __open_importers_mutex;
 
 /* === P R O C E D U R E S ================================================= */
 
@@ -73,12 +77,13 @@ Importer::subsys_init()
 {
 	book_=new Book();
 	__open_importers=new map<FileSystem::Identifier,Importer::LooseHandle>();
-	return true;
+	return ImporterCache::subsys_init();
 }
 
 bool
 Importer::subsys_stop()
 {
+	ImporterCache::subsys_stop();
 	delete book_;
 	delete __open_importers;
 	return true;
@@ -103,10 +108,13 @@ Importer::open(const FileSystem::Identifier &identifier, bool force)
 
 	// If we already have an importer open under that filename,
 	// then use it instead.
-	if(__open_importers->count(identifier))
 	{
-		//synfig::info("Found importer already open, using it...");
-		return (*__open_importers)[identifier];
+		std::lock_guard<std::mutex> lock(__open_importers_mutex);
+		if(__open_importers->count(identifier))
+		{
+			//synfig::info("Found importer already open, using it...");
+			return (*__open_importers)[identifier];
+		}
 	}
 
 	if(filename_extension(identifier.filename) == "")
@@ -129,6 +137,7 @@ Importer::open(const FileSystem::Identifier &identifier, bool force)
 	try {
 		Importer::Handle importer;
 		importer=Importer::book()[ext].factory(identifier);
+		std::lock_guard<std::mutex> lock(__open_importers_mutex);
 		(*__open_importers)[identifier]=importer;
 		return importer;
 	}
@@ -141,42 +150,145 @@ Importer::open(const FileSystem::Identifier &identifier, bool force)
 
 void Importer::forget(const FileSystem::Identifier &identifier)
 {
-	__open_importers->erase(identifier);
+	{
+		std::lock_guard<std::mutex> lock(__open_importers_mutex);
+		__open_importers->erase(identifier);
+	}
+	ImporterCache::instance().forget(identifier);
 }
 
 Importer::Importer(const FileSystem::Identifier &identifier):
+	preloading_(false),
 	identifier(identifier)
 {
 }
 
 
 Importer::~Importer()
+	{ }
+
+bool
+Importer::unref()const
 {
-	// Remove ourselves from the open importer list
-	map<FileSystem::Identifier,Importer::LooseHandle>::iterator iter;
-	for(iter=__open_importers->begin();iter!=__open_importers->end();)
-		if(iter->second==this)
-			__open_importers->erase(iter++); else ++iter;
+	{
+		// Last reference and removal from the open importer list are done
+		// under the same lock, so open() can't take the dying importer
+		std::lock_guard<std::mutex> lock(__open_importers_mutex);
+		if (unref_inactive())
+			return true;
+		map<FileSystem::Identifier,Importer::LooseHandle>::iterator iter;
+		for(iter=__open_importers->begin();iter!=__open_importers->end();)
+			if(iter->second==this)
+				__open_importers->erase(iter++); else ++iter;
+	}
+	delete this;
+	return false;
 }
 
-rendering::Surface::Handle
-Importer::get_frame(const RendDesc & /* renddesc */, const Time &time)
+ImporterCache::Key
+Importer::get_frame_key(const RendDesc & /* renddesc */, const Time &time)
 {
-	if (last_surface_ && last_surface_->is_exists() && !is_animated())
-		return last_surface_;
+	// frames are always decoded in native size, see load_frame()
+	return ImporterCache::Key(identifier, is_animated() ? time : Time(0));
+}
 
+rendering::Surface::Handle
+Importer::load_frame(const RendDesc & /* renddesc */, const Time &time)
+{
 	Surface surface;
 	if(!get_frame(surface, RendDesc(), time))
 		warning(strprintf("Unable to get frame from \"%s\"", identifier.filename.c_str()));
+	return create_surface(surface);
+}
 
+rendering::Surface::Handle
+Importer::create_surface(const Surface &surface)
+{
+	rendering::Surface::Handle result;
 	const char *s = getenv("SYNFIG_PACK_IMAGES");
 	if (s == nullptr || atoi(s) != 0)
-		last_surface_ = new rendering::SurfaceSWPacked();
+		result = new rendering::SurfaceSWPacked();
 	else
-		last_surface_ = new rendering::SurfaceSW();
+		result = new rendering::SurfaceSW();
 
 	if (surface.is_valid())
-		last_surface_->assign(surface[0], surface.get_w(), surface.get_h());
+		result->assign(surface[0], surface.get_w(), surface.get_h());
+
+	return result;
+}
+
+rendering::Surface::Handle
+Importer::load_cached_frame(const RendDesc &renddesc, const Time &time)
+{
+	// mutex_ must be already locked
+	ImporterCache::Key key = get_frame_key(renddesc, time);
+	rendering::Surface::Handle surface = ImporterCache::instance().get(key);
+	if (!surface) {
+		surface = load_frame(renddesc, time);
+		ImporterCache::instance().put(key, surface);
+	}
+	return surface;
+}
+
+void
+Importer::schedule_preload(const RendDesc &renddesc, const Time &time)
+{
+	ImporterCache &cache = ImporterCache::instance();
+	int count = cache.get_preload_frames();
+	float fps = renddesc.get_frame_rate();
+	if (count <= 0 || fps <= 0 || cache.get_memory_limit() <= 0)
+		return;
+	if (preloading_.exchange(true))
+		return; // previous preloading is not finished yet
+
+	std::vector<Time> times;
+	for(int i = 1; i <= count; ++i) {
+		Time t = time + Time(i/fps);
+		if (!cache.contains(get_frame_key(renddesc, t)))
+			times.push_back(t);
+	}
+	if (times.empty()) {
+		preloading_ = false;
+		return;
+	}
+
+	// handle keeps importer alive until preloading is done
+	ThreadPool::instance().enqueue(
+		sigc::bind(sigc::ptr_fun(&Importer::preload), Handle(this), renddesc, times) );
+}
+
+void
+Importer::preload(Handle importer, RendDesc renddesc, std::vector<Time> times)
+{
+	ImporterCache &cache = ImporterCache::instance();
+	try {
+		for(std::vector<Time>::const_iterator i = times.begin(); i != times.end(); ++i) {
+			std::lock_guard<std::mutex> lock(importer->mutex_);
+			ImporterCache::Key key = importer->get_frame_key(renddesc, *i);
+			if (!cache.contains(key))
+				cache.put(key, importer->load_frame(renddesc, *i));
+		}
+	} catch(...) {
+		synfig::warning("Importer: unable to preload frames from \"%s\"", importer->identifier.filename.c_str());
+	}
+	importer->preloading_ = false;
+}
+
+rendering::Surface::Handle
+Importer::get_frame(const RendDesc &renddesc, const Time &time)
+{
+	if (!is_animated()) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!last_surface_ || !last_surface_->is_exists())
+			last_surface_ = load_cached_frame(renddesc, time);
+		return last_surface_;
+	}
 
-	return last_surface_;
+	rendering::Surface::Handle surface;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		surface = load_cached_frame(renddesc, time);
+	}
+	schedule_preload(renddesc, time);
+	return surface;
 }
@@ -29,11 +29,15 @@
 
 #include <cstdio>
 
+#include <atomic>
 #include <map>
+#include <mutex>
+#include <vector>
 
 #include <ETL/handle>
 
 #include "filesystem.h"
+#include "importercache.h"
 #include "progresscallback.h"
 #include "renddesc.h"
 #include "string.h"
@@ -144,16 +148,33 @@ public:
 
 private:
 	rendering::Surface::Handle last_surface_;
+	//! serializes decoding, importers are not thread-safe
+	std::mutex mutex_;
+	std::atomic<bool> preloading_;
+
+	rendering::Surface::Handle load_cached_frame(const RendDesc &renddesc, const Time &time);
+	void schedule_preload(const RendDesc &renddesc, const Time &time);
+	static void preload(Handle importer, RendDesc renddesc, std::vector<Time> times);
 
 protected:
 
 	Importer(const FileSystem::Identifier &identifier);
 
+	//! Returns key of frame in ImporterCache, called without lock, so it should be thread-safe
+	virtual ImporterCache::Key get_frame_key(const RendDesc &renddesc, const Time &time);
+	//! Decodes frame which was not found in ImporterCache
+	virtual rendering::Surface::Handle load_frame(const RendDesc &renddesc, const Time &time);
+	//! Converts decoded \a surface for the renderer, packed unless SYNFIG_PACK_IMAGES=0
+	static rendering::Surface::Handle create_surface(const Surface &surface);
+
 public:
 	const FileSystem::Identifier identifier;
 
 	virtual ~Importer();
 
+	//! Removes importer from the list of open importers together with the last reference
+	virtual bool unref()const;
+
 	//! Gets a frame and puts it into \a surface
 	/*!	\param	surface Reference to surface to put frame into
 	**	\param	time	For animated importers, determines which frame to get.
@@ -164,6 +185,9 @@ public:
 	*/
 	virtual bool get_frame(Surface &surface, const RendDesc &renddesc, Time time, ProgressCallback *callback=nullptr) = 0;
 
+	//! Returns decoded frame, takes it from ImporterCache when possible.
+	//! Animated importers also decode next frames in background,
+	//! see ImporterCache::get_preload_frames()
 	virtual rendering::Surface::Handle get_frame(const RendDesc &renddesc, const Time &time);
 
 	//! Returns \c true if the importer pays attention to the \a time parameter of get_frame()
@@ -0,0 +1,254 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file importercache.cpp
+**	\brief Cache of decoded frames shared by all importers
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cassert>
+#include <cstdlib>
+
+#include <algorithm>
+
+#include "general.h"
+#include <synfig/localization.h>
+
+#include "importercache.h"
+
+#include <synfig/rendering/software/surfaceswpacked.h>
+
+#endif
+
+/* === U S I N G =========================================================== */
+
+using namespace synfig;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+ImporterCache* ImporterCache::instance_ = NULL;
+
+/* === M E T H O D S ======================================================= */
+
+ImporterCache::ImporterCache():
+	memory_limit(default_memory_limit),
+	preload_frames(0),
+	memory(0),
+	last_access(0),
+	hits(0),
+	misses(0),
+	evictions(0)
+{
+	if (const char *s = getenv("SYNFIG_IMPORTER_CACHE_SIZE"))
+		memory_limit = std::max(0ll, atoll(s))*1024*1024;
+	if (const char *s = getenv("SYNFIG_IMPORTER_PRELOAD_FRAMES"))
+		preload_frames = std::max(0, atoi(s));
+}
+
+ImporterCache::~ImporterCache()
+	{ log_statistics(); }
+
+ImporterCache&
+ImporterCache::instance()
+{
+	assert(instance_);
+	return *instance_;
+}
+
+bool
+ImporterCache::subsys_init()
+{
+	if (!instance_)
+		instance_ = new ImporterCache();
+	return true;
+}
+
+bool
+ImporterCache::subsys_stop()
+{
+	delete instance_;
+	instance_ = NULL;
+	return true;
+}
+
+long long
+ImporterCache::get_memory_size(const rendering::Surface &surface)
+{
+	if (const rendering::SurfaceSWPacked *packed = dynamic_cast<const rendering::SurfaceSWPacked*>(&surface))
+		return (long long)packed->get_surface().get_memory_size();
+	return (long long)surface.get_pixels_count()*sizeof(Color);
+}
+
+void
+ImporterCache::touch(EntryMap::iterator i)
+{
+	// mutex must be already locked
+	access_order.erase(i->second.last_access);
+	i->second.last_access = ++last_access;
+	access_order[last_access] = i->first;
+}
+
+void
+ImporterCache::erase(EntryMap::iterator i)
+{
+	// mutex must be already locked
+	access_order.erase(i->second.last_access);
+	memory -= i->second.size;
+	entries.erase(i);
+}
+
+void
+ImporterCache::shrink()
+{
+	// mutex must be already locked
+	while(memory > memory_limit && !access_order.empty()) {
+		erase(entries.find(access_order.begin()->second));
+		++evictions;
+	}
+}
+
+rendering::Surface::Handle
+ImporterCache::get(const Key &key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	EntryMap::iterator i = entries.find(key);
+	if (i == entries.end()) {
+		++misses;
+		return rendering::Surface::Handle();
+	}
+	++hits;
+	touch(i);
+	return i->second.surface;
+}
+
+bool
+ImporterCache::contains(const Key &key) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.count(key) != 0;
+}
+
+void
+ImporterCache::put(const Key &key, const rendering::Surface::Handle &surface)
+{
+	if (!surface || !surface->is_exists())
+		return;
+	long long size = get_memory_size(*surface);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (size > memory_limit)
+		return;
+
+	EntryMap::iterator i = entries.find(key);
+	if (i != entries.end()) {
+		if (i->second.surface == surface) {
+			touch(i);
+			return;
+		}
+		erase(i);
+	}
+
+	Entry &entry = entries[key];
+	entry.surface = surface;
+	entry.size = size;
+	entry.last_access = ++last_access;
+	access_order[last_access] = key;
+	memory += size;
+
+	shrink();
+}
+
+void
+ImporterCache::forget(const FileSystem::Identifier &identifier)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for(EntryMap::iterator i = entries.begin(); i != entries.end();)
+		if (i->first.identifier == identifier) erase(i++); else ++i;
+}
+
+void
+ImporterCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.clear();
+	access_order.clear();
+	memory = 0;
+}
+
+long long
+ImporterCache::get_memory_limit() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return memory_limit;
+}
+
+void
+ImporterCache::set_memory_limit(long long memory_limit)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->memory_limit = std::max(0ll, memory_limit);
+	shrink();
+}
+
+int
+ImporterCache::get_preload_frames() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return preload_frames;
+}
+
+void
+ImporterCache::set_preload_frames(int preload_frames)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->preload_frames = std::max(0, preload_frames);
+}
+
+ImporterCache::Stats
+ImporterCache::get_stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Stats stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.evictions = evictions;
+	stats.memory = memory;
+	stats.entries = (long long)entries.size();
+	return stats;
+}
+
+void
+ImporterCache::log_statistics() const
+{
+	Stats stats = get_stats();
+	if (stats.hits || stats.misses)
+		info( "ImporterCache: %lld hits, %lld misses, %lld evictions, %lld frames in %lld bytes",
+			  stats.hits, stats.misses, stats.evictions, stats.entries, stats.memory );
+}
+
+/* === E N T R Y P O I N T ================================================= */
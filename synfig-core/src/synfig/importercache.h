@@ -0,0 +1,162 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file importercache.h
+**	\brief Cache of decoded frames shared by all importers
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_IMPORTERCACHE_H
+#define __SYNFIG_IMPORTERCACHE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <map>
+#include <mutex>
+
+#include "filesystem.h"
+#include "time.h"
+
+#include <synfig/rendering/surface.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig {
+
+//! Decoded frames of imported files, shared by all importers.
+//! Frames are identified by file, frame time and requested resolution,
+//! so importers opened again for the same file (image sequences, reloaded layers)
+//! don't decode it again. Total memory is bounded,
+//! least recently used frames are removed first.
+class ImporterCache
+{
+public:
+	struct Key
+	{
+		FileSystem::Identifier identifier;
+		Time::ticks_type frame;
+		int width;   //!< requested width, zero for native size
+		int height;  //!< requested height, zero for native size
+
+		Key(): frame(), width(), height() { }
+		Key(const FileSystem::Identifier &identifier, const Time &time, int width = 0, int height = 0):
+			identifier(identifier), frame(time.ticks()), width(width), height(height) { }
+
+		bool operator<(const Key &other) const
+		{
+			if (identifier < other.identifier) return true;
+			if (other.identifier < identifier) return false;
+			if (frame != other.frame) return frame < other.frame;
+			if (width != other.width) return width < other.width;
+			return height < other.height;
+		}
+	};
+
+	struct Stats
+	{
+		long long hits;        //!< frames taken from cache
+		long long misses;      //!< frames which was not found in cache
+		long long evictions;   //!< frames removed to fit memory limit
+		long long memory;      //!< bytes used by cached frames now
+		long long entries;     //!< count of cached frames now
+		Stats(): hits(), misses(), evictions(), memory(), entries() { }
+	};
+
+	//! default limit of memory used by cached frames
+	static const long long default_memory_limit = 256ll*1024*1024;
+
+private:
+	struct Entry
+	{
+		rendering::Surface::Handle surface;
+		long long size;
+		long long last_access;
+		Entry(): size(), last_access() { }
+	};
+
+	typedef std::map<Key, Entry> EntryMap;
+	typedef std::map<long long, Key> AccessMap;
+
+	mutable std::mutex mutex;
+
+	long long memory_limit;
+	int preload_frames;
+
+	long long memory;
+	long long last_access;
+	EntryMap entries;
+	AccessMap access_order;
+
+	long long hits;
+	long long misses;
+	long long evictions;
+
+	static ImporterCache *instance_;
+
+	void touch(EntryMap::iterator i);
+	void erase(EntryMap::iterator i);
+	void shrink();
+
+	ImporterCache();
+	ImporterCache(const ImporterCache&) = delete;
+	ImporterCache& operator=(const ImporterCache&) = delete;
+
+public:
+	~ImporterCache();
+
+	static ImporterCache& instance();
+	//! Creates the cache, limits are taken from environment variables
+	//! SYNFIG_IMPORTER_CACHE_SIZE (megabytes, zero disables cache)
+	//! and SYNFIG_IMPORTER_PRELOAD_FRAMES
+	static bool subsys_init();
+	static bool subsys_stop();
+
+	//! Returns cached frame or null handle, counts hit or miss
+	rendering::Surface::Handle get(const Key &key);
+	//! Checks presence of frame without touching statistics and access order
+	bool contains(const Key &key) const;
+	//! Stores decoded frame, removes least recently used frames when memory limit is exceeded
+	void put(const Key &key, const rendering::Surface::Handle &surface);
+	//! Removes all frames of file
+	void forget(const FileSystem::Identifier &identifier);
+	void clear();
+
+	long long get_memory_limit() const;
+	void set_memory_limit(long long memory_limit);
+
+	//! Count of next frames which animated importers decode in background
+	int get_preload_frames() const;
+	void set_preload_frames(int preload_frames);
+
+	Stats get_stats() const;
+	void log_statistics() const;
+
+	//! Estimated memory used by pixels of surface
+	static long long get_memory_size(const rendering::Surface &surface);
+};
+
+}; // END of namespace synfig
+
+/* === E N D =============================================================== */
+
+#endif
@@ -154,23 +154,32 @@ Importer(identifier)
 
 ListImporter::~ListImporter() = default;
 
-Importer::Handle
-ListImporter::get_sub_importer(const RendDesc &renddesc, Time time, ProgressCallback *cb)
+int
+ListImporter::get_frame_index(const RendDesc &renddesc, Time time) const
 {
 	float document_fps=renddesc.get_frame_rate();
 	int document_frame=etl::round_to_int(time*document_fps);
 	int frame=etl::floor_to_int(document_frame*fps/document_fps);
 
 	if(!filename_list.size())
+		return -1;
+
+	if(frame<0)frame=0;
+	if(frame>=(signed)filename_list.size())frame=filename_list.size()-1;
+	return frame;
+}
+
+Importer::Handle
+ListImporter::get_sub_importer(const RendDesc &renddesc, Time time, ProgressCallback *cb)
+{
+	int frame=get_frame_index(renddesc, time);
+	if(frame<0)
 	{
 		if (cb) cb->error(_("No images in list"));
 		else synfig::error(_("No images in list"));
 		return Importer::Handle();
 	}
 
-	if(frame<0)frame=0;
-	if(frame>=(signed)filename_list.size())frame=filename_list.size()-1;
-
 	const String &filename = filename_list[frame];
 	Importer::Handle importer(Importer::open(FileSystem::Identifier(FileSystemNative::instance(), filename)));
 	if(!importer)
@@ -197,11 +206,24 @@ ListImporter::get_frame(Surface &surface, const RendDesc &renddesc, Time time, P
 	return importer && importer->get_frame(surface, renddesc, 0, cb);
 }
 
+ImporterCache::Key
+ListImporter::get_frame_key(const RendDesc &renddesc, const Time &time)
+{
+	int frame=get_frame_index(renddesc, time);
+	if(frame<0)
+		return ImporterCache::Key(identifier, time);
+	// start time of the list frame, same for all document times showing it
+	return ImporterCache::Key(identifier, Time(frame/fps));
+}
+
 rendering::Surface::Handle
-ListImporter::get_frame(const RendDesc &renddesc, const Time &time)
+ListImporter::load_frame(const RendDesc &renddesc, const Time &time)
 {
-	Importer::Handle importer = get_sub_importer(renddesc, time, NULL);
-	return importer ? importer->get_frame(renddesc, 0) : new rendering::SurfaceSW();
+	// decoded directly, sub importers would cache the same frame once more
+	Surface surface;
+	if(!get_frame(surface, renddesc, time, NULL))
+		synfig::warning("Unable to get frame from \"%s\"", identifier.filename.c_str());
+	return create_surface(surface);
 }
 
 bool
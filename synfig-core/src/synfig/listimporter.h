@@ -52,15 +52,22 @@ private:
 	std::vector<String> filename_list;
 	std::list<Importer::Handle> frame_cache;
 
+	int get_frame_index(const RendDesc &renddesc, Time time) const;
 	Importer::Handle get_sub_importer(const RendDesc &renddesc, Time time, ProgressCallback *cb);
 
+protected:
+	//! Frames are cached under the identifier of the list and the start time of list frame,
+	//! so Importer::forget() of the list evicts them too
+	virtual ImporterCache::Key get_frame_key(const RendDesc &renddesc, const Time &time);
+	virtual rendering::Surface::Handle load_frame(const RendDesc &renddesc, const Time &time);
+
 public:
 	ListImporter(const FileSystem::Identifier &identifier);
 
 	~ListImporter();
 
+	using Importer::get_frame;
 	virtual bool get_frame(Surface &surface, const RendDesc &renddesc, Time time, ProgressCallback *cb=NULL);
-	virtual rendering::Surface::Handle get_frame(const RendDesc &renddesc, const Time &time);
 	virtual bool is_animated();
 
 };
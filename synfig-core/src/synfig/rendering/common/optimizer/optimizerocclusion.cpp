@@ -0,0 +1,176 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/optimizer/optimizerocclusion.cpp
+**	\brief OptimizerOcclusion
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+
+#include "optimizerocclusion.h"
+
+#include "../task/taskblend.h"
+#include "../task/taskpixelprocessor.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+	//! part of \a rect which is not covered by \a cover, if it is a rect,
+	//! otherwise returns \a rect as is
+	Rect get_uncovered(const Rect &rect, const Rect &cover)
+	{
+		Rect r = rect;
+		if (cover.minx <= rect.minx && cover.maxx >= rect.maxx) {
+			if (cover.miny <= rect.miny)
+				r.miny = std::max(rect.miny, cover.maxy);
+			else
+			if (cover.maxy >= rect.maxy)
+				r.maxy = std::min(rect.maxy, cover.miny);
+		} else
+		if (cover.miny <= rect.miny && cover.maxy >= rect.maxy) {
+			if (cover.minx <= rect.minx)
+				r.minx = std::max(rect.minx, cover.maxx);
+			else
+			if (cover.maxx >= rect.maxx)
+				r.maxx = std::min(rect.maxx, cover.minx);
+		}
+		return r;
+	}
+
+	//! Returns task without area covered by \a cover,
+	//! returns null when task is fully covered
+	//! and returns the same handle when nothing was changed
+	Task::Handle cull(const Task::Handle &task, const Rect &cover)
+	{
+		if (!task || !task->is_valid_coords())
+			return task;
+		if (cover.contains(task->source_rect))
+			return Task::Handle();
+
+		TaskBlend::Handle blend = TaskBlend::Handle::cast_dynamic(task);
+		TaskPixelProcessor::Handle processor = TaskPixelProcessor::Handle::cast_dynamic(task);
+		bool pass_cover = blend || processor; // sub-tasks in the same pixels
+
+		Task::Handle result = task;
+
+		Rect rect = get_uncovered(task->source_rect, cover);
+		if (rect != task->source_rect) {
+			// sub-tasks will be clipped separately when cover passes to them,
+			// other tasks should recalculate coordinates of the whole sub-tree
+			Task::Handle t = pass_cover ? task->clone() : task->clone_recursive();
+			RectInt prev = t->target_rect;
+			t->trunc_source_rect(rect);
+			if (t->target_rect != prev) {
+				if (!t->is_valid_coords())
+					return Task::Handle();
+				if (!pass_cover)
+					t->set_coords_sub_tasks();
+				result = t;
+			}
+		}
+
+		if (blend) {
+			Rect cover_a = cover;
+			if (blend->is_b_covers_a() && blend->sub_task_b())
+				cover_a = TaskBlend::merge_opaque_rects(cover, blend->sub_task_b()->calc_opaque_rect());
+			Task::Handle a = cull(blend->sub_task_a(), cover_a);
+			Task::Handle b = cull(blend->sub_task_b(), cover);
+			if (a != blend->sub_task_a() || b != blend->sub_task_b()) {
+				if (result == task) result = task->clone();
+				result->sub_task(0) = a;
+				result->sub_task(1) = b;
+			}
+		} else
+		if (processor) {
+			Task::Handle sub = cull(processor->sub_task(), cover);
+			if (sub != processor->sub_task()) {
+				if (result == task) result = task->clone();
+				result->sub_task(0) = sub;
+			}
+		}
+
+		return result;
+	}
+}
+
+/* === M E T H O D S ======================================================= */
+
+
+OptimizerOcclusion::OptimizerOcclusion()
+{
+	category_id = CATEGORY_ID_COORDS;
+	depends_from = CATEGORY_BEGIN;
+	mode = MODE_REPEAT_LAST;
+	for_task = true;
+}
+
+void
+OptimizerOcclusion::run(const RunParams& params) const
+{
+	//
+	//  blend(composite or straight, amount 1)
+	//  - blend
+	//    - taskA
+	//    - taskB
+	//  - taskC (opaque)
+	//
+	// parts of taskA and taskB covered by opaque part of taskC
+	// will not be rendered
+	//
+
+	TaskBlend::Handle blend = TaskBlend::Handle::cast_dynamic(params.ref_task);
+	if ( !blend
+	  || !blend->is_valid_coords()
+	  || !blend->is_b_covers_a()
+	  || !blend->sub_task_a()
+	  || !blend->sub_task_b() )
+		return;
+
+	Rect cover = blend->sub_task_b()->calc_opaque_rect();
+	if (!cover.is_valid())
+		return;
+
+	Task::Handle a = cull(blend->sub_task_a(), cover);
+	if (a == blend->sub_task_a())
+		return;
+
+	TaskBlend::Handle new_blend = TaskBlend::Handle::cast_dynamic(blend->clone());
+	new_blend->sub_task_a() = a;
+	apply(params, new_blend);
+}
+
+/* === E N T R Y P O I N T ================================================= */
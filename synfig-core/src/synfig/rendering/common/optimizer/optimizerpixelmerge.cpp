@@ -0,0 +1,132 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/optimizer/optimizerpixelmerge.cpp
+**	\brief OptimizerPixelMerge
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include "optimizerpixelmerge.h"
+
+#include "../task/taskpixelprocessor.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+
+OptimizerPixelMerge::OptimizerPixelMerge()
+{
+	category_id = CATEGORY_ID_COORDS;
+	depends_from = CATEGORY_BEGIN;
+	mode = MODE_REPEAT_LAST;
+	deep_first = true;
+	for_task = true;
+}
+
+void
+OptimizerPixelMerge::run(const RunParams& params) const
+{
+	//
+	// merge pixel processors
+	//
+	//  processorA(targetA)
+	//  - processorB(targetB)
+	//    - taskC(targetC)
+	//
+	// converts to:
+	//
+	//  processorAB(targetA)
+	//  - taskC(targetC)
+	//
+	// gamma with gamma and matrix with matrix give task of the same type,
+	// other combinations give TaskPixelChain
+	//
+
+	TaskPixelProcessor::Handle task = TaskPixelProcessor::Handle::cast_dynamic(params.ref_task);
+	if ( !task
+	  || task->is_transparent() // will be removed by OptimizerPass
+	  || !task->is_valid_coords() )
+		return;
+
+	TaskPixelProcessor::Handle sub_task = TaskPixelProcessor::Handle::cast_dynamic(task->sub_task());
+	if ( !sub_task
+	  || sub_task->is_transparent()
+	  || !sub_task->is_valid_coords() )
+		return;
+
+	// offsets of sub-tasks are calculated by resolution of processor
+	Vector ppu = task->get_pixels_per_unit();
+	Vector sub_ppu = sub_task->get_pixels_per_unit();
+	if ( !approximate_equal_lp(ppu[0], sub_ppu[0])
+	  || !approximate_equal_lp(ppu[1], sub_ppu[1]) )
+		return;
+
+	// sub-processor should be calculated for each pixel of processor,
+	// pixels out of its target rect are transparent for processor
+	// but not for merged task
+	RectInt sub_rect = sub_task->target_rect + task->target_rect.get_min() + task->get_offset();
+	if (!sub_rect.contains(task->target_rect))
+		return;
+
+	TaskPixelProcessor::Handle new_task;
+
+	TaskPixelGamma::Handle gamma = TaskPixelGamma::Handle::cast_dynamic(task);
+	TaskPixelGamma::Handle sub_gamma = TaskPixelGamma::Handle::cast_dynamic(sub_task);
+	TaskPixelColorMatrix::Handle matrix = TaskPixelColorMatrix::Handle::cast_dynamic(task);
+	TaskPixelColorMatrix::Handle sub_matrix = TaskPixelColorMatrix::Handle::cast_dynamic(sub_task);
+
+	if (gamma && sub_gamma) {
+		TaskPixelGamma::Handle new_gamma = TaskPixelGamma::Handle::cast_dynamic(gamma->clone());
+		new_gamma->gamma = sub_gamma->gamma * gamma->gamma;
+		new_task = new_gamma;
+	} else
+	if (matrix && sub_matrix) {
+		TaskPixelColorMatrix::Handle new_matrix = TaskPixelColorMatrix::Handle::cast_dynamic(matrix->clone());
+		new_matrix->matrix = sub_matrix->matrix * matrix->matrix;
+		new_task = new_matrix;
+	} else {
+		TaskPixelChain::Handle chain = new TaskPixelChain();
+		if (!chain->add(*sub_task) || !chain->add(*task))
+			return;
+		chain->assign(*task);
+		new_task = chain;
+	}
+
+	new_task->sub_task() = sub_task->sub_task();
+	apply(params, new_task);
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -29,6 +29,9 @@
 #	include <config.h>
 #endif
 
+#include <cstdlib>
+#include <algorithm>
+
 #include <synfig/general.h>
 #include <synfig/localization.h>
 
@@ -45,9 +48,40 @@ using namespace rendering;
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+	int get_grain(int grain) {
+		if (grain > 0)
+			return grain;
+		if (const char *s = getenv("SYNFIG_RENDERING_SPLIT_GRAIN"))
+			if (atoi(s) > 0)
+				return atoi(s);
+		return OptimizerSplit::default_grain;
+	}
+
+	Task::Handle clone_band(const Task &task, const RectInt &rect) {
+		Task::Handle band = task.clone();
+		band->trunc_target_rect(rect);
+
+		// Surface placeholder of the target (see TaskInterfaceTargetAsSource)
+		// should cover the band only, otherwise neighbour bands will be
+		// treated as intersected and will not run simultaneously
+		for(Task::List::iterator i = band->sub_tasks.begin(); i != band->sub_tasks.end(); ++i)
+			if ( *i
+			  && i->type_is<TaskSurface>()
+			  && (*i)->target_surface == band->target_surface )
+			{
+				*i = (*i)->clone();
+				(*i)->trunc_target_rect(rect);
+			}
+
+		return band;
+	}
+}
+
 /* === M E T H O D S ======================================================= */
 
-OptimizerSplit::OptimizerSplit()
+OptimizerSplit::OptimizerSplit(int grain):
+	grain(get_grain(grain))
 {
 	category_id = CATEGORY_ID_LIST;
 	depends_from = CATEGORY_SPECIALIZED;
@@ -58,7 +92,6 @@ void
 OptimizerSplit::run(const RunParams &params) const
 {
 	if (!params.list) return;
-	const int min_area = 256*256;
 	for(Task::List::iterator i = params.list->begin(); i != params.list->end(); ++i)
 	{
 		if (TaskInterfaceSplit *split = i->type_pointer<TaskInterfaceSplit>())
@@ -67,20 +100,24 @@ OptimizerSplit::run(const RunParams &params) const
 			RectInt r = (*i)->target_rect;
 			int w = r.maxx - r.minx;
 			int h = r.maxy - r.miny;
-			int t = std::min(h/10, w*h/min_area);
+			if (w <= 0 || h <= 0) continue;
+
+			// band is never smaller than grain,
+			// so already splitted tasks will not be splitted again
+			long long area = (long long)w*h;
+			int t = (int)std::min(area/grain, (long long)(h/min_rows));
 			if (t >= 2)
 			{
-				int hh = h/t;
-				int y = r.miny;
-				for(int j = 1; j < t; ++j, y += hh)
+				Task::Handle task = *i;
+				for(int j = 0; j < t; ++j)
 				{
-					Task::Handle task = (*i)->clone();
-					task->trunc_target_rect( RectInt(r.minx, y, r.maxx, y + hh) );
-					i = params.list->insert(i, task);
-					++i;
+					RectInt band(r.minx, r.miny + h*j/t, r.maxx, r.miny + h*(j + 1)/t);
+					if (j == 0) {
+						*i = clone_band(*task, band);
+					} else {
+						i = params.list->insert(i + 1, clone_band(*task, band));
+					}
 				}
-				*i = (*i)->clone();
-				(*i)->trunc_target_rect( RectInt(r.minx, y, r.maxx, r.maxy) );
 				apply(params);
 			}
 		}
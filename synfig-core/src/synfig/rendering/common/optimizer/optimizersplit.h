@@ -40,10 +40,24 @@ namespace synfig
 namespace rendering
 {
 
+//! Cuts target rect of splittable tasks into horizontal bands
+//! which may be processed by different threads simultaneously
 class OptimizerSplit: public Optimizer
 {
 public:
-	OptimizerSplit();
+	//! minimal height of band in pixels
+	static const int min_rows = 8;
+	//! default area of band in pixels: 64K pixels * sizeof(Color) = 1Mb
+	static const int default_grain = 64*1024;
+
+	//! desired area of one band in pixels,
+	//! tasks smaller than two bands are not splitted
+	const int grain;
+
+	//! creates optimizer with selected \a grain,
+	//! if \a grain is not positive then it will be taken from
+	//! environment variable SYNFIG_RENDERING_SPLIT_GRAIN or set to default_grain
+	explicit OptimizerSplit(int grain = 0);
 	virtual void run(const RunParams &params) const;
 };
 
@@ -0,0 +1,141 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/optimizer/optimizersurfaceformat.cpp
+**	\brief OptimizerSurfaceFormat
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <map>
+
+#include "optimizersurfaceformat.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+	std::vector<Surface::Token::Handle> make_tokens(
+		const Surface::Token::Handle &token,
+		const Surface::Token::Handle &fallback_token )
+	{
+		std::vector<Surface::Token::Handle> tokens;
+		if (token) tokens.push_back(token);
+		if (fallback_token) tokens.push_back(fallback_token);
+		return tokens;
+	}
+
+	struct SurfaceInfo {
+		int last_write;
+		int first_read;
+		bool skip;
+		RectInt rect;
+		Task::Handle last_writer;
+		SurfaceInfo(): last_write(-1), first_read(-1), skip(), rect(RectInt::zero()) { }
+	};
+}
+
+/* === M E T H O D S ======================================================= */
+
+
+OptimizerSurfaceFormat::OptimizerSurfaceFormat(
+	const Surface::Token::Handle &token,
+	const Surface::Token::Handle &fallback_token,
+	int min_area
+):
+	tokens(make_tokens(token, fallback_token)),
+	min_area(min_area)
+{
+	category_id = CATEGORY_ID_LIST;
+	depends_from = CATEGORY_SPECIALIZED;
+	for_list = true;
+}
+
+void
+OptimizerSurfaceFormat::run(const RunParams &params) const
+{
+	if (!params.list || tokens.empty()) return;
+	Task::List &list = *params.list;
+
+	typedef std::map<SurfaceResource::Handle, SurfaceInfo> InfoMap;
+	InfoMap surfaces;
+
+	for(int i = 0; i < (int)list.size(); ++i) {
+		const Task::Handle &task = list[i];
+		if (!task || !task->is_valid())
+			continue;
+
+		// already processed
+		if (task.type_is<TaskSurfaceConvert>())
+			{ surfaces[task->target_surface].skip = true; continue; }
+
+		for(Task::List::const_iterator j = task->sub_tasks.begin(); j != task->sub_tasks.end(); ++j)
+			if (*j && (*j)->is_valid()) {
+				SurfaceInfo &info = surfaces[(*j)->target_surface];
+				if (info.first_read < 0) info.first_read = i;
+			}
+
+		SurfaceInfo &info = surfaces[task->target_surface];
+		if (info.first_read >= 0)
+			info.skip = true; // surface is used as source and target, or rewritten after read
+		info.last_write = i;
+		info.last_writer = task;
+		info.rect |= task->target_rect;
+	}
+
+	// insert from the end of list to keep indices valid
+	std::map<int, Task::Handle> inserts;
+	for(InfoMap::const_iterator i = surfaces.begin(); i != surfaces.end(); ++i) {
+		const SurfaceInfo &info = i->second;
+		if ( info.skip
+		  || info.last_write < 0
+		  || info.first_read <= info.last_write + 1 // read immediately, nothing to wait
+		  || (long long)info.rect.get_width()*info.rect.get_height() < min_area )
+			continue;
+
+		TaskSurfaceConvert::Handle convert = new TaskSurfaceConvert();
+		convert->assign_target(*info.last_writer);
+		convert->target_rect = info.rect;
+		convert->tokens = tokens;
+		inserts[info.last_write] = convert;
+	}
+
+	for(std::map<int, Task::Handle>::const_reverse_iterator i = inserts.rbegin(); i != inserts.rend(); ++i)
+		list.insert(list.begin() + i->first + 1, i->second);
+
+	if (!inserts.empty())
+		apply(params);
+}
+
+/* === E N T R Y P O I N T ================================================= */
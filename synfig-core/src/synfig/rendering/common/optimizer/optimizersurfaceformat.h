@@ -0,0 +1,75 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/common/optimizer/optimizersurfaceformat.h
+**	\brief OptimizerSurfaceFormat Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_OPTIMIZERSURFACEFORMAT_H
+#define __SYNFIG_RENDERING_OPTIMIZERSURFACEFORMAT_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <vector>
+
+#include "../../optimizer.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Finds intermediate surfaces which are waiting for other tasks
+//! between the last write and the first read, and inserts TaskSurfaceConvert
+//! to keep them in narrow format while waiting.
+//! Format is selected at run time: the first of listed surface types
+//! which can hold the range of the result. Narrow types have lower precision,
+//! so conversion is lossy and should be used where quantization is acceptable.
+class OptimizerSurfaceFormat: public Optimizer
+{
+public:
+	//! default minimal area of surface in pixels, smaller surfaces are not converted
+	static const int default_min_area = 128*128;
+
+	//! surface types in order of preference, narrowest first
+	const std::vector<Surface::Token::Handle> tokens;
+	const int min_area;
+
+	explicit OptimizerSurfaceFormat(
+		const Surface::Token::Handle &token,
+		const Surface::Token::Handle &fallback_token = Surface::Token::Handle(),
+		int min_area = default_min_area );
+
+	virtual void run(const RunParams &params) const;
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
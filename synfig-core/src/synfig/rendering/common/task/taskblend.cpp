@@ -81,4 +81,50 @@ TaskBlend::calc_bounds() const
 	return bounds;
 }
 
+Rect
+TaskBlend::merge_opaque_rects(const Rect &a, const Rect &b)
+{
+	if (!a.is_valid()) return b.is_valid() ? b : Rect::zero();
+	if (!b.is_valid()) return a;
+	if (a.contains(b)) return a;
+	if (b.contains(a)) return b;
+
+	// rects with the same side and touched or intersected gives a rect
+	if ( approximate_equal(a.minx, b.minx) && approximate_equal(a.maxx, b.maxx)
+	  && approximate_less_or_equal(a.miny, b.maxy) && approximate_less_or_equal(b.miny, a.maxy) )
+		return a | b;
+	if ( approximate_equal(a.miny, b.miny) && approximate_equal(a.maxy, b.maxy)
+	  && approximate_less_or_equal(a.minx, b.maxx) && approximate_less_or_equal(b.minx, a.maxx) )
+		return a | b;
+
+	return a.area() < b.area() ? b : a;
+}
+
+bool
+TaskBlend::is_b_covers_a() const
+{
+	return (blend_method == Color::BLEND_COMPOSITE || blend_method == Color::BLEND_STRAIGHT)
+	    && approximate_equal_lp(amount, ColorReal(1.0));
+}
+
+Rect
+TaskBlend::calc_opaque_rect() const
+{
+	if (!is_b_covers_a())
+		return Rect::zero();
+	Rect rb = sub_task_b() ? sub_task_b()->calc_opaque_rect() : Rect::zero();
+	if (blend_method != Color::BLEND_COMPOSITE)
+		return rb;
+	Rect ra = sub_task_a() ? sub_task_a()->calc_opaque_rect() : Rect::zero();
+	return merge_opaque_rects(ra, rb);
+}
+
+bool
+TaskBlend::hash_params(TaskHash &hash) const
+{
+	hash.add((int)blend_method);
+	hash.add(amount);
+	return true;
+}
+
 /* === E N T R Y P O I N T ================================================= */
@@ -90,7 +90,16 @@ public:
 	VectorInt get_offset_b() const
 		{ return sub_task_b() ? TaskList::calc_target_offset(*this, *sub_task_b()) : VectorInt(); }
 
+	//! true when opaque pixels of sub_task_b() fully replace pixels of sub_task_a()
+	bool is_b_covers_a() const;
+
+	//! Opaque rect of two opaque areas composited together:
+	//! union when it is a rect, otherwise the largest one of them
+	static Rect merge_opaque_rects(const Rect &a, const Rect &b);
+
 	virtual Rect calc_bounds() const;
+	virtual Rect calc_opaque_rect() const;
+	virtual bool hash_params(TaskHash &hash) const;
 };
 
 
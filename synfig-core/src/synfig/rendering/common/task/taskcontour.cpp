@@ -57,4 +57,70 @@ TaskContour::calc_bounds() const
          :                   contour->calc_bounds(transformation->matrix);
 }
 
+Rect
+TaskContour::calc_opaque_rect() const
+{
+	if ( !contour
+	  || contour->invert
+	  || !approximate_equal_lp(contour->color.get_a(), ColorReal(1.0)) )
+		return Rect::zero();
+
+	Vector points[5];
+	int count = 0;
+	const Contour::ChunkList &chunks = contour->get_chunks();
+	for(Contour::ChunkList::const_iterator i = chunks.begin(); i != chunks.end(); ++i) {
+		if (i->type == Contour::CLOSE)
+			continue;
+		if ( (i->type != Contour::MOVE && i->type != Contour::LINE)
+		  || (i->type == Contour::MOVE && count)
+		  || count >= 5 )
+			return Rect::zero();
+		points[count++] = transformation->matrix.get_transformed(i->p1);
+	}
+	if (count == 5 && points[4].is_equal_to(points[0]))
+		--count;
+	if (count != 4)
+		return Rect::zero();
+
+	// sides should be horizontal and vertical by turns
+	bool horizontal = approximate_equal(points[0][1], points[1][1]);
+	for(int i = 0; i < 4; ++i, horizontal = !horizontal) {
+		const Vector &a = points[i], &b = points[(i + 1)%4];
+		if (!approximate_equal(a[horizontal ? 1 : 0], b[horizontal ? 1 : 0]))
+			return Rect::zero();
+	}
+
+	Rect rect(points[0], points[2]);
+	return rect.is_valid() ? rect : Rect::zero();
+}
+
+bool
+TaskContour::hash_params(TaskHash &hash) const
+{
+	if (!contour) {
+		hash.add(false);
+		return true;
+	}
+
+	hash.add(true);
+	hash.add(contour->invert);
+	hash.add(contour->antialias);
+	hash.add((int)contour->winding_style);
+	hash.add(contour->color);
+
+	const Contour::ChunkList &chunks = contour->get_chunks();
+	hash.add(chunks.size());
+	for(Contour::ChunkList::const_iterator i = chunks.begin(); i != chunks.end(); ++i) {
+		hash.add((int)i->type);
+		hash.add(i->p1);
+		hash.add(i->pp0);
+		hash.add(i->pp1);
+	}
+
+	hash.add(detail);
+	hash.add(allow_antialias);
+	hash.add(transformation->matrix);
+	return true;
+}
+
 /* === E N T R Y P O I N T ================================================= */
@@ -58,6 +58,9 @@ public:
 	TaskContour(): detail(1.0), allow_antialias(true) { }
 
 	virtual Rect calc_bounds() const;
+	//! only axis-aligned rectangles are recognized
+	virtual Rect calc_opaque_rect() const;
+	virtual bool hash_params(TaskHash &hash) const;
 
 	virtual Transformation::Handle get_transformation() const
 		{ return transformation.handle(); }
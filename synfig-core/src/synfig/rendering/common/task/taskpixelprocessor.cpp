@@ -51,6 +51,8 @@ Task::Token TaskPixelGamma::token(
 	DescAbstract<TaskPixelGamma, TaskPixelProcessor>("PixelGamma") );
 SYNFIG_EXPORT Task::Token TaskPixelColorMatrix::token(
 	DescAbstract<TaskPixelColorMatrix, TaskPixelProcessor>("PixelColorMatrix") );
+SYNFIG_EXPORT Task::Token TaskPixelChain::token(
+	DescAbstract<TaskPixelChain, TaskPixelProcessor>("PixelChain") );
 
 
 Rect
@@ -62,6 +64,14 @@ TaskPixelProcessor::calc_bounds() const
 	     : Rect::zero();
 }
 
+Rect
+TaskPixelProcessor::calc_matrix_opaque_rect(const ColorMatrix &matrix, const Rect &sub_opaque_rect) const
+{
+	if (matrix.is_constant(3))
+		return approximate_equal_lp(matrix.get_constant().get_a(), ColorReal(1.0)) ? calc_bounds() : Rect::zero();
+	return matrix.is_copy(3) ? sub_opaque_rect : Rect::zero();
+}
+
 VectorInt
 TaskPixelProcessor::get_offset() const
 {
@@ -70,4 +80,104 @@ TaskPixelProcessor::get_offset() const
 	return VectorInt((int)round(offset[0]), (int)round(offset[1])) - sub_task()->target_rect.get_min();
 }
 
+
+bool
+TaskPixelGamma::hash_params(TaskHash &hash) const
+{
+	hash.add(gamma.get_r());
+	hash.add(gamma.get_g());
+	hash.add(gamma.get_b());
+	return true;
+}
+
+
+bool
+TaskPixelColorMatrix::hash_params(TaskHash &hash) const
+{
+	hash.add(matrix.c, sizeof(matrix.c));
+	return true;
+}
+
+
+void
+TaskPixelChain::add_gamma(const Gamma &gamma)
+{
+	// pow(pow(x, a), b) == pow(x, a*b)
+	if (!steps.empty() && steps.back().is_gamma)
+		steps.back().gamma = steps.back().gamma * gamma;
+	else
+		steps.push_back(Step(gamma));
+}
+
+void
+TaskPixelChain::add_matrix(const ColorMatrix &matrix)
+{
+	// colors are rows, so matrix of first step goes first
+	if (!steps.empty() && !steps.back().is_gamma)
+		steps.back().matrix *= matrix;
+	else
+		steps.push_back(Step(matrix));
+}
+
+bool
+TaskPixelChain::add(const TaskPixelProcessor &task)
+{
+	if (const TaskPixelGamma *gamma = dynamic_cast<const TaskPixelGamma*>(&task))
+		{ add_gamma(gamma->gamma); return true; }
+	if (const TaskPixelColorMatrix *matrix = dynamic_cast<const TaskPixelColorMatrix*>(&task))
+		{ add_matrix(matrix->matrix); return true; }
+	if (const TaskPixelChain *chain = dynamic_cast<const TaskPixelChain*>(&task)) {
+		for(StepList::const_iterator i = chain->steps.begin(); i != chain->steps.end(); ++i)
+			if (i->is_gamma) add_gamma(i->gamma); else add_matrix(i->matrix);
+		return true;
+	}
+	return false;
+}
+
+bool
+TaskPixelChain::hash_params(TaskHash &hash) const
+{
+	for(StepList::const_iterator i = steps.begin(); i != steps.end(); ++i) {
+		hash.add(i->is_gamma);
+		if (i->is_gamma) {
+			hash.add(i->gamma.get_r());
+			hash.add(i->gamma.get_g());
+			hash.add(i->gamma.get_b());
+		} else {
+			hash.add(i->matrix.c, sizeof(i->matrix.c));
+		}
+	}
+	return true;
+}
+
+Rect
+TaskPixelChain::calc_opaque_rect() const
+{
+	// gamma keeps alpha as is
+	Rect rect = sub_task() ? sub_task()->calc_opaque_rect() : Rect::zero();
+	for(StepList::const_iterator i = steps.begin(); i != steps.end(); ++i)
+		if (!i->is_gamma)
+			rect = calc_matrix_opaque_rect(i->matrix, rect);
+	return rect;
+}
+
+bool
+TaskPixelChain::is_constant() const
+{
+	for(StepList::const_iterator i = steps.begin(); i != steps.end(); ++i)
+		if (!i->is_gamma && i->matrix.is_constant())
+			return true;
+	return false;
+}
+
+bool
+TaskPixelChain::is_affects_transparent() const
+{
+	// gamma keeps transparent pixels transparent
+	for(StepList::const_iterator i = steps.begin(); i != steps.end(); ++i)
+		if (!i->is_gamma && i->matrix.is_affects_transparent())
+			return true;
+	return false;
+}
+
 /* === E N T R Y P O I N T ================================================= */
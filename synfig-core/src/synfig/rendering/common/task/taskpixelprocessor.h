@@ -27,7 +27,10 @@
 
 /* === H E A D E R S ======================================================= */
 
+#include <vector>
+
 #include <synfig/color/colormatrix.h>
+#include <synfig/color/gamma.h>
 
 #include "../../task.h"
 #include "tasktransformation.h"
@@ -49,6 +52,10 @@ class TaskPixelProcessor: public Task,
 	public TaskInterfaceConstant,
 	public TaskInterfaceSplit
 {
+protected:
+	//! opaque rect of result of \a matrix applied to sub-task with \a sub_opaque_rect
+	Rect calc_matrix_opaque_rect(const ColorMatrix &matrix, const Rect &sub_opaque_rect) const;
+
 public:
 	typedef etl::handle<TaskPixelProcessor> Handle;
 	SYNFIG_EXPORT static Token token;
@@ -95,6 +102,12 @@ public:
 	Gamma gamma;
 	TaskPixelGamma() { }
 
+	virtual bool hash_params(TaskHash &hash) const;
+
+	//! gamma keeps alpha as is
+	virtual Rect calc_opaque_rect() const
+		{ return sub_task() ? sub_task()->calc_opaque_rect() : Rect::zero(); }
+
 	virtual bool is_transparent() const
 	{
 		return approximate_equal_lp(gamma.get_r(), ColorReal(1.0))
@@ -113,6 +126,11 @@ public:
 
 	ColorMatrix matrix;
 
+	virtual bool hash_params(TaskHash &hash) const;
+
+	virtual Rect calc_opaque_rect() const
+		{ return calc_matrix_opaque_rect(matrix, sub_task() ? sub_task()->calc_opaque_rect() : Rect::zero()); }
+
 	virtual bool is_zero() const
 		{ return matrix.is_transparent(); }
 	virtual bool is_transparent() const
@@ -124,6 +142,47 @@ public:
 };
 
 
+//! Sequence of gamma corrections and color matrices applied in one pass.
+//! Made by OptimizerPixelMerge from nested pixel processors.
+class TaskPixelChain: public TaskPixelProcessor
+{
+public:
+	typedef etl::handle<TaskPixelChain> Handle;
+	SYNFIG_EXPORT static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	struct Step
+	{
+		bool is_gamma;
+		Gamma gamma;
+		ColorMatrix matrix;
+
+		explicit Step(const Gamma &gamma): is_gamma(true), gamma(gamma) { }
+		explicit Step(const ColorMatrix &matrix): is_gamma(false), matrix(matrix) { }
+	};
+	typedef std::vector<Step> StepList;
+
+	//! steps in order of application, neighbour steps always have different types
+	StepList steps;
+
+	//! Appends step, merges it with the last step of the same type
+	void add_gamma(const Gamma &gamma);
+	void add_matrix(const ColorMatrix &matrix);
+	//! Appends processing of TaskPixelGamma, TaskPixelColorMatrix or TaskPixelChain,
+	//! returns false for other tasks
+	bool add(const TaskPixelProcessor &task);
+
+	virtual bool hash_params(TaskHash &hash) const;
+
+	virtual Rect calc_opaque_rect() const;
+
+	virtual bool is_transparent() const
+		{ return steps.empty(); }
+	virtual bool is_constant() const;
+	virtual bool is_affects_transparent() const;
+};
+
+
 } /* end namespace rendering */
 } /* end namespace synfig */
 
@@ -134,4 +134,46 @@ TaskTransformationAffine::get_pass_subtask_index() const
 	return TaskTransformation::get_pass_subtask_index();
 }
 
+Rect
+TaskTransformationAffine::calc_opaque_rect() const
+{
+	const Matrix &matrix = transformation->matrix;
+	if ( !sub_task()
+	  || !sub_task()->is_valid_coords()
+	  || !is_valid_coords()
+	  || !approximate_zero(matrix.m01) || !approximate_zero(matrix.m10)
+	  || !approximate_zero(matrix.m02) || !approximate_zero(matrix.m12) )
+		return Rect::zero();
+
+	Rect rect = sub_task()->calc_opaque_rect();
+	if (!rect.is_valid() || rect.is_nan_or_inf())
+		return Rect::zero();
+
+	// edge pixels are mixed with transparent by interpolation,
+	// skip two source pixels and one target pixel around
+	Vector sub_upp = sub_task()->get_units_per_pixel();
+	rect.minx += 2.0*sub_upp[0]; rect.maxx -= 2.0*sub_upp[0];
+	rect.miny += 2.0*sub_upp[1]; rect.maxy -= 2.0*sub_upp[1];
+	if (!rect.is_valid())
+		return Rect::zero();
+
+	rect = Rect(
+		matrix.get_transformed(rect.get_min()),
+		matrix.get_transformed(rect.get_max()) );
+
+	Vector upp = get_units_per_pixel();
+	rect.minx += upp[0]; rect.maxx -= upp[0];
+	rect.miny += upp[1]; rect.maxy -= upp[1];
+	return rect.is_valid() ? rect : Rect::zero();
+}
+
+bool
+TaskTransformationAffine::hash_params(TaskHash &hash) const
+{
+	hash.add((int)interpolation);
+	hash.add(supersample);
+	hash.add(transformation->matrix);
+	return true;
+}
+
 /* === E N T R Y P O I N T ================================================= */
@@ -100,6 +100,9 @@ public:
 		{ return transformation.handle(); }
 
 	virtual int get_pass_subtask_index() const;
+	//! only transformations without rotation and skew are supported
+	virtual Rect calc_opaque_rect() const;
+	virtual bool hash_params(TaskHash &hash) const;
 };
 
 
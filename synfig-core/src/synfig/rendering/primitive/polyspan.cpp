@@ -36,6 +36,7 @@
 
 #include <algorithm> // std::sort
 #include <cassert>
+#include <vector>
 
 #include <synfig/general.h>
 #include <synfig/localization.h>
@@ -76,6 +77,18 @@ Polyspan::clear()
 	flags = NotSorted;
 }
 
+//init by closed and sorted marks moved by offset
+void
+Polyspan::init(const RectInt &window, const cover_array &covers, const VectorInt &offset)
+{
+	init(window);
+	this->covers.reserve(covers.size());
+	for(cover_array::const_iterator i = covers.begin(); i != covers.end(); ++i)
+		this->covers.push_back(PenMark(i->x + offset[0], i->y + offset[1], i->cover, i->area));
+	open_index = (int)this->covers.size();
+	flags = 0;
+}
+
 //add the current cell, but only if there is information to add
 void
 Polyspan::addcurrent()
@@ -138,10 +151,51 @@ void
 Polyspan::merge_all()
 {
 	finish_line();
-	std::sort(covers.begin(),covers.end());
+	sort_covers(covers.begin(), covers.end());
 	open_index = 0;
 }
 
+//sort marks by (y, x): distribute them into scanline buckets (counting sort by y),
+//then sort each scanline by x, scanlines usually contains just a few marks
+void
+Polyspan::sort_covers(cover_array::iterator begin, cover_array::iterator end)
+{
+	const int min_count = 64;
+	int count = end - begin;
+	if (count < min_count)
+		{ std::sort(begin, end); return; }
+
+	int miny = begin->y, maxy = begin->y;
+	for(cover_array::const_iterator i = begin + 1; i != end; ++i)
+		{ miny = std::min(miny, i->y); maxy = std::max(maxy, i->y); }
+
+	// too sparse for buckets
+	long long rows = (long long)maxy - miny + 1;
+	if (rows > 4ll*count + 1024)
+		{ std::sort(begin, end); return; }
+
+	std::vector<int> offsets(rows + 1, 0);
+	for(cover_array::const_iterator i = begin; i != end; ++i)
+		++offsets[i->y - miny + 1];
+	for(int i = 1; i <= rows; ++i)
+		offsets[i] += offsets[i - 1];
+
+	// after this loop offsets[y - miny] points to the end of scanline y
+	cover_array sorted(count);
+	for(cover_array::const_iterator i = begin; i != end; ++i)
+		sorted[ offsets[i->y - miny]++ ] = *i;
+
+	int row_begin = 0;
+	for(int i = 0; i < rows; ++i) {
+		int row_end = offsets[i];
+		if (row_end - row_begin > 1)
+			std::sort(sorted.begin() + row_begin, sorted.begin() + row_end);
+		row_begin = row_end;
+	}
+
+	std::copy(sorted.begin(), sorted.end(), begin);
+}
+
 //will sort the marks if they are not sorted
 void
 Polyspan::sort_marks()
@@ -153,7 +207,7 @@ Polyspan::sort_marks()
 		addcurrent();
 		current.setcover(0,0);
 
-		std::sort(covers.begin() + open_index,covers.end());
+		sort_covers(covers.begin() + open_index, covers.end());
 		flags &= ~NotSorted;
 	}
 }
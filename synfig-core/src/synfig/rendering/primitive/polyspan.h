@@ -130,6 +130,8 @@ private:
 
 	void finish_line();
 
+	static void sort_covers(cover_array::iterator begin, cover_array::iterator end);
+
 public:
 	Polyspan();
 
@@ -151,6 +153,8 @@ public:
 		window.maxx = maxx;
 		window.maxy = maxy;
 	}
+	//init by closed and sorted marks moved by \a offset
+	void init(const RectInt &window, const cover_array &covers, const VectorInt &offset);
 
 	//close the primitives with a line (or rendering will not work as expected)
 	void close();
@@ -0,0 +1,580 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/rendercache.cpp
+**	\brief RenderCache
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2015-2018 Ivan Mahonin
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <ETL/stringf>
+
+#include <synfig/general.h>
+#include <synfig/localization.h>
+#include <synfig/filesystemnative.h>
+
+#include "rendercache.h"
+
+#include "common/task/taskblend.h"
+#include "software/surfacesw.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+#define CACHE_FILE_EXTENSION ".cache"
+#define CACHE_FILE_VERSION   1
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+	struct CacheFileHeader
+	{
+		char magic[8];
+		int version;
+		int color_size;
+		int width;
+		int height;
+		int rect[4];
+	};
+
+	const char cache_file_magic[8] = { 'S', 'Y', 'N', 'F', 'I', 'G', 'R', 'C' };
+
+	void init_header(CacheFileHeader &header, const VectorInt &size, const RectInt &rect)
+	{
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, cache_file_magic, sizeof(header.magic));
+		header.version = CACHE_FILE_VERSION;
+		header.color_size = (int)sizeof(Color);
+		header.width = size[0];
+		header.height = size[1];
+		header.rect[0] = rect.minx;
+		header.rect[1] = rect.miny;
+		header.rect[2] = rect.maxx;
+		header.rect[3] = rect.maxy;
+	}
+
+	bool check_header(const CacheFileHeader &header)
+	{
+		return memcmp(header.magic, cache_file_magic, sizeof(header.magic)) == 0
+			&& header.version == CACHE_FILE_VERSION
+			&& header.color_size == (int)sizeof(Color)
+			&& header.width > 0
+			&& header.height > 0
+			&& header.rect[0] >= 0 && header.rect[0] < header.rect[2] && header.rect[2] <= header.width
+			&& header.rect[1] >= 0 && header.rect[1] < header.rect[3] && header.rect[3] <= header.height;
+	}
+
+	RectInt header_rect(const CacheFileHeader &header)
+		{ return RectInt(header.rect[0], header.rect[1], header.rect[2], header.rect[3]); }
+
+	long long calc_file_size(const RectInt &rect)
+		{ return (long long)sizeof(CacheFileHeader) + (long long)rect.get_width()*rect.get_height()*sizeof(Color); }
+}
+
+Task::Token TaskCacheStore::token(
+	DescSpecial<TaskCacheStore>("CacheStore") );
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+bool
+TaskCacheStore::run(RunParams & /* params */) const
+{
+	// result of rendering should not depend on cache,
+	// so this task is always successful
+	if (cache && is_valid())
+		cache->store(key, target_surface, target_rect);
+	return true;
+}
+
+
+RenderCache::RenderCache(const String &path, long long max_size, int min_tasks):
+	path(path),
+	max_size(max_size),
+	max_file_size(max_size/4),
+	min_tasks(std::max(1, min_tasks)),
+	max_stores(8),
+	total_size(),
+	last_access(),
+	hits(),
+	misses(),
+	stores(),
+	evictions()
+{
+	scan();
+}
+
+RenderCache::~RenderCache()
+	{ log_statistics(); }
+
+String
+RenderCache::get_filename(Key key) const
+	{ return path + ETL_DIRECTORY_SEPARATOR + etl::strprintf("%016llx", key) + CACHE_FILE_EXTENSION; }
+
+void
+RenderCache::scan()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	entries.clear();
+	access_order.clear();
+	total_size = 0;
+	last_access = 0;
+
+	FileSystem::Handle file_system = FileSystemNative::instance();
+	if (!file_system->directory_create_recursive(path)) {
+		synfig::warning("RenderCache: cannot create directory: %s", path.c_str());
+		return;
+	}
+
+	FileSystem::FileList files;
+	file_system->directory_scan(path, files);
+
+	// restore order of access from modification time of files
+	std::vector< std::pair<long long, Key> > found;
+	for(FileSystem::FileList::const_iterator i = files.begin(); i != files.end(); ++i) {
+		const String extension = CACHE_FILE_EXTENSION;
+		if ( i->size() != 16 + extension.size()
+		  || i->substr(16) != extension )
+			continue;
+
+		char *end = NULL;
+		Key key = strtoull(i->substr(0, 16).c_str(), &end, 16);
+		if (!end || *end)
+			continue;
+
+		GStatBuf buf;
+		if (g_stat(get_filename(key).c_str(), &buf) != 0)
+			continue;
+
+		Entry &entry = entries[key];
+		entry.size = buf.st_size;
+		total_size += entry.size;
+		found.push_back(std::make_pair((long long)buf.st_mtime, key));
+	}
+
+	std::sort(found.begin(), found.end());
+	for(std::vector< std::pair<long long, Key> >::const_iterator i = found.begin(); i != found.end(); ++i) {
+		entries[i->second].last_access = ++last_access;
+		access_order[last_access] = i->second;
+	}
+
+	info("RenderCache: %d files (%lld bytes) in %s", (int)entries.size(), total_size, path.c_str());
+}
+
+void
+RenderCache::touch(Key key)
+{
+	// mutex must be already locked
+	EntryMap::iterator i = entries.find(key);
+	if (i == entries.end()) return;
+	access_order.erase(i->second.last_access);
+	i->second.last_access = ++last_access;
+	access_order[last_access] = key;
+}
+
+void
+RenderCache::insert(Key key, long long size)
+{
+	// mutex must be already locked
+	erase(key);
+	Entry &entry = entries[key];
+	entry.size = size;
+	entry.last_access = ++last_access;
+	access_order[last_access] = key;
+	total_size += size;
+
+	// remove least recently used files
+	while(total_size > max_size && access_order.size() > 1) {
+		Key k = access_order.begin()->second;
+		FileSystemNative::instance()->file_remove(get_filename(k));
+		erase(k);
+		++evictions;
+	}
+}
+
+void
+RenderCache::erase(Key key)
+{
+	// mutex must be already locked
+	EntryMap::iterator i = entries.find(key);
+	if (i == entries.end()) return;
+	access_order.erase(i->second.last_access);
+	total_size -= i->second.size;
+	entries.erase(i);
+}
+
+bool
+RenderCache::contains(Key key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.count(key) != 0;
+}
+
+bool
+RenderCache::is_cacheable(const HashInfo &info, const RectInt &rect) const
+{
+	// small subtrees are cheaper to render than to load,
+	// and one big file should not flush whole cache
+	return info.valid
+		&& info.tasks_count >= min_tasks
+		&& rect.is_valid()
+		&& calc_file_size(rect) <= max_file_size;
+}
+
+const RenderCache::HashInfo&
+RenderCache::calc_hash(const Task::Handle &task, const String &renderer_name, HashMap &hashes) const
+{
+	HashMap::iterator hi = hashes.find(task.get());
+	if (hi != hashes.end())
+		return hi->second;
+
+	HashInfo info;
+	TaskHash hash;
+	hash.add(renderer_name);
+	hash.add(task->get_token()->name);
+	hash.add(task->source_rect);
+	hash.add(task->target_rect);
+	hash.add(task->target_surface ? task->target_surface->get_size() : VectorInt::zero());
+	info.valid = task->is_valid() && task->hash_params(hash);
+	info.tasks_count = 1;
+
+	hash.add(task->sub_tasks.size());
+	for(Task::List::const_iterator i = task->sub_tasks.begin(); i != task->sub_tasks.end(); ++i) {
+		if (!*i) { hash.add(false); continue; }
+		const HashInfo &sub_info = calc_hash(*i, renderer_name, hashes);
+		hash.add(true);
+		hash.add(sub_info.key);
+		info.valid = info.valid && sub_info.valid;
+		info.tasks_count += sub_info.tasks_count;
+	}
+
+	info.key = hash.get();
+	return hashes[task.get()] = info;
+}
+
+Task::Handle
+RenderCache::replace(
+	const Task::Handle &task,
+	const HashMap &hashes,
+	CandidateList &candidates )
+{
+	Task::Handle new_task = task;
+	for(Task::List::const_iterator i = task->sub_tasks.begin(); i != task->sub_tasks.end(); ++i) {
+		if (!*i) continue;
+		Task::Handle sub_task = *i;
+
+		HashMap::const_iterator hi = hashes.find(sub_task.get());
+		assert(hi != hashes.end());
+		const HashInfo &info = hi->second;
+		bool cacheable = is_cacheable(info, sub_task->target_rect);
+
+		RectInt rect;
+		SurfaceResource::Handle surface;
+		if (cacheable && contains(info.key))
+			surface = load(info.key, rect);
+
+		if (surface) {
+			++hits;
+			TaskSurface::Handle task_surface(new TaskSurface());
+			task_surface->source_rect = sub_task->source_rect;
+			task_surface->target_rect = rect;
+			task_surface->target_surface = surface;
+			sub_task = task_surface;
+		} else {
+			if (cacheable) ++misses;
+			sub_task = replace(sub_task, hashes, candidates);
+
+			// background of blending is the most probable candidate
+			// to stay unchanged during several frames
+			if ( cacheable
+			  && i == task->sub_tasks.begin()
+			  && task.type_is<TaskBlend>() )
+				candidates.push_back(Candidate(sub_task, info.key, info.tasks_count));
+		}
+
+		if (sub_task != *i) {
+			if (new_task == task) new_task = task->clone();
+			new_task->sub_tasks[i - task->sub_tasks.begin()] = sub_task;
+		}
+	}
+	return new_task;
+}
+
+Task::Handle
+RenderCache::detach(
+	const Task::Handle &task,
+	const ReplaceMap &detached,
+	Task::List &out_list ) const
+{
+	Task::Handle new_task = task;
+	for(Task::List::const_iterator i = task->sub_tasks.begin(); i != task->sub_tasks.end(); ++i) {
+		if (!*i) continue;
+
+		Task::Handle sub_task = detach(*i, detached, out_list);
+		ReplaceMap::const_iterator ri = detached.find(i->get());
+		if (ri != detached.end()) {
+			if (std::find(out_list.begin(), out_list.end(), sub_task) == out_list.end())
+				out_list.push_back(sub_task);
+			sub_task = ri->second;
+		}
+
+		if (sub_task != *i) {
+			if (new_task == task) new_task = task->clone();
+			new_task->sub_tasks[i - task->sub_tasks.begin()] = sub_task;
+		}
+	}
+	return new_task;
+}
+
+bool
+RenderCache::load(Key key, const SurfaceResource::Handle &surface, const RectInt &rect)
+{
+	if (!surface || !contains(key))
+		return false;
+
+	FILE *f = g_fopen(get_filename(key).c_str(), "rb");
+	if (!f) return false;
+
+	bool success = false;
+	CacheFileHeader header;
+	if ( fread(&header, sizeof(header), 1, f) == 1
+	  && check_header(header)
+	  && header_rect(header) == rect
+	  && VectorInt(header.width, header.height) == surface->get_size() )
+	{
+		SurfaceResource::LockWrite<SurfaceSW> lock(surface, rect);
+		if (lock) {
+			synfig::Surface &s = lock->get_surface();
+			success = true;
+			for(int y = rect.miny; y < rect.maxy && success; ++y)
+				success = fread(&s[y][rect.minx], sizeof(Color), rect.get_width(), f) == (size_t)rect.get_width();
+		}
+	}
+	fclose(f);
+
+	if (success) {
+		std::lock_guard<std::mutex> lock(mutex);
+		touch(key);
+	}
+	return success;
+}
+
+SurfaceResource::Handle
+RenderCache::load(Key key, RectInt &out_rect)
+{
+	FILE *f = g_fopen(get_filename(key).c_str(), "rb");
+	if (!f) return SurfaceResource::Handle();
+
+	SurfaceResource::Handle surface;
+	CacheFileHeader header;
+	if ( fread(&header, sizeof(header), 1, f) == 1
+	  && check_header(header) )
+	{
+		RectInt rect = header_rect(header);
+		SurfaceResource::Handle resource(new SurfaceResource());
+		resource->create(header.width, header.height);
+
+		SurfaceResource::LockWrite<SurfaceSW> lock(resource);
+		if (lock) {
+			synfig::Surface &s = lock->get_surface();
+			bool success = true;
+			for(int y = rect.miny; y < rect.maxy && success; ++y)
+				success = fread(&s[y][rect.minx], sizeof(Color), rect.get_width(), f) == (size_t)rect.get_width();
+			if (success) {
+				surface = resource;
+				out_rect = rect;
+			}
+		}
+	}
+	fclose(f);
+
+	if (surface) {
+		std::lock_guard<std::mutex> lock(mutex);
+		touch(key);
+	}
+	return surface;
+}
+
+bool
+RenderCache::store(Key key, const SurfaceResource::Handle &surface, const RectInt &rect)
+{
+	if (!surface || !rect.is_valid() || calc_file_size(rect) > max_file_size)
+		return false;
+	if (contains(key))
+		return true;
+
+	static std::atomic<int> last_temp_index(0);
+	String filename = get_filename(key);
+	String temp_filename = filename + etl::strprintf(".%d.%lld.tmp", ++last_temp_index, (long long)g_get_monotonic_time());
+
+	FILE *f = g_fopen(temp_filename.c_str(), "wb");
+	if (!f) {
+		synfig::warning("RenderCache: cannot create file: %s", temp_filename.c_str());
+		return false;
+	}
+
+	bool success = false;
+	{
+		SurfaceResource::LockRead<SurfaceSW> lock(surface, rect);
+		if (lock) {
+			const synfig::Surface &s = lock->get_surface();
+			CacheFileHeader header;
+			init_header(header, surface->get_size(), rect);
+			success = fwrite(&header, sizeof(header), 1, f) == 1;
+			for(int y = rect.miny; y < rect.maxy && success; ++y)
+				success = fwrite(&s[y][rect.minx], sizeof(Color), rect.get_width(), f) == (size_t)rect.get_width();
+		}
+	}
+	if (fclose(f) != 0)
+		success = false;
+
+	// file appears in cache directory only when it completely written
+	FileSystem::Handle file_system = FileSystemNative::instance();
+	if (success && !file_system->file_rename(temp_filename, filename))
+		success = false;
+	if (!success) {
+		file_system->file_remove(temp_filename);
+		return false;
+	}
+
+	++stores;
+	std::lock_guard<std::mutex> lock(mutex);
+	insert(key, calc_file_size(rect));
+	return true;
+}
+
+void
+RenderCache::process(Task::List &list, const String &renderer_name, Task::List &out_store_list)
+{
+	// coordinates and sizes of surfaces are part of hash
+	for(Task::List::const_iterator i = list.begin(); i != list.end(); ++i)
+		if (*i) (*i)->touch_coords();
+
+	HashMap hashes;
+	for(Task::List::const_iterator i = list.begin(); i != list.end(); ++i)
+		if (*i) calc_hash(*i, renderer_name, hashes);
+
+	Task::List new_list;
+	for(Task::List::const_iterator i = list.begin(); i != list.end(); ++i) {
+		if (!*i) { new_list.push_back(*i); continue; }
+
+		const HashInfo &info = hashes[i->get()];
+		bool cacheable = is_cacheable(info, (*i)->target_rect);
+		if (cacheable) {
+			if (load(info.key, (*i)->target_surface, (*i)->target_rect))
+				{ ++hits; continue; }
+			++misses;
+		}
+
+		CandidateList candidates;
+		Task::Handle task = replace(*i, hashes, candidates);
+
+		// select subtrees to store, each next subtree
+		// should be at least twice bigger than previous
+		std::sort(candidates.begin(), candidates.end());
+		ReplaceMap detached;
+		int last_count = 0;
+		for(CandidateList::const_iterator j = candidates.begin(); j != candidates.end() && (int)detached.size() < max_stores; ++j) {
+			if (j->tasks_count < 2*last_count || detached.count(j->task.get()))
+				continue;
+			last_count = j->tasks_count;
+
+			TaskSurface::Handle task_surface(new TaskSurface());
+			task_surface->assign_target(*j->task);
+			detached[j->task.get()] = task_surface;
+
+			TaskCacheStore::Handle store(new TaskCacheStore());
+			store->cache = this;
+			store->key = j->key;
+			store->assign_target(*j->task);
+			out_store_list.push_back(store);
+		}
+
+		if (!detached.empty())
+			task = detach(task, detached, new_list);
+		new_list.push_back(task);
+
+		if (cacheable) {
+			TaskCacheStore::Handle store(new TaskCacheStore());
+			store->cache = this;
+			store->key = info.key;
+			store->assign_target(*task);
+			out_store_list.push_back(store);
+		}
+	}
+
+	list.swap(new_list);
+}
+
+void
+RenderCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	FileSystem::Handle file_system = FileSystemNative::instance();
+	for(EntryMap::const_iterator i = entries.begin(); i != entries.end(); ++i)
+		file_system->file_remove(get_filename(i->first));
+	entries.clear();
+	access_order.clear();
+	total_size = 0;
+}
+
+RenderCache::Stats
+RenderCache::get_stats() const
+{
+	Stats stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.stores = stores;
+	stats.evictions = evictions;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.size = total_size;
+	stats.files = (long long)entries.size();
+	return stats;
+}
+
+void
+RenderCache::log_statistics() const
+{
+	Stats stats = get_stats();
+	info( "RenderCache: %lld hits, %lld misses, %lld stores, %lld evictions",
+		  stats.hits, stats.misses, stats.stores, stats.evictions );
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,194 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/rendercache.h
+**	\brief RenderCache Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2015-2018 Ivan Mahonin
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_RENDERCACHE_H
+#define __SYNFIG_RENDERING_RENDERCACHE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <map>
+#include <vector>
+
+#include <atomic>
+#include <mutex>
+
+#include "task.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Persistent storage of rendered surfaces.
+//! Each file in cache directory contains result of some task subtree
+//! and named by hash of this subtree, see Task::hash_params().
+//! Total size of directory is bounded, least recently used files are removed first.
+class RenderCache
+{
+public:
+	typedef TaskHash::Value Key;
+
+	struct Stats
+	{
+		long long hits;        //!< subtrees taken from cache
+		long long misses;      //!< cacheable subtrees which was not found in cache
+		long long stores;      //!< files written to cache
+		long long evictions;   //!< files removed to fit size limit
+		long long size;        //!< total size of cache files now
+		long long files;       //!< count of cache files now
+		Stats(): hits(), misses(), stores(), evictions(), size(), files() { }
+	};
+
+private:
+	struct Entry
+	{
+		long long size;
+		long long last_access;
+		Entry(): size(), last_access() { }
+	};
+
+	struct HashInfo
+	{
+		bool valid;
+		Key key;
+		int tasks_count;
+		HashInfo(): valid(), key(), tasks_count() { }
+	};
+
+	struct Candidate
+	{
+		Task::Handle task;
+		Key key;
+		int tasks_count;
+		Candidate(): key(), tasks_count() { }
+		Candidate(const Task::Handle &task, Key key, int tasks_count):
+			task(task), key(key), tasks_count(tasks_count) { }
+		bool operator<(const Candidate &other) const
+			{ return tasks_count < other.tasks_count; }
+	};
+
+	typedef std::vector<Candidate> CandidateList;
+	typedef std::map<Key, Entry> EntryMap;
+	typedef std::map<long long, Key> AccessMap;
+	typedef std::map<const Task*, HashInfo> HashMap;
+	typedef std::map<const Task*, Task::Handle> ReplaceMap;
+
+	mutable std::mutex mutex;
+
+	const String path;
+	const long long max_size;
+	const long long max_file_size;
+	const int min_tasks;
+	const int max_stores;
+
+	long long total_size;
+	long long last_access;
+	EntryMap entries;
+	AccessMap access_order;
+
+	std::atomic<long long> hits;
+	std::atomic<long long> misses;
+	std::atomic<long long> stores;
+	std::atomic<long long> evictions;
+
+	String get_filename(Key key) const;
+	void scan();
+	void touch(Key key);
+	void insert(Key key, long long size);
+	void erase(Key key);
+	bool contains(Key key);
+
+	bool is_cacheable(const HashInfo &info, const RectInt &rect) const;
+
+	const HashInfo& calc_hash(const Task::Handle &task, const String &renderer_name, HashMap &hashes) const;
+	Task::Handle replace(
+		const Task::Handle &task,
+		const HashMap &hashes,
+		CandidateList &candidates );
+	Task::Handle detach(
+		const Task::Handle &task,
+		const ReplaceMap &detached,
+		Task::List &out_list ) const;
+
+	bool load(Key key, const SurfaceResource::Handle &surface, const RectInt &rect);
+	SurfaceResource::Handle load(Key key, RectInt &out_rect);
+
+public:
+	//! Creates cache in directory \a path,
+	//! \a max_size is a limit of total size of cache files in bytes,
+	//! only subtrees with \a min_tasks tasks or greater will be cached,
+	//! single file may take not more than quarter of \a max_size
+	RenderCache(const String &path, long long max_size, int min_tasks);
+	~RenderCache();
+
+	const String& get_path() const
+		{ return path; }
+
+	//! Takes already rendered subtrees from cache.
+	//! Roots found in cache are rendered immediately and removed from the \a list.
+	//! Other subtrees found in cache are replaced by TaskSurface.
+	//! Subtrees which should be stored are placed to \a list as separate roots
+	//! and tasks which will store them are added to \a out_store_list,
+	//! these tasks should run when all tasks from \a list are done.
+	void process(Task::List &list, const String &renderer_name, Task::List &out_store_list);
+
+	//! Stores the rendered surface, called from TaskCacheStore
+	bool store(Key key, const SurfaceResource::Handle &surface, const RectInt &rect);
+
+	//! Removes all cache files
+	void clear();
+
+	Stats get_stats() const;
+	void log_statistics() const;
+};
+
+
+//! Saves target surface into RenderCache when all tasks which draws at this surface are done
+class TaskCacheStore: public Task
+{
+public:
+	typedef etl::handle<TaskCacheStore> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	RenderCache *cache;
+	RenderCache::Key key;
+
+	TaskCacheStore(): cache(), key() { }
+
+	virtual bool run(RunParams &params) const;
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -43,8 +43,10 @@
 #include <synfig/debug/debugsurface.h>
 #include <synfig/debug/log.h>
 #include <synfig/debug/measure.h>
+#include <synfig/debug/trace.h>
 
 #include "renderer.h"
+#include "rendercache.h"
 #include "renderqueue.h"
 
 #include "software/renderersw.h"
@@ -52,6 +54,8 @@
 #include "software/rendererpreviewsw.h"
 #include "software/rendererlowressw.h"
 #include "software/renderersafe.h"
+#include "software/surfaceswpool.h"
+#include "software/function/polyspancache.h"
 #ifdef WITH_OPENGL
 #include "opengl/renderergl.h"
 #include "opengl/task/taskgl.h"
@@ -85,9 +89,11 @@ using namespace rendering;
 Renderer::Handle Renderer::blank;
 std::map<String, Renderer::Handle> *Renderer::renderers;
 RenderQueue *Renderer::queue;
+RenderCache *Renderer::cache;
 Renderer::DebugOptions Renderer::debug_options;
 long long Renderer::last_registered_optimizer_index = 0;
 long long Renderer::last_batch_index = 0;
+int Renderer::tile_size = Renderer::default_tile_size;
 
 
 void
@@ -490,6 +496,7 @@ Renderer::optimize(Task::List &list) const
 	#ifdef DEBUG_TASK_MEASURE
 	debug::Measure t("Renderer::optimize");
 	#endif
+	debug::Trace::Scope trace("renderer", "optimize");
 
 	#ifdef DEBUG_OPTIMIZATION_COUNTERS
 	debug::Log::info("", "optimize %d tasks", count_tasks(list));
@@ -816,6 +823,52 @@ Renderer::run(const Task::List &list, bool quiet) const
 	return task_event->is_done();
 }
 
+bool
+Renderer::split_to_tiles(const Task::List &list, std::vector<RectInt> &tiles) const
+{
+	if (tile_size <= 0 || list.empty())
+		return false;
+
+	RectInt bounds = RectInt::zero();
+	for(Task::List::const_iterator i = list.begin(); i != list.end(); ++i) {
+		// tasks without coordinates cannot be truncated to tile
+		if (!*i || !(*i)->is_valid_coords() || !(*i)->target_surface)
+			return false;
+		bounds |= (*i)->target_rect;
+	}
+
+	if ((long long)bounds.get_width()*bounds.get_height() <= (long long)tile_size*tile_size)
+		return false;
+
+	for(int y = bounds.miny; y < bounds.maxy; y += tile_size)
+		for(int x = bounds.minx; x < bounds.maxx; x += tile_size)
+			tiles.push_back( RectInt(
+				x, y,
+				std::min(x + tile_size, bounds.maxx),
+				std::min(y + tile_size, bounds.maxy) ));
+	return true;
+}
+
+Task::List
+Renderer::prepare(const Task::List &list, bool quiet) const
+{
+	Task::List optimized_list(list);
+	Task::List cache_store_list;
+	if (cache && !quiet)
+		cache->process(optimized_list, get_name(), cache_store_list);
+
+	optimize(optimized_list);
+
+	// cache should be filled when all tasks are done,
+	// so add store tasks after optimization
+	optimized_list.insert(optimized_list.end(), cache_store_list.begin(), cache_store_list.end());
+	{
+		debug::Trace::Scope trace("renderer", "find_deps");
+		find_deps(optimized_list, ++last_batch_index);
+	}
+	return optimized_list;
+}
+
 void
 Renderer::enqueue(const Task::List &list, const TaskEvent::Handle &finish_event_task, bool quiet) const
 {
@@ -837,9 +890,47 @@ Renderer::enqueue(const Task::List &list, const TaskEvent::Handle &finish_event_
 	if (!quiet && !get_debug_options().task_list_log.empty())
 		log(get_debug_options().task_list_log, list, "input list");
 
-	Task::List optimized_list(list);
-	optimize(optimized_list);
-	find_deps(optimized_list, ++last_batch_index);
+	Task::List optimized_list;
+	std::vector<RectInt> tiles;
+	if (!quiet && split_to_tiles(list, tiles)) {
+		// Every tile is optimized separately, so coordinates of sub-tasks
+		// are calculated for the tile only (with extra pixels required
+		// by each task, see Task::set_coords_sub_tasks()).
+		// Tiles are chained by events, surfaces are allocated when tasks runs,
+		// so intermediate surfaces of the next tile will not be allocated
+		// until the previous tile is done.
+		TaskEvent::Handle prev_tile_event;
+		for(std::vector<RectInt>::const_iterator i = tiles.begin(); i != tiles.end(); ++i) {
+			Task::List tile_list;
+			for(Task::List::const_iterator j = list.begin(); j != list.end(); ++j) {
+				Task::Handle task = (*j)->clone_recursive();
+				task->trunc_target_rect(*i);
+				tile_list.push_back(task);
+			}
+			tile_list = prepare(tile_list, quiet);
+
+			if (prev_tile_event)
+				for(Task::List::const_iterator j = tile_list.begin(); j != tile_list.end(); ++j) {
+					(*j)->renderer_data.deps.insert(prev_tile_event);
+					prev_tile_event->renderer_data.back_deps.insert(*j);
+				}
+			optimized_list.insert(optimized_list.end(), tile_list.begin(), tile_list.end());
+
+			TaskEvent::Handle tile_event = new TaskEvent();
+			tile_event->renderer_data.deps.insert(tile_list.begin(), tile_list.end());
+			for(Task::List::const_iterator j = tile_list.begin(); j != tile_list.end(); ++j)
+				(*j)->renderer_data.back_deps.insert(tile_event);
+			if (prev_tile_event) {
+				// keep the chain of events, so finish event will wait for all of them
+				tile_event->renderer_data.deps.insert(prev_tile_event);
+				prev_tile_event->renderer_data.back_deps.insert(tile_event);
+			}
+			optimized_list.push_back(tile_event);
+			prev_tile_event = tile_event;
+		}
+	} else {
+		optimized_list = prepare(list, quiet);
+	}
 
 	#ifdef DEBUG_TASK_LIST
 	if (!quiet) log("", optimized_list, "optimized list");
@@ -988,10 +1079,28 @@ Renderer::initialize()
 		debug_options.task_list_optimized_log = s;
 	if (const char *s = getenv("SYNFIG_RENDERING_DEBUG_RESULT_IMAGE"))
 		debug_options.result_image = s;
+	if (const char *s = getenv("SYNFIG_RENDERING_DEBUG_SURFACE_POOL_STATS"))
+		debug_options.surface_pool_stats = atoi(s) != 0;
+
+	// tiled rendering of large frames
+	if (const char *s = getenv("SYNFIG_RENDERING_TILE_SIZE"))
+		tile_size = std::max(0, atoi(s));
 
 	renderers = new std::map<String, Handle>();
 	queue = new RenderQueue();
 
+	// init persistent cache of rendered surfaces
+	const char *cache_dir = getenv("SYNFIG_RENDERING_CACHE_DIR");
+	if (cache_dir && *cache_dir) {
+		long long size = 1024; // megabytes
+		if (const char *s = getenv("SYNFIG_RENDERING_CACHE_SIZE"))
+			size = std::max(1ll, atoll(s));
+		int min_tasks = 4;
+		if (const char *s = getenv("SYNFIG_RENDERING_CACHE_MIN_TASKS"))
+			min_tasks = std::max(1, atoi(s));
+		cache = new RenderCache(cache_dir, size*1024*1024, min_tasks);
+	}
+
 	initialize_renderers();
 }
 
@@ -1008,6 +1117,16 @@ Renderer::deinitialize()
 
 	delete renderers;
 	delete queue;
+	delete cache;
+	cache = NULL;
+
+	if (debug_options.surface_pool_stats) {
+		SurfaceSWPool::Stats stats = SurfaceSWPool::get_stats();
+		synfig::info( "rendering::SurfaceSWPool: hits %lld, misses %lld, peak %lld MB",
+			stats.hits, stats.misses, stats.peak_bytes/(1024*1024) );
+	}
+	SurfaceSWPool::clear();
+	software::PolyspanCache::clear();
 }
 
 void
@@ -46,6 +46,7 @@ namespace rendering
 {
 
 class RenderQueue;
+class RenderCache;
 
 class Renderer: public etl::shared_object
 {
@@ -57,15 +58,19 @@ public:
 		String task_list_log;
 		String task_list_optimized_log;
 		String result_image;
+		bool surface_pool_stats;
+		DebugOptions(): surface_pool_stats() { }
 	};
 
 private:
 	static Handle blank;
 	static std::map<String, Handle> *renderers;
 	static RenderQueue *queue;
+	static RenderCache *cache;
 	static DebugOptions debug_options;
 	static long long last_registered_optimizer_index;
 	static long long last_batch_index; // TODO: atomic
+	static int tile_size;
 
 	ModeList modes;
 	Optimizer::List optimizers[Optimizer::CATEGORIES_COUNT];
@@ -138,7 +143,21 @@ private:
 
 	void find_deps(const Task::List &list, long long batch_index) const;
 
+	bool split_to_tiles(const Task::List &list, std::vector<RectInt> &tiles) const;
+	Task::List prepare(const Task::List &list, bool quiet) const;
+
 public:
+	//! Large frames are rendered by square tiles of this size one by one,
+	//! so intermediate surfaces are allocated for the current tile only.
+	//! Frames which are not larger than one tile are rendered at once.
+	//! Set by environment variable SYNFIG_RENDERING_TILE_SIZE, 0 disables tiling
+	static const int default_tile_size = 2048;
+
+	static int get_tile_size()
+		{ return tile_size; }
+	static void set_tile_size(int x)
+		{ tile_size = x > 0 ? x : 0; }
+
 	int get_max_simultaneous_threads() const;
 	void optimize(Task::List &list) const;
 
@@ -34,11 +34,16 @@
 
 #include <typeinfo>
 
+#include <glib.h>
+
+#include <ETL/stringf>
+
 #include <synfig/general.h>
 #include <synfig/localization.h>
 #include <synfig/debug/debugsurface.h>
 #include <synfig/debug/log.h>
 #include <synfig/debug/measure.h>
+#include <synfig/debug/trace.h>
 
 #include "renderqueue.h"
 #include "renderer.h"
@@ -85,7 +90,13 @@ Task::Token TaskSubQueue::token(
 } // end of anonimous namespace
 
 
-RenderQueue::RenderQueue(): started(false) { start(); }
+RenderQueue::RenderQueue():
+	started(false),
+	ready_count(0),
+	next_worker(0),
+	print_statistics(false)
+{ start(); }
+
 RenderQueue::~RenderQueue() { stop(); }
 
 void
@@ -105,16 +116,22 @@ RenderQueue::start()
 
 	if (const char *s = getenv("SYNFIG_RENDERING_THREADS"))
 		count = atoi(s) + 1;
+	if (const char *s = getenv("SYNFIG_RENDERING_QUEUE_STATISTICS"))
+		print_statistics = atoi(s) != 0;
 
 	if (count > SYNFIG_RENDERING_MAX_THREADS) count = SYNFIG_RENDERING_MAX_THREADS;
 	if (count < 2) count = 2;
 
+	// all workers should be created before threads starts
+	for(unsigned int i = 0; i < count; ++i)
+		workers.emplace_back();
+
+	started = true;
 	for(unsigned int i = 0; i < count; ++i)
 		threads.push_back(
 			std::thread(
 				sigc::bind(sigc::mem_fun(*this, &RenderQueue::process), i) ));
 	info("rendering threads %d", count);
-	started = true;
 }
 
 void
@@ -123,16 +140,24 @@ RenderQueue::stop()
 	{
 		std::lock_guard<std::mutex> lock(mutex);
 		started = false;
-		cond.notify_all();
 		single_cond.notify_all();
 	}
+	{
+		std::lock_guard<std::mutex> lock(wait_mutex);
+		cond.notify_all();
+	}
 	while(!threads.empty())
 		{ threads.front().join(); threads.pop_front(); }
+
+	if (print_statistics)
+		log_statistics();
 }
 
 void
 RenderQueue::process(int thread_index)
 {
+	Worker &worker = workers[thread_index];
+	debug::Trace::set_thread_name(etl::strprintf("rendering thread %d", thread_index));
 	while(Task::Handle task = get(thread_index))
 	{
 		#ifdef DEBUG_THREAD_TASK
@@ -151,9 +176,15 @@ RenderQueue::process(int thread_index)
 		}
 
 		bool success = false;
+		long long begin_time = g_get_monotonic_time();
 		try {
 			success = task->run(task->renderer_data.params);
 		} catch(...) { }
+		long long end_time = g_get_monotonic_time();
+		worker.busy_time_us += end_time - begin_time;
+		++worker.tasks_count;
+		if (debug::Trace::is_enabled())
+			debug::Trace::add("task", task->get_token()->name.c_str(), begin_time, end_time, task->target_rect);
 		if (!success)
 			task->renderer_data.success = false;
 
@@ -191,6 +222,81 @@ RenderQueue::process(int thread_index)
 	}
 }
 
+void
+RenderQueue::push_ready(int thread_index, const Task::Handle &task)
+{
+	// mutex must be already locked
+
+	// tasks from outside of workers are distributed round-robin,
+	// tasks which became ready in worker stays in the same worker
+	// to reuse the data in the cache of current core
+	int count = (int)workers.size() - 1;
+	if (thread_index <= 0 || thread_index > count)
+		thread_index = 1 + (int)((unsigned int)next_worker++ % (unsigned int)count);
+
+	Worker &worker = workers[thread_index];
+	int depth;
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.push_back(task);
+		depth = (int)worker.tasks.size();
+	}
+	if (depth > worker.max_queue_depth)
+		worker.max_queue_depth = depth;
+	++ready_count;
+}
+
+Task::Handle
+RenderQueue::pop_ready(int thread_index)
+{
+	Worker &worker = workers[thread_index];
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.tasks.empty())
+		return Task::Handle();
+	Task::Handle task = worker.tasks.back();
+	worker.tasks.pop_back();
+	--ready_count;
+	return task;
+}
+
+Task::Handle
+RenderQueue::steal_ready(int thread_index)
+{
+	Worker &worker = workers[thread_index];
+	int count = (int)workers.size() - 1;
+	for(int i = 1; i < count; ++i)
+	{
+		Worker &victim = workers[1 + (thread_index - 1 + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			Task::Handle task = victim.tasks.front();
+			victim.tasks.pop_front();
+			--ready_count;
+			++worker.steals;
+			return task;
+		}
+	}
+	++worker.steal_failures;
+	return Task::Handle();
+}
+
+void
+RenderQueue::wakeup(int signals, int single_signals)
+{
+	// limit signals count
+	int threads = get_threads_count() - 1;
+	if (signals > threads) signals = threads;
+	if (single_signals > 1) single_signals = 1;
+
+	if (signals > 0)
+	{
+		std::lock_guard<std::mutex> lock(wait_mutex);
+		while(signals-- > 0) cond.notify_one();
+	}
+	while(single_signals-- > 0) single_cond.notify_one();
+}
+
 void
 RenderQueue::done(int thread_index, const Task::Handle &task)
 {
@@ -204,61 +310,78 @@ RenderQueue::done(int thread_index, const Task::Handle &task)
 		(*i)->renderer_data.deps.erase(task);
 		if ((*i)->renderer_data.deps.empty())
 		{
-			bool mt = (*i)->get_allow_multithreading();
-			TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-			TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
-			wait.erase(*i);
-			queue.push_back(*i);
-			++(mt ? signals : single_signals);
+			if ((*i)->get_allow_multithreading()) {
+				not_ready_tasks.erase(*i);
+				push_ready(thread_index, *i);
+				++signals;
+			} else {
+				single_not_ready_tasks.erase(*i);
+				single_ready_tasks.push_back(*i);
+				++single_signals;
+			}
 		}
 	}
 	task->renderer_data.back_deps.clear();
-	assert( tasks_in_process.count(thread_index) == 1 );
-	tasks_in_process.erase(thread_index);
-	//info("rendering threads used %d", tasks_in_process.size());
-
-	// limit signals count
-	int threads = get_threads_count() - 1;
-	if (signals > threads) signals = threads;
-	if (single_signals > 1) single_signals = 1;
 
 	// we don't need to wakeup the current thread
 	--(thread_index ? signals : single_signals);
 
-	// wake up
-	while(signals-- > 0) cond.notify_one();
-	while(single_signals-- > 0) single_cond.notify_one();
+	wakeup(signals, single_signals);
 }
 
 Task::Handle
-RenderQueue::get(int thread_index)
+RenderQueue::get_single()
 {
 	std::unique_lock<std::mutex> lock(mutex);
-
-	TaskQueue &queue  = thread_index == 0 ? single_ready_tasks     : ready_tasks;
-	TaskQueue &queue2 = thread_index != 0 ? single_ready_tasks     : ready_tasks;
-	TaskSet   &wait   = thread_index == 0 ? single_not_ready_tasks : not_ready_tasks;
 	while(started)
 	{
-		if (!queue.empty())
+		if (!single_ready_tasks.empty())
 		{
-			Task::Handle task = queue.front();
-			queue.pop_front();
-			if (!task) continue;
-			assert( tasks_in_process.count(thread_index) == 0 );
-			tasks_in_process[thread_index] = task;
-			//info("rendering threads used %d", tasks_in_process.size());
-			return task;
+			Task::Handle task = single_ready_tasks.front();
+			single_ready_tasks.pop_front();
+			if (task) return task;
+			continue;
 		}
 
 		#ifdef DEBUG_THREAD_WAIT
-		if (!wait.empty())
-			info("thread %d: rendering wait for task", thread_index);
+		if (!single_not_ready_tasks.empty())
+			info("thread 0: rendering wait for task");
 		#endif
 
-		assert( wait.empty() || !tasks_in_process.empty() || !queue2.empty() );
+		long long begin_time = g_get_monotonic_time();
+		single_cond.wait(lock);
+		workers[0].idle_time_us += g_get_monotonic_time() - begin_time;
+	}
+	return Task::Handle();
+}
+
+Task::Handle
+RenderQueue::get(int thread_index)
+{
+	if (thread_index == 0)
+		return get_single();
+
+	Worker &worker = workers[thread_index];
 
-		(thread_index ? cond : single_cond).wait(lock);
+	while(started)
+	{
+		Task::Handle task = pop_ready(thread_index);
+		if (!task) task = steal_ready(thread_index);
+		if (task) return task;
+
+		#ifdef DEBUG_THREAD_WAIT
+		info("thread %d: rendering wait for task", thread_index);
+		#endif
+
+		// tasks are pushed before the increment of ready_count,
+		// and ready_count checked under wait_mutex, so wakeup will not lost
+		long long begin_time = g_get_monotonic_time();
+		{
+			std::unique_lock<std::mutex> lock(wait_mutex);
+			if (started && ready_count <= 0)
+				cond.wait(lock);
+		}
+		worker.idle_time_us += g_get_monotonic_time() - begin_time;
 	}
 	return Task::Handle();
 }
@@ -322,8 +445,12 @@ RenderQueue::remove_orphans()
 {
 	// mutex must be already locked
 
-	for(TaskQueue::iterator i = ready_tasks.begin(); i != ready_tasks.end();)
-		if (remove_if_orphan(*i, true)) ready_tasks.erase(i++); else ++i;
+	for(WorkerList::iterator w = workers.begin(); w != workers.end(); ++w)
+	{
+		std::lock_guard<std::mutex> lock(w->mutex);
+		for(TaskDeque::iterator i = w->tasks.begin(); i != w->tasks.end();)
+			if (remove_if_orphan(*i, true)) { i = w->tasks.erase(i); --ready_count; } else ++i;
+	}
 	for(TaskQueue::iterator i = single_ready_tasks.begin(); i != single_ready_tasks.end();)
 		if (remove_if_orphan(*i, true)) single_ready_tasks.erase(i++); else ++i;
 
@@ -342,15 +469,18 @@ RenderQueue::enqueue(const Task::Handle &task, const Task::RunParams &params)
 	std::lock_guard<std::mutex> lock(mutex);
 
 	bool mt = task->get_allow_multithreading();
-	TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-	TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
 	if (task->renderer_data.deps.empty()) {
-		queue.push_back(task);
-		(mt ? cond : single_cond).notify_one();
+		if (mt) {
+			push_ready(-1, task);
+			wakeup(1, 0);
+		} else {
+			single_ready_tasks.push_back(task);
+			wakeup(0, 1);
+		}
 	}
 	else
 	{
-		wait.insert(task);
+		(mt ? not_ready_tasks : single_not_ready_tasks).insert(task);
 	}
 
 	remove_orphans();
@@ -374,25 +504,21 @@ RenderQueue::enqueue(const Task::List &tasks, const Task::RunParams &params)
 		if (*i)
 		{
 			bool mt = (*i)->get_allow_multithreading();
-			TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-			TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
 			if ((*i)->renderer_data.deps.empty()) {
-				queue.push_back(*i);
-				++(mt ? signals : single_signals);
+				if (mt) {
+					push_ready(-1, *i);
+					++signals;
+				} else {
+					single_ready_tasks.push_back(*i);
+					++single_signals;
+				}
 			} else {
-				wait.insert(*i);
+				(mt ? not_ready_tasks : single_not_ready_tasks).insert(*i);
 			}
 		}
 	}
 
-	// limit signals count
-	int threads = get_threads_count() - 1;
-	if (signals > threads) signals = threads;
-	if (single_signals > 1) single_signals = 1;
-
-	// wake up
-	while(signals-- > 0) cond.notify_one();
-	while(single_signals-- > 0) single_cond.notify_one();
+	wakeup(signals, single_signals);
 
 	remove_orphans();
 }
@@ -400,21 +526,35 @@ RenderQueue::enqueue(const Task::List &tasks, const Task::RunParams &params)
 bool
 RenderQueue::remove_task(const Task::Handle &task)
 {
+	// mutex must be already locked
+
 	bool found = false;
 	if (task) {
-		bool mt = task->get_allow_multithreading();
-		TaskQueue &queue = mt ? ready_tasks     : single_ready_tasks;
-		TaskSet   &wait  = mt ? not_ready_tasks : single_not_ready_tasks;
-
-		for(TaskQueue::iterator i = queue.begin(); i != queue.end(); ) {
-			if (*i == task) {
-				found = true;
-				i = queue.erase(i);
-			} else {
-				++i;
+		if (task->get_allow_multithreading()) {
+			for(WorkerList::iterator w = workers.begin(); w != workers.end(); ++w) {
+				std::lock_guard<std::mutex> lock(w->mutex);
+				for(TaskDeque::iterator i = w->tasks.begin(); i != w->tasks.end(); ) {
+					if (*i == task) {
+						found = true;
+						i = w->tasks.erase(i);
+						--ready_count;
+					} else {
+						++i;
+					}
+				}
 			}
+			if (not_ready_tasks.erase(task)) found = true;
+		} else {
+			for(TaskQueue::iterator i = single_ready_tasks.begin(); i != single_ready_tasks.end(); ) {
+				if (*i == task) {
+					found = true;
+					i = single_ready_tasks.erase(i);
+				} else {
+					++i;
+				}
+			}
+			if (single_not_ready_tasks.erase(task)) found = true;
 		}
-		if (wait.erase(task)) found = true;
 	}
 	return found;
 }
@@ -461,10 +601,68 @@ void
 RenderQueue::clear()
 {
 	std::lock_guard<std::mutex> lock(mutex);
-	ready_tasks.clear();
+	for(WorkerList::iterator w = workers.begin(); w != workers.end(); ++w) {
+		std::lock_guard<std::mutex> lock(w->mutex);
+		ready_count -= (int)w->tasks.size();
+		w->tasks.clear();
+	}
 	single_ready_tasks.clear();
 	not_ready_tasks.clear();
 	single_not_ready_tasks.clear();
 }
 
+RenderQueue::StatisticsList
+RenderQueue::get_statistics() const
+{
+	StatisticsList list;
+	for(WorkerList::const_iterator w = workers.begin(); w != workers.end(); ++w) {
+		Statistics s;
+		s.thread_index    = (int)(w - workers.begin());
+		s.tasks           = w->tasks_count;
+		s.steals          = w->steals;
+		s.steal_failures  = w->steal_failures;
+		s.max_queue_depth = w->max_queue_depth;
+		s.busy_time       = (Real)w->busy_time_us*0.000001;
+		s.idle_time       = (Real)w->idle_time_us*0.000001;
+		{
+			std::lock_guard<std::mutex> lock(w->mutex);
+			s.queue_depth = (int)w->tasks.size();
+		}
+		list.push_back(s);
+	}
+	return list;
+}
+
+void
+RenderQueue::reset_statistics()
+{
+	for(WorkerList::iterator w = workers.begin(); w != workers.end(); ++w) {
+		w->tasks_count     = 0;
+		w->steals          = 0;
+		w->steal_failures  = 0;
+		w->max_queue_depth = 0;
+		w->busy_time_us    = 0;
+		w->idle_time_us    = 0;
+	}
+}
+
+void
+RenderQueue::log_statistics() const
+{
+	StatisticsList list = get_statistics();
+	Statistics total;
+	for(StatisticsList::const_iterator i = list.begin(); i != list.end(); ++i) {
+		info( "rendering thread %3d: tasks %8lld, steals %8lld, steal failures %8lld, queue depth %5d (max %5d), busy %10.3fs, idle %10.3fs",
+			  i->thread_index, i->tasks, i->steals, i->steal_failures,
+			  i->queue_depth, i->max_queue_depth, i->busy_time, i->idle_time );
+		total.tasks += i->tasks;
+		total.steals += i->steals;
+		total.steal_failures += i->steal_failures;
+		total.busy_time += i->busy_time;
+		total.idle_time += i->idle_time;
+	}
+	info( "rendering threads total: tasks %lld, steals %lld, steal failures %lld, busy %.3fs, idle %.3fs",
+		  total.tasks, total.steals, total.steal_failures, total.busy_time, total.idle_time );
+}
+
 /* === E N T R Y P O I N T ================================================= */
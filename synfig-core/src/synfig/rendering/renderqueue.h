@@ -27,8 +27,11 @@
 
 /* === H E A D E R S ======================================================= */
 
-#include <map>
+#include <deque>
+#include <list>
+#include <vector>
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
@@ -50,27 +53,69 @@ class RenderQueue
 {
 public:
 	typedef std::list<std::thread> ThreadList;
-	typedef std::map<int, Task::Handle> ThreadTaskMap;
 	typedef std::set<Task::Handle> TaskSet;
 	typedef std::list<Task::Handle> TaskQueue;
+	typedef std::deque<Task::Handle> TaskDeque;
+
+	//! Scheduler counters of one rendering thread
+	struct Statistics
+	{
+		int thread_index;
+		long long tasks;          //!< count of processed tasks
+		long long steals;         //!< count of tasks taken from queues of other threads
+		long long steal_failures; //!< count of unsuccessful searches in queues of other threads
+		int queue_depth;          //!< current count of tasks in own queue
+		int max_queue_depth;      //!< peak count of tasks in own queue
+		Real busy_time;           //!< seconds spent in Task::run
+		Real idle_time;           //!< seconds spent in waiting for new tasks
+
+		Statistics():
+			thread_index(), tasks(), steals(), steal_failures(),
+			queue_depth(), max_queue_depth(), busy_time(), idle_time() { }
+	};
+	typedef std::vector<Statistics> StatisticsList;
 
 private:
+	//! Each rendering thread owns a deque of ready tasks.
+	//! Owner pushes and pops tasks at the back of deque,
+	//! other threads steals tasks from the front when own deque is empty.
+	//! Thread 0 has no deque, it works with single_ready_tasks.
+	struct Worker
+	{
+		mutable std::mutex mutex;
+		TaskDeque tasks;
+
+		std::atomic<long long> tasks_count;
+		std::atomic<long long> steals;
+		std::atomic<long long> steal_failures;
+		std::atomic<int> max_queue_depth;
+		std::atomic<long long> busy_time_us;
+		std::atomic<long long> idle_time_us;
+
+		Worker():
+			tasks_count(), steals(), steal_failures(),
+			max_queue_depth(), busy_time_us(), idle_time_us() { }
+	};
+	typedef std::deque<Worker> WorkerList;
+
 	static int last_batch_index;
 
-	std::mutex mutex;
-	std::mutex threads_mutex;
+	std::mutex mutex;        //!< guards dependencies of tasks and single-thread queue
+	std::mutex wait_mutex;   //!< guards sleeping of multithreading workers
 	std::condition_variable cond;
 	std::condition_variable single_cond;
 
-	TaskQueue ready_tasks;
 	TaskQueue single_ready_tasks;
 	TaskSet not_ready_tasks;
 	TaskSet single_not_ready_tasks;
 
-	bool started;
+	std::atomic<bool> started;
+	std::atomic<int> ready_count;   //!< count of tasks in all worker deques
+	std::atomic<int> next_worker;   //!< round-robin counter to distribute tasks from outside
+	bool print_statistics;
 
 	ThreadList threads;
-	ThreadTaskMap tasks_in_process;
+	WorkerList workers;
 
 	void start();
 	void stop();
@@ -78,6 +123,12 @@ private:
 	void process(int thread_index);
 	void done(int thread_index, const Task::Handle &task);
 	Task::Handle get(int thread_index);
+	Task::Handle get_single();
+
+	void push_ready(int thread_index, const Task::Handle &task);
+	Task::Handle pop_ready(int thread_index);
+	Task::Handle steal_ready(int thread_index);
+	void wakeup(int signals, int single_signals);
 
 	static void fix_task(const Task &task, const Task::RunParams &params);
 	bool remove_if_orphan(const Task::Handle &task, bool in_queue);
@@ -94,6 +145,10 @@ public:
 	void cancel(const Task::Handle &task);
 	void cancel(const Task::List &list);
 	void clear();
+
+	StatisticsList get_statistics() const;
+	void reset_statistics();
+	void log_statistics() const;
 };
 
 } /* end namespace rendering */
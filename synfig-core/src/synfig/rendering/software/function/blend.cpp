@@ -0,0 +1,481 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/blend.cpp
+**	\brief Blend
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2015-2019 Ivan Mahonin
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <synfig/general.h>
+#include <synfig/localization.h>
+
+#include "blend.h"
+
+#endif
+
+/* === M A C R O S ========================================================= */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define BLEND_SSE2
+	#include <emmintrin.h>
+	#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+		#define BLEND_AVX2
+		#include <immintrin.h>
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+// same as in synfig/color/colorblendingfunctions.h
+#define BLEND_EPSILON (0.000001f)
+
+using namespace synfig;
+using namespace rendering;
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+
+#ifdef BLEND_SSE2
+
+// Every Color is four floats (r, g, b, a), so one pixel fills one SSE register
+// and two pixels fill one AVX register. Kernels repeat the operations
+// of synfig/color/colorblendingfunctions.h in the same order,
+// so results are equal to Color::blend()
+
+inline __m128 load(const Color *c)
+	{ return _mm_loadu_ps(reinterpret_cast<const float*>(c)); }
+inline void store(Color *c, __m128 x)
+	{ _mm_storeu_ps(reinterpret_cast<float*>(c), x); }
+inline __m128 add(__m128 a, __m128 b)
+	{ return _mm_add_ps(a, b); }
+inline __m128 sub(__m128 a, __m128 b)
+	{ return _mm_sub_ps(a, b); }
+inline __m128 mul(__m128 a, __m128 b)
+	{ return _mm_mul_ps(a, b); }
+inline __m128 div(__m128 a, __m128 b)
+	{ return _mm_div_ps(a, b); }
+inline __m128 alpha(__m128 x)
+	{ return _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3)); }
+inline __m128 set_alpha(__m128 x, __m128 a) {
+	const __m128 mask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+	return _mm_or_ps(_mm_andnot_ps(mask, x), _mm_and_ps(mask, a));
+}
+inline __m128 nonzero(__m128 x) {
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	return _mm_cmpgt_ps(_mm_and_ps(x, abs_mask), _mm_set1_ps(BLEND_EPSILON));
+}
+inline __m128 select(__m128 mask, __m128 a, __m128 b)
+	{ return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+inline __m128 is_zero(__m128 x)
+	{ return _mm_cmpeq_ps(x, _mm_setzero_ps()); }
+inline __m128 zero(__m128)
+	{ return _mm_setzero_ps(); }
+
+#ifdef BLEND_AVX2
+TARGET_AVX2 inline __m256 load2(const Color *c)
+	{ return _mm256_loadu_ps(reinterpret_cast<const float*>(c)); }
+TARGET_AVX2 inline void store2(Color *c, __m256 x)
+	{ _mm256_storeu_ps(reinterpret_cast<float*>(c), x); }
+TARGET_AVX2 inline __m256 add(__m256 a, __m256 b)
+	{ return _mm256_add_ps(a, b); }
+TARGET_AVX2 inline __m256 sub(__m256 a, __m256 b)
+	{ return _mm256_sub_ps(a, b); }
+TARGET_AVX2 inline __m256 mul(__m256 a, __m256 b)
+	{ return _mm256_mul_ps(a, b); }
+TARGET_AVX2 inline __m256 div(__m256 a, __m256 b)
+	{ return _mm256_div_ps(a, b); }
+TARGET_AVX2 inline __m256 alpha(__m256 x)
+	{ return _mm256_permute_ps(x, _MM_SHUFFLE(3, 3, 3, 3)); }
+TARGET_AVX2 inline __m256 set_alpha(__m256 x, __m256 a)
+	{ return _mm256_blend_ps(x, a, 0x88); }
+TARGET_AVX2 inline __m256 nonzero(__m256 x) {
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	return _mm256_cmp_ps(_mm256_and_ps(x, abs_mask), _mm256_set1_ps(BLEND_EPSILON), _CMP_GT_OQ);
+}
+TARGET_AVX2 inline __m256 select(__m256 mask, __m256 a, __m256 b)
+	{ return _mm256_blendv_ps(b, a, mask); }
+TARGET_AVX2 inline __m256 is_zero(__m256 x)
+	{ return _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_EQ_OQ); }
+TARGET_AVX2 inline __m256 zero(__m256)
+	{ return _mm256_setzero_ps(); }
+#endif
+
+// Each kernel has two versions with the same body:
+// for one pixel (SSE2) and for two pixels (AVX2).
+// s - source pixel, d - destination pixel
+
+struct KernelComposite {
+	// see blendfunc_COMPOSITE
+	static inline __m128 blend(__m128 s, __m128 d, __m128 amount, __m128 one) {
+		__m128 a_src = mul(alpha(s), amount);
+		__m128 a_dest = alpha(d);
+		__m128 r = add(mul(s, a_src), mul(mul(d, a_dest), sub(one, a_src)));
+		a_dest = add(a_src, mul(a_dest, sub(one, a_src)));
+		r = set_alpha(mul(r, div(one, a_dest)), a_dest);
+		return select(nonzero(a_dest), r, zero(r));
+	}
+	#ifdef BLEND_AVX2
+	TARGET_AVX2 static inline __m256 blend(__m256 s, __m256 d, __m256 amount, __m256 one) {
+		__m256 a_src = mul(alpha(s), amount);
+		__m256 a_dest = alpha(d);
+		__m256 r = add(mul(s, a_src), mul(mul(d, a_dest), sub(one, a_src)));
+		a_dest = add(a_src, mul(a_dest, sub(one, a_src)));
+		r = set_alpha(mul(r, div(one, a_dest)), a_dest);
+		return select(nonzero(a_dest), r, zero(r));
+	}
+	#endif
+};
+
+struct KernelStraight {
+	// see blendfunc_STRAIGHT
+	static inline __m128 straight(__m128 s, __m128 d, __m128 amount, __m128 one) {
+		__m128 a_src = alpha(s);
+		__m128 a_dest = alpha(d);
+		__m128 a_out = add(mul(sub(a_src, a_dest), amount), a_dest);
+		__m128 r = add(mul(sub(mul(s, a_src), mul(d, a_dest)), amount), mul(d, a_dest));
+		r = set_alpha(mul(r, div(one, a_out)), a_out);
+		return select(nonzero(a_out), r, zero(r));
+	}
+	#ifdef BLEND_AVX2
+	TARGET_AVX2 static inline __m256 straight(__m256 s, __m256 d, __m256 amount, __m256 one) {
+		__m256 a_src = alpha(s);
+		__m256 a_dest = alpha(d);
+		__m256 a_out = add(mul(sub(a_src, a_dest), amount), a_dest);
+		__m256 r = add(mul(sub(mul(s, a_src), mul(d, a_dest)), amount), mul(d, a_dest));
+		r = set_alpha(mul(r, div(one, a_out)), a_out);
+		return select(nonzero(a_out), r, zero(r));
+	}
+	#endif
+
+	static inline __m128 blend(__m128 s, __m128 d, __m128 amount, __m128 one)
+		{ return straight(s, d, amount, one); }
+	#ifdef BLEND_AVX2
+	TARGET_AVX2 static inline __m256 blend(__m256 s, __m256 d, __m256 amount, __m256 one)
+		{ return straight(s, d, amount, one); }
+	#endif
+};
+
+struct KernelOnto {
+	// see blendfunc_ONTO, destination alpha is one
+	static inline __m128 onto(__m128 s, __m128 d, __m128 amount, __m128 one) {
+		__m128 a_src = mul(alpha(s), amount);
+		__m128 r = add(mul(s, a_src), mul(set_alpha(d, one), sub(one, a_src)));
+		__m128 a_out = add(a_src, sub(one, a_src));
+		r = set_alpha(mul(r, div(one, a_out)), a_out);
+		return set_alpha(select(nonzero(a_out), r, zero(r)), d);
+	}
+	#ifdef BLEND_AVX2
+	TARGET_AVX2 static inline __m256 onto(__m256 s, __m256 d, __m256 amount, __m256 one) {
+		__m256 a_src = mul(alpha(s), amount);
+		__m256 r = add(mul(s, a_src), mul(set_alpha(d, one), sub(one, a_src)));
+		__m256 a_out = add(a_src, sub(one, a_src));
+		r = set_alpha(mul(r, div(one, a_out)), a_out);
+		return set_alpha(select(nonzero(a_out), r, zero(r)), d);
+	}
+	#endif
+
+	static inline __m128 blend(__m128 s, __m128 d, __m128 amount, __m128 one)
+		{ return onto(s, d, amount, one); }
+	#ifdef BLEND_AVX2
+	TARGET_AVX2 static inline __m256 blend(__m256 s, __m256 d, __m256 amount, __m256 one)
+		{ return onto(s, d, amount, one); }
+	#endif
+};
+
+struct KernelBehind {
+	// see blendfunc_BEHIND: composite destination over the source
+	static inline __m128 blend(__m128 s, __m128 d, __m128 amount, __m128 one) {
+		const __m128 epsilon = _mm_set1_ps(BLEND_EPSILON);
+		__m128 a = alpha(s);
+		a = select(is_zero(a), mul(epsilon, amount), mul(a, amount));
+		s = set_alpha(s, a);
+		__m128 a_src = alpha(d);
+		__m128 r = add(mul(d, a_src), mul(mul(s, a), sub(one, a_src)));
+		__m128 a_out = add(a_src, mul(a, sub(one, a_src)));
+		r = set_alpha(mul(r, div(one, a_out)), a_out);
+		return select(nonzero(a_out), r, zero(r));
+	}
+	#ifdef BLEND_AVX2
+	TARGET_AVX2 static inline __m256 blend(__m256 s, __m256 d, __m256 amount, __m256 one) {
+		const __m256 epsilon = _mm256_set1_ps(BLEND_EPSILON);
+		__m256 a = alpha(s);
+		a = select(is_zero(a), mul(epsilon, amount), mul(a, amount));
+		s = set_alpha(s, a);
+		__m256 a_src = alpha(d);
+		__m256 r = add(mul(d, a_src), mul(mul(s, a), sub(one, a_src)));
+		__m256 a_out = add(a_src, mul(a, sub(one, a_src)));
+		r = set_alpha(mul(r, div(one, a_out)), a_out);
+		return select(nonzero(a_out), r, zero(r));
+	}
+	#endif
+};
+
+struct KernelAdd {
+	// see blendfunc_ADD
+	static inline __m128 blend(__m128 s, __m128 d, __m128 amount, __m128 /*one*/)
+		{ return set_alpha(add(mul(d, alpha(d)), mul(s, mul(alpha(s), amount))), d); }
+	#ifdef BLEND_AVX2
+	TARGET_AVX2 static inline __m256 blend(__m256 s, __m256 d, __m256 amount, __m256 /*one*/)
+		{ return set_alpha(add(mul(d, alpha(d)), mul(s, mul(alpha(s), amount))), d); }
+	#endif
+};
+
+struct KernelMultiply {
+	// see blendfunc_MULTIPLY, amount should be positive
+	static inline __m128 blend(__m128 s, __m128 d, __m128 amount, __m128 /*one*/)
+		{ return set_alpha(add(mul(sub(mul(d, s), d), mul(amount, alpha(s))), d), d); }
+	#ifdef BLEND_AVX2
+	TARGET_AVX2 static inline __m256 blend(__m256 s, __m256 d, __m256 amount, __m256 /*one*/)
+		{ return set_alpha(add(mul(sub(mul(d, s), d), mul(amount, alpha(s))), d), d); }
+	#endif
+};
+
+struct KernelScreen {
+	// see blendfunc_SCREEN, amount should be positive
+	static inline __m128 blend(__m128 s, __m128 d, __m128 amount, __m128 one) {
+		s = set_alpha(sub(one, mul(sub(one, s), sub(one, d))), s);
+		return KernelOnto::onto(s, d, amount, one);
+	}
+	#ifdef BLEND_AVX2
+	TARGET_AVX2 static inline __m256 blend(__m256 s, __m256 d, __m256 amount, __m256 one) {
+		s = set_alpha(sub(one, mul(sub(one, s), sub(one, d))), s);
+		return KernelOnto::onto(s, d, amount, one);
+	}
+	#endif
+};
+
+struct KernelAlphaOver {
+	// see blendfunc_ALPHA_OVER
+	static inline __m128 blend(__m128 s, __m128 d, __m128 amount, __m128 one) {
+		s = set_alpha(d, mul(sub(one, alpha(s)), alpha(d)));
+		return KernelStraight::straight(s, d, amount, one);
+	}
+	#ifdef BLEND_AVX2
+	TARGET_AVX2 static inline __m256 blend(__m256 s, __m256 d, __m256 amount, __m256 one) {
+		s = set_alpha(d, mul(sub(one, alpha(s)), alpha(d)));
+		return KernelStraight::straight(s, d, amount, one);
+	}
+	#endif
+};
+
+template<typename K>
+void blend_row_sse2(Color *dest, const Color *src, int count, ColorReal amount)
+{
+	const __m128 a = _mm_set1_ps(amount);
+	const __m128 one = _mm_set1_ps(1.f);
+	for(Color *end = dest + count; dest < end; ++dest, ++src)
+		store(dest, K::blend(load(src), load(dest), a, one));
+}
+
+#ifdef BLEND_AVX2
+template<typename K>
+TARGET_AVX2 void blend_row_avx2(Color *dest, const Color *src, int count, ColorReal amount)
+{
+	const __m256 a = _mm256_set1_ps(amount);
+	const __m256 one = _mm256_set1_ps(1.f);
+	for(Color *end = dest + (count & ~1); dest < end; dest += 2, src += 2)
+		store2(dest, K::blend(load2(src), load2(dest), a, one));
+	if (count & 1)
+		store(dest, K::blend(load(src), load(dest), _mm_set1_ps(amount), _mm_set1_ps(1.f)));
+}
+#endif
+
+template<typename K>
+void blend_row_simd(
+	Color *dest, const Color *src, int count, ColorReal amount,
+	software::Blend::Instructions instructions )
+{
+	#ifdef BLEND_AVX2
+	if (instructions >= software::Blend::AVX2)
+		{ blend_row_avx2<K>(dest, src, count, amount); return; }
+	#endif
+	blend_row_sse2<K>(dest, src, count, amount);
+}
+
+#endif // BLEND_SSE2
+
+software::Blend::Instructions
+select_instructions()
+{
+	software::Blend::Instructions instructions = software::Blend::get_supported_instructions();
+	if (const char *s = getenv("SYNFIG_RENDERING_BLEND_INSTRUCTIONS"))
+		instructions = std::min(instructions, (software::Blend::Instructions)std::max(0, atoi(s)));
+	return instructions;
+}
+
+} // end of anonimous namespace
+
+/* === M E T H O D S ======================================================= */
+
+software::Blend::Instructions
+software::Blend::get_supported_instructions()
+{
+	#ifdef BLEND_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return AVX2;
+	#endif
+	#ifdef BLEND_SSE2
+	return SSE2;
+	#else
+	return SCALAR;
+	#endif
+}
+
+software::Blend::Instructions
+software::Blend::get_instructions()
+{
+	static const Instructions instructions = select_instructions();
+	return instructions;
+}
+
+bool
+software::Blend::is_vectorized(Color::BlendMethod method)
+{
+	#ifdef BLEND_SSE2
+	switch(method)
+	{
+		case Color::BLEND_COMPOSITE:
+		case Color::BLEND_STRAIGHT:
+		case Color::BLEND_ONTO:
+		case Color::BLEND_BEHIND:
+		case Color::BLEND_ADD:
+		case Color::BLEND_MULTIPLY:
+		case Color::BLEND_SCREEN:
+		case Color::BLEND_ALPHA_OVER:
+			return true;
+		default:
+			break;
+	}
+	#endif
+	return false;
+}
+
+void
+software::Blend::blend_row_scalar(
+	Color *dest,
+	const Color *src,
+	int count,
+	ColorReal amount,
+	Color::BlendMethod method )
+{
+	for(Color *end = dest + count; dest < end; ++dest, ++src)
+		*dest = Color::blend(*src, *dest, amount, method);
+}
+
+void
+software::Blend::blend_row(
+	Color *dest,
+	const Color *src,
+	int count,
+	ColorReal amount,
+	Color::BlendMethod method,
+	Instructions instructions )
+{
+	if (count <= 0 || std::fabs(amount) <= BLEND_EPSILON)
+		return;
+
+	#ifdef BLEND_SSE2
+	if (instructions >= SSE2)
+	{
+		switch(method)
+		{
+			case Color::BLEND_COMPOSITE:
+				blend_row_simd<KernelComposite>(dest, src, count, amount, instructions); return;
+			case Color::BLEND_STRAIGHT:
+				blend_row_simd<KernelStraight>(dest, src, count, amount, instructions); return;
+			case Color::BLEND_ONTO:
+				blend_row_simd<KernelOnto>(dest, src, count, amount, instructions); return;
+			case Color::BLEND_BEHIND:
+				blend_row_simd<KernelBehind>(dest, src, count, amount, instructions); return;
+			case Color::BLEND_ADD:
+				blend_row_simd<KernelAdd>(dest, src, count, amount, instructions); return;
+			case Color::BLEND_MULTIPLY:
+				// negative amount inverts the source color, leave it for scalar version
+				if (amount > 0)
+					{ blend_row_simd<KernelMultiply>(dest, src, count, amount, instructions); return; }
+				break;
+			case Color::BLEND_SCREEN:
+				if (amount > 0)
+					{ blend_row_simd<KernelScreen>(dest, src, count, amount, instructions); return; }
+				break;
+			case Color::BLEND_ALPHA_OVER:
+				blend_row_simd<KernelAlphaOver>(dest, src, count, amount, instructions); return;
+			default:
+				break;
+		}
+	}
+	#endif
+
+	blend_row_scalar(dest, src, count, amount, method);
+}
+
+void
+software::Blend::blend(
+	synfig::Surface &dest,
+	const VectorInt &dest_pos,
+	const synfig::Surface &src,
+	const RectInt &src_rect,
+	ColorReal amount,
+	Color::BlendMethod method )
+{
+	if (!src_rect.is_valid())
+		return;
+
+	assert( 0 <= dest_pos[0] && dest_pos[0] + src_rect.get_width() <= dest.get_w()
+		 && 0 <= dest_pos[1] && dest_pos[1] + src_rect.get_height() <= dest.get_h() );
+	assert( 0 <= src_rect.minx && src_rect.maxx <= src.get_w()
+		 && 0 <= src_rect.miny && src_rect.maxy <= src.get_h() );
+
+	int w = src_rect.get_width();
+
+	// straight blending with full amount is just a copy, see Surface::blit_to()
+	if (method == Color::BLEND_STRAIGHT && std::fabs(amount - 1.f) < 0.00001f)
+	{
+		for(int y = src_rect.miny; y < src_rect.maxy; ++y)
+			memcpy(
+				&dest[dest_pos[1] + y - src_rect.miny][dest_pos[0]],
+				&src[y][src_rect.minx],
+				w*sizeof(Color) );
+		return;
+	}
+
+	Instructions instructions = get_instructions();
+	for(int y = src_rect.miny; y < src_rect.maxy; ++y)
+		blend_row(
+			&dest[dest_pos[1] + y - src_rect.miny][dest_pos[0]],
+			&src[y][src_rect.minx],
+			w, amount, method, instructions );
+}
+
+/* === E N T R Y P O I N T ================================================= */
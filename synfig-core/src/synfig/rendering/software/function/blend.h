@@ -0,0 +1,114 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/blend.h
+**	\brief Blend Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2015-2019 Ivan Mahonin
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SOFTWARE_BLEND_H
+#define __SYNFIG_RENDERING_SOFTWARE_BLEND_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <synfig/color.h>
+#include <synfig/rect.h>
+#include <synfig/surface.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+namespace software
+{
+
+//! Blending of pixel rows.
+//! Common blend methods have vectorized implementations,
+//! instruction set is selected at runtime.
+//! Vectorized versions gives the same results as Color::blend
+class Blend
+{
+public:
+	enum Instructions
+	{
+		SCALAR,
+		SSE2,
+		AVX2
+	};
+
+	//! Returns the best instruction set supported by CPU and by compiler
+	static Instructions get_supported_instructions();
+
+	//! Returns instruction set used by blend_row(),
+	//! it may be limited by environment variable SYNFIG_RENDERING_BLEND_INSTRUCTIONS
+	//! (0 - scalar, 1 - SSE2, 2 - AVX2)
+	static Instructions get_instructions();
+
+	//! Is blend method has vectorized implementation
+	static bool is_vectorized(Color::BlendMethod method);
+
+	//! Blends \a count pixels from \a src onto \a dest by Color::blend
+	static void blend_row_scalar(
+		Color *dest,
+		const Color *src,
+		int count,
+		ColorReal amount,
+		Color::BlendMethod method );
+
+	//! Blends \a count pixels from \a src onto \a dest using selected instruction set,
+	//! falls back to blend_row_scalar() if method is not vectorized
+	static void blend_row(
+		Color *dest,
+		const Color *src,
+		int count,
+		ColorReal amount,
+		Color::BlendMethod method,
+		Instructions instructions );
+
+	static void blend_row(
+		Color *dest,
+		const Color *src,
+		int count,
+		ColorReal amount,
+		Color::BlendMethod method )
+	{ blend_row(dest, src, count, amount, method, get_instructions()); }
+
+	//! Blends area \a src_rect of \a src onto \a dest at position \a dest_pos
+	static void blend(
+		synfig::Surface &dest,
+		const VectorInt &dest_pos,
+		const synfig::Surface &src,
+		const RectInt &src_rect,
+		ColorReal amount,
+		Color::BlendMethod method );
+};
+
+} /* end namespace software */
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -32,7 +32,11 @@
 #include <cassert>
 
 #include <algorithm>
+#include <cstring>
 #include <functional>
+#include <vector>
+
+#include <synfig/threadpool.h>
 
 #include "blur.h"
 
@@ -51,6 +55,162 @@ using namespace rendering;
 
 /* === P R O C E D U R E S ================================================= */
 
+namespace {
+
+typedef software::Array<ColorReal, 1> Line;
+
+//! Applies one-dimensional filter to every row or to every column
+//! of surface with four interleaved channels. Lines are distributed
+//! between threads. Columns are copied into contiguous buffer by blocks
+//! of adjacent columns, so filter never walks the surface with full-row stride.
+class LinePass
+{
+public:
+	static const int channels = 4;
+	static const int column_block = 16;
+	static const int min_parallel_pixels = 128*128;
+
+	ColorReal *dst;
+	ColorReal *src;
+	int rows;
+	int cols;
+
+	LinePass(ColorReal *dst, ColorReal *src, int rows, int cols):
+		dst(dst), src(src), rows(rows), cols(cols) { }
+	virtual ~LinePass() { }
+
+	void run(bool columns);
+
+protected:
+	//! Filters one channel of one line, \a dst and \a src are the same for in-place filters
+	virtual void process(const Line &dst, const Line &src) = 0;
+
+private:
+	void process_rows(int begin, int end);
+	void process_columns(int begin, int end);
+};
+
+void
+LinePass::run(bool columns)
+{
+	int count = columns ? cols : rows;
+	int block = columns ? column_block : 1;
+	int chunk = count;
+	if (rows*cols >= min_parallel_pixels) {
+		// few chunks per thread to balance the load
+		int chunks = 4*std::max(1, ThreadPool::instance().get_max_threads());
+		chunk = std::max(block, (count/chunks + block - 1)/block*block);
+	}
+
+	ThreadPool::Group group;
+	for(int i = 0; i < count; i += chunk)
+		group.enqueue( sigc::bind(
+			sigc::mem_fun(*this, columns ? &LinePass::process_columns : &LinePass::process_rows),
+			i, std::min(count, i + chunk) ));
+	group.run();
+}
+
+void
+LinePass::process_rows(int begin, int end)
+{
+	int stride = cols*channels;
+	for(int r = begin; r < end; ++r)
+		for(int c = 0; c < channels; ++c)
+			process(
+				Line(dst + r*stride + c, cols, channels),
+				Line(src + r*stride + c, cols, channels) );
+}
+
+void
+LinePass::process_columns(int begin, int end)
+{
+	// buffers have layout [column][channel][row]
+	int stride = cols*channels;
+	int size = column_block*channels*rows;
+	std::vector<ColorReal> buffer(src == dst ? size : 2*size);
+	ColorReal *dst_buffer = &buffer.front();
+	ColorReal *src_buffer = src == dst ? dst_buffer : dst_buffer + size;
+
+	for(int c0 = begin; c0 < end; c0 += column_block) {
+		int count = std::min(column_block, end - c0)*channels;
+		int offset = c0*channels;
+
+		for(int r = 0; r < rows; ++r) {
+			const ColorReal *d = dst + r*stride + offset;
+			for(int i = 0; i < count; ++i)
+				dst_buffer[i*rows + r] = d[i];
+		}
+		if (src != dst)
+			for(int r = 0; r < rows; ++r) {
+				const ColorReal *s = src + r*stride + offset;
+				for(int i = 0; i < count; ++i)
+					src_buffer[i*rows + r] = s[i];
+			}
+
+		for(int i = 0; i < count; ++i)
+			process(
+				Line(dst_buffer + i*rows, rows, 1),
+				Line(src_buffer + i*rows, rows, 1) );
+
+		for(int r = 0; r < rows; ++r) {
+			ColorReal *d = dst + r*stride + offset;
+			for(int i = 0; i < count; ++i)
+				d[i] = dst_buffer[i*rows + r];
+		}
+	}
+}
+
+class PatternPass: public LinePass
+{
+public:
+	Line pattern;
+
+	PatternPass(ColorReal *dst, ColorReal *src, int rows, int cols, const Line &pattern):
+		LinePass(dst, src, rows, cols), pattern(pattern) { }
+
+protected:
+	virtual void process(const Line &dst, const Line &src)
+		{ software::BlurTemplates::blur_pattern(dst, src, pattern); }
+};
+
+class BoxPass: public LinePass
+{
+public:
+	ColorReal size;
+	bool discrete;
+	int count;
+
+	BoxPass(ColorReal *surface, int rows, int cols, ColorReal size, bool discrete, int count):
+		LinePass(surface, surface, rows, cols), size(size), discrete(discrete), count(count) { }
+
+protected:
+	virtual void process(const Line &dst, const Line &)
+	{
+		std::deque<ColorReal> q;
+		for(int i = 0; i < count; ++i)
+			if (discrete)
+				software::BlurTemplates::blur_box_discrete(dst, q, (int)round(size));
+			else
+				software::BlurTemplates::blur_box_aa(dst, q, size);
+	}
+};
+
+class IIRPass: public LinePass
+{
+public:
+	ColorReal k0, k1, k2, k3;
+
+	IIRPass(ColorReal *surface, int rows, int cols, const software::Blur::IIRCoefficients &k):
+		LinePass(surface, surface, rows, cols),
+		k0((ColorReal)k.k0), k1((ColorReal)k.k1), k2((ColorReal)k.k2), k3((ColorReal)k.k3) { }
+
+protected:
+	virtual void process(const Line &dst, const Line &)
+		{ software::BlurTemplates::blur_iir(dst, k0, k1, k2, k3); }
+};
+
+} // end of anonymous namespace
+
 /* === M E T H O D S ======================================================= */
 
 bool
@@ -258,32 +418,21 @@ software::Blur::blur_pattern(const Params &params)
 		BlurTemplates::normalize_half_pattern( arr_row_pattern );
 		BlurTemplates::normalize_half_pattern( arr_col_pattern );
 
-		Array<ColorReal, 3> arr_src_surface_rows(arr_src_surface.reorder(2, 0, 1));
-		Array<ColorReal, 3> arr_src_surface_cols(arr_src_surface_rows.reorder(0, 2, 1));
-
-		Array<ColorReal, 3> arr_dst_surface_rows(arr_dst_surface.reorder(2, 0, 1));
-		Array<ColorReal, 3> arr_dst_surface_cols(arr_dst_surface_rows.reorder(0, 2, 1));
-
 		if (cross)
 		{
 			arr_row_pattern.process< std::multiplies<ColorReal> >(0.5);
 			arr_col_pattern.process< std::multiplies<ColorReal> >(0.5);
 		}
 
-		for(Array<ColorReal, 3>::Iterator src_channel(arr_src_surface_rows), dst_channel(arr_dst_surface_rows); dst_channel; ++src_channel, ++dst_channel)
-			for(Array<ColorReal, 2>::Iterator sr(*src_channel), dr(*dst_channel); dr; ++sr, ++dr)
-				BlurTemplates::blur_pattern(*dr, *sr, arr_row_pattern);
+		PatternPass(arr_dst_surface.pointer, arr_src_surface.pointer, rows, cols, arr_row_pattern).run(false);
 
 		if (!cross)
 		{
-			swap(arr_src_surface_cols.pointer, arr_dst_surface_cols.pointer);
 			swap(arr_src_surface.pointer, arr_dst_surface.pointer);
 			memset(&src_surface.front(), 0, sizeof(src_surface.front())*src_surface.size());
 		}
 
-		for(Array<ColorReal, 3>::Iterator src_channel(arr_src_surface_cols), dst_channel(arr_dst_surface_cols); dst_channel; ++src_channel, ++dst_channel)
-			for(Array<ColorReal, 2>::Iterator sr(*src_channel), dr(*dst_channel); dr; ++sr, ++dr)
-				BlurTemplates::blur_pattern(*dr, *sr, arr_row_pattern);
+		PatternPass(arr_dst_surface.pointer, arr_src_surface.pointer, rows, cols, arr_col_pattern).run(true);
 	}
 
 	// copy result surface and restore alpha
@@ -391,13 +540,13 @@ software::Blur::blur_fft(const Params &params)
 		BlurTemplates::mirror_pattern_2d( arr_full_pattern.reorder(0, 1) );
 		BlurTemplates::normalize_full_pattern_2d( arr_full_pattern.reorder(0, 1) );
 
+		// all channels are transformed by single plan
+		Array<Complex, 3> arr_channels(arr_surface.group_items<Complex>().reorder(2, 0, 1));
 		FFT::fft2d(arr_full_pattern.group_items<Complex>(), false);
-		for(Array<Complex, 3>::Iterator channel(arr_surface.group_items<Complex>().reorder(2, 0, 1)); channel; ++channel)
-		{
-			FFT::fft2d(*channel, false);
+		FFT::fft2d_batch(arr_channels, false);
+		for(Array<Complex, 3>::Iterator channel(arr_channels); channel; ++channel)
 			channel->process< std::multiplies<Complex> >(arr_full_pattern.group_items<Complex>());
-			FFT::fft2d(*channel, true);
-		}
+		FFT::fft2d_batch(arr_channels, true);
 	}
 	else
 	{
@@ -419,22 +568,18 @@ software::Blur::blur_fft(const Params &params)
 		}
 
 		FFT::fft(arr_row_pattern.group_items<Complex>(), false);
+		FFT::fft2d_batch(arr_surface_rows, false, true, false);
 		for(Array<Complex, 3>::Iterator channel(arr_surface_rows); channel; ++channel)
-		{
-			FFT::fft2d(*channel, false, true, false);
 			for(Array<Complex, 2>::Iterator r(*channel); r; ++r)
 				r->process< std::multiplies<Complex> >(arr_row_pattern.group_items<Complex>());
-			FFT::fft2d(*channel, true, true, false);
-		}
+		FFT::fft2d_batch(arr_surface_rows, true, true, false);
 
 		FFT::fft(arr_col_pattern.group_items<Complex>(), false);
+		FFT::fft2d_batch(arr_surface_cols, false, true, false);
 		for(Array<Complex, 3>::Iterator channel(arr_surface_cols); channel; ++channel)
-		{
-			FFT::fft2d(*channel, false, true, false);
 			for(Array<Complex, 2>::Iterator c(*channel); c; ++c)
 				c->process< std::multiplies<Complex> >(arr_col_pattern.group_items<Complex>());
-			FFT::fft2d(*channel, true, true, false);
-		}
+		FFT::fft2d_batch(arr_surface_cols, true, true, false);
 
 		arr_surface_rows.process< BlurTemplates::Abs<Complex> >();
 		if (cross)
@@ -493,7 +638,6 @@ software::Blur::blur_box(const Params &params)
 		return;
 	}
 
-	deque<ColorReal> q;
 	vector<ColorReal> surface_copy;
 	Array<ColorReal, 3> arr_surface_rows(arr_surface.reorder(2, 0, 1));
 	Array<ColorReal, 3> arr_surface_cols(arr_surface_rows.reorder(0, 2, 1));
@@ -505,27 +649,10 @@ software::Blur::blur_box(const Params &params)
 		arr_surface_cols.pointer = &surface_copy.front();
 	}
 
-	if (true || fabs(size[0] - round(size[0])) < precision)
-		for(Array<ColorReal, 3>::Iterator channel(arr_surface_rows); channel; ++channel)
-			for(Array<ColorReal, 2>::Iterator r(*channel); r; ++r)
-				for(int i = 0; i < count; ++i)
-					BlurTemplates::blur_box_discrete(*r, q, (int)round(size[0]));
-	else
-		for(Array<ColorReal, 3>::Iterator channel(arr_surface_rows); channel; ++channel)
-			for(Array<ColorReal, 2>::Iterator r(*channel); r; ++r)
-				for(int i = 0; i < count; ++i)
-					BlurTemplates::blur_box_aa(*r, q, (ColorReal)size[0]);
-
-	if (true || fabs(size[1] - round(size[1])) < precision)
-		for(Array<ColorReal, 3>::Iterator channel(arr_surface_cols); channel; ++channel)
-			for(Array<ColorReal, 2>::Iterator c(*channel); c; ++c)
-				for(int i = 0; i < count; ++i)
-					BlurTemplates::blur_box_discrete(*c, q, (int)round(size[1]));
-	else
-		for(Array<ColorReal, 3>::Iterator channel(arr_surface_cols); channel; ++channel)
-			for(Array<ColorReal, 2>::Iterator c(*channel); c; ++c)
-				for(int i = 0; i < count; ++i)
-					BlurTemplates::blur_box_aa(*c, q, (ColorReal)size[1]);
+	BoxPass( arr_surface_rows.pointer, rows, cols, (ColorReal)size[0],
+			 true || fabs(size[0] - round(size[0])) < precision, count ).run(false);
+	BoxPass( arr_surface_cols.pointer, rows, cols, (ColorReal)size[1],
+			 true || fabs(size[1] - round(size[1])) < precision, count ).run(true);
 
 	if (cross)
 		arr_surface_rows
@@ -637,45 +764,17 @@ software::Blur::blur_iir(const Params &params)
 		return;
 	}
 
-	Array<ColorReal, 3> arr_surface_rows(arr_surface.reorder(2, 0, 1));
-	Array<ColorReal, 3> arr_surface_cols(arr_surface_rows.reorder(0, 2, 1));
-
-	IIRCoefficients cr = get_iir_coefficients(params.amplified_size[0]);
-	IIRCoefficients cc = get_iir_coefficients(params.amplified_size[1]);
-
-	ColorReal cr0 = (ColorReal)cr.k0;
-	ColorReal cr1 = (ColorReal)cr.k1;
-	ColorReal cr2 = (ColorReal)cr.k2;
-	ColorReal cr3 = (ColorReal)cr.k3;
-
-	ColorReal cc0 = (ColorReal)cc.k0;
-	ColorReal cc1 = (ColorReal)cc.k1;
-	ColorReal cc2 = (ColorReal)cc.k2;
-	ColorReal cc3 = (ColorReal)cc.k3;
-
-	Array<ColorReal, 3> arr_src_surface_rows(arr_surface.reorder(2, 0, 1));
-	Array<ColorReal, 3> arr_src_surface_cols(arr_surface_rows.reorder(0, 2, 1));
-
-	Array<ColorReal, 3> arr_dst_surface_rows(arr_tmp_surface.reorder(2, 0, 1));
-	Array<ColorReal, 3> arr_dst_surface_cols(arr_dst_surface_rows.reorder(0, 2, 1));
-	
 	if (fabs(params.amplified_size[0]) > precision)
 	{
 		if (use_row_pattern)
 		{
-			for(Array<ColorReal, 3>::Iterator src_channel(arr_src_surface_rows), dst_channel(arr_dst_surface_rows); dst_channel; ++src_channel, ++dst_channel)
-				for(Array<ColorReal, 2>::Iterator sr(*src_channel), dr(*dst_channel); dr; ++sr, ++dr)
-					BlurTemplates::blur_pattern(*dr, *sr, arr_row_pattern);
-			swap(arr_src_surface_cols.pointer, arr_dst_surface_cols.pointer);
+			PatternPass(arr_tmp_surface.pointer, arr_surface.pointer, rows, cols, arr_row_pattern).run(false);
 			swap(arr_surface.pointer, arr_tmp_surface.pointer);
-			arr_surface_cols.pointer = arr_surface.pointer;
 			memset(&surface.front(), 0, sizeof(surface.front())*surface.size());
 		}
 		else
 		{
-			for(Array<ColorReal, 3>::Iterator channel(arr_surface_rows); channel; ++channel)
-				for(Array<ColorReal, 2>::Iterator r(*channel); r; ++r)
-					BlurTemplates::blur_iir(*r, cr0, cr1, cr2, cr3);
+			IIRPass(arr_surface.pointer, rows, cols, get_iir_coefficients(params.amplified_size[0])).run(false);
 		}
 	}
 
@@ -683,16 +782,12 @@ software::Blur::blur_iir(const Params &params)
 	{
 		if (use_col_pattern)
 		{
-			for(Array<ColorReal, 3>::Iterator src_channel(arr_src_surface_cols), dst_channel(arr_dst_surface_cols); dst_channel; ++src_channel, ++dst_channel)
-				for(Array<ColorReal, 2>::Iterator sr(*src_channel), dr(*dst_channel); dr; ++sr, ++dr)
-					BlurTemplates::blur_pattern(*dr, *sr, arr_col_pattern);
+			PatternPass(arr_tmp_surface.pointer, arr_surface.pointer, rows, cols, arr_col_pattern).run(true);
 			swap(arr_surface.pointer, arr_tmp_surface.pointer);
 		}
 		else
 		{
-			for(Array<ColorReal, 3>::Iterator channel(arr_surface_cols); channel; ++channel)
-				for(Array<ColorReal, 2>::Iterator c(*channel); c; ++c)
-					BlurTemplates::blur_iir(*c, cc0, cc1, cc2, cc3);
+			IIRPass(arr_surface.pointer, rows, cols, get_iir_coefficients(params.amplified_size[1])).run(true);
 		}
 	}
 
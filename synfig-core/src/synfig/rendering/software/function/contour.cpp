@@ -29,8 +29,15 @@
 #	include <config.h>
 #endif
 
+#include <climits>
+
+#include <algorithm>
+#include <vector>
+
 #include "contour.h"
+#include "blend.h"
 
+#include <synfig/threadpool.h>
 #include <synfig/debug/debugsurface.h>
 
 #endif
@@ -44,87 +51,167 @@ using namespace rendering;
 
 /* === P R O C E D U R E S ================================================= */
 
-/* === M E T H O D S ======================================================= */
+namespace {
+
+//! Renders the marks of polyspan scanline by scanline,
+//! horizontal bands of scanlines are independent and may be rendered in parallel
+class PolyspanRenderer
+{
+public:
+	typedef Polyspan::cover_array::const_iterator Iterator;
+
+	struct Band
+	{
+		RectInt window;
+		Iterator begin;
+		Iterator end;
+	};
+
+	static const int min_band_rows = 32;
+	static const int min_parallel_pixels = 256*256;
+
+	synfig::Surface &target_surface;
+	const Polyspan &polyspan;
+	bool invert;
+	bool antialias;
+	rendering::Contour::WindingStyle winding_style;
+	Color color;
+	Color::value_type opacity;
+	Color::BlendMethod blend_method;
+	bool simple_fill;
+	software::Blend::Instructions instructions;
+	std::vector<Color> color_row; // source row for software::Blend::blend_row()
+	std::vector<Band> bands;
+
+	PolyspanRenderer(
+		synfig::Surface &target_surface,
+		const Polyspan &polyspan,
+		bool invert,
+		bool antialias,
+		rendering::Contour::WindingStyle winding_style,
+		const Color &color,
+		Color::value_type opacity,
+		Color::BlendMethod blend_method
+	):
+		target_surface(target_surface),
+		polyspan(polyspan),
+		invert(invert),
+		antialias(antialias),
+		winding_style(winding_style),
+		color(color),
+		opacity(opacity),
+		blend_method(blend_method),
+		simple_fill( (Color::BLEND_METHODS_OVERWRITE_ON_ALPHA_ONE & (1 << blend_method))
+			      && fabsf(1.f - opacity*color.get_a()) <= 1e-6 ),
+		instructions(software::Blend::get_instructions())
+	{
+		if (!simple_fill)
+			color_row.resize(std::max(1, polyspan.get_window().maxx - polyspan.get_window().minx), color);
+	}
+
+	void split(int count);
+	void run();
+
+	//! Fills horizontal span by color, interior spans needs no per-pixel coverage
+	void fill(int x, int y, int length);
+	void fill_block(int x, int y, int width, int height);
+	void render_band(int index);
+};
 
 void
-software::Contour::render_polyspan(
-	synfig::Surface &target_surface,
-	const Polyspan &polyspan,
-	bool invert,
-	bool antialias,
-	rendering::Contour::WindingStyle winding_style,
-	const Color &color,
-	Color::value_type opacity,
-	Color::BlendMethod blend_method )
+PolyspanRenderer::split(int count)
 {
-	bool simple_fill = (Color::BLEND_METHODS_OVERWRITE_ON_ALPHA_ONE & (1 << blend_method))
-			        && fabsf(1.f - opacity*color.get_a()) <= 1e-6;
+	const Polyspan::cover_array &covers = polyspan.get_covers();
+	const RectInt &window = polyspan.get_window();
+	int rows = window.maxy - window.miny;
 
-	synfig::Surface::alpha_pen p(target_surface.begin(), opacity, blend_method);
-	synfig::Surface::pen sp(target_surface.begin());
+	// marks are sorted by scanlines, marks outside of window
+	// are kept in the first and in the last bands as if there is a single band
+	bands.resize(count);
+	Iterator begin = covers.begin();
+	for(int i = 0; i < count; ++i)
+	{
+		Band &band = bands[i];
+		band.window = window;
+		band.window.miny = window.miny + (int)((long long)rows*i/count);
+		band.window.maxy = window.miny + (int)((long long)rows*(i + 1)/count);
+		band.begin = begin;
+		band.end = i + 1 == count ? covers.end()
+		         : std::lower_bound(begin, covers.end(), Polyspan::PenMark(INT_MIN, band.window.maxy, 0, 0));
+		begin = band.end;
+	}
+}
+
+void
+PolyspanRenderer::run()
+{
 	const RectInt &window = polyspan.get_window();
-	const Polyspan::cover_array &covers = polyspan.get_covers();
+	int rows = window.maxy - window.miny;
+	int count = 1;
+	if ( rows >= 2*min_band_rows
+	  && (long long)rows*(window.maxx - window.minx) >= min_parallel_pixels )
+		count = std::min(rows/min_band_rows, 4*std::max(1, ThreadPool::instance().get_max_threads()));
+
+	split(count);
+	if (count == 1)
+		{ render_band(0); return; }
+
+	ThreadPool::Group group;
+	for(int i = 0; i < count; ++i)
+		group.enqueue( sigc::bind(sigc::mem_fun(*this, &PolyspanRenderer::render_band), i) );
+	group.run();
+}
 
-	Polyspan::cover_array::const_iterator cur_mark = covers.begin();
-	Polyspan::cover_array::const_iterator end_mark = covers.end();
+void
+PolyspanRenderer::fill(int x, int y, int length)
+{
+	if (length <= 0) return;
+	Color *row = &target_surface[y][x];
+	if (simple_fill)
+	{
+		std::fill(row, row + length, color);
+		return;
+	}
+	for(int i = 0, count = (int)color_row.size(); i < length; i += count)
+		software::Blend::blend_row(row + i, &color_row.front(), std::min(count, length - i), opacity, blend_method, instructions);
+}
 
-	Real cover = 0, area = 0, alpha = 0;
-	int	y = 0, x = 0;
+void
+PolyspanRenderer::fill_block(int x, int y, int width, int height)
+{
+	for(int i = 0; i < height; ++i)
+		fill(x, y + i, width);
+}
+
+void
+PolyspanRenderer::render_band(int index)
+{
+	const RectInt &window = bands[index].window;
+	Iterator cur_mark = bands[index].begin;
+	Iterator end_mark = bands[index].end;
 
+	// pen is used for edge pixels only, interior spans are filled by rows
+	synfig::Surface::alpha_pen p(target_surface.begin(), opacity, blend_method);
 	p.set_value(color);
-	sp.set_value(color);
-	cover = 0;
+
+	Real cover = 0, area = 0, alpha = 0;
+	int	y = 0, x = 0;
 
 	if (cur_mark == end_mark)
 	{
 		// no marks at all
 		if (invert)
-		{
-			if (simple_fill)
-			{
-				sp.move_to(window.minx, window.miny);
-				sp.put_block(window.maxy - window.miny, window.maxx - window.minx);
-			}
-			else
-			{
-				p.move_to(window.minx, window.miny);
-				p.put_block(window.maxy - window.miny, window.maxx - window.minx);
-			}
-		}
+			fill_block(window.minx, window.miny, window.maxx - window.minx, window.maxy - window.miny);
 		return;
 	}
 
 	// fill initial rect / line
 	if (invert)
 	{
-		if (simple_fill)
-		{
-			// fill all the area above the first vertex
-			sp.move_to(window.minx, window.miny);
-			y = window.miny;
-			int l = window.maxx - window.minx;
-
-			sp.put_block(cur_mark->y - window.miny, l);
-
-			// fill the area to the left of the first vertex on that line
-			l = cur_mark->x - window.minx;
-			sp.move_to(window.minx, cur_mark->y);
-			if (l) sp.put_hline(l);
-		}
-		else
-		{
-			// fill all the area above the first vertex
-			p.move_to(window.minx, window.miny);
-			y = window.miny;
-			int l = window.maxx - window.minx;
-
-			p.put_block(cur_mark->y - window.miny, l);
-
-			// fill the area to the left of the first vertex on that line
-			l = cur_mark->x - window.minx;
-			p.move_to(window.minx, cur_mark->y);
-			if (l) p.put_hline(l);
-		}
+		// fill all the area above the first vertex
+		fill_block(window.minx, window.miny, window.maxx - window.minx, cur_mark->y - window.miny);
+		// fill the area to the left of the first vertex on that line
+		fill(window.minx, cur_mark->y, cur_mark->x - window.minx);
 	}
 
 	while(true)
@@ -132,13 +219,11 @@ software::Contour::render_polyspan(
 		y = cur_mark->y;
 		x = cur_mark->x;
 
-		p.move_to(x,y);
-
 		area = cur_mark->area;
 		cover += cur_mark->cover;
 
 		// accumulate for the current pixel
-		while(++cur_mark != covers.end())
+		while(++cur_mark != end_mark)
 		{
 			if (y != cur_mark->y || x != cur_mark->x)
 				break;
@@ -153,6 +238,7 @@ software::Contour::render_polyspan(
 			alpha = polyspan.extract_alpha(cover - area, winding_style);
 			if (invert) alpha = 1 - alpha;
 
+			p.move_to(x, y);
 			if (antialias)
 			{
 				if (alpha) p.put_value_alpha(alpha);
@@ -162,7 +248,6 @@ software::Contour::render_polyspan(
 				if (alpha >= .5) p.put_value();
 			}
 
-			p.inc_x();
 			++x;
 		}
 
@@ -175,27 +260,9 @@ software::Contour::render_polyspan(
 			if (invert)
 			{
 				// fill the area at the end of the line
-				if (simple_fill)
-				{
-					sp.move_to(p);
-					sp.put_hline(window.maxx - x);
-				}
-				else
-				{
-					p.put_hline(window.maxx - x);
-				}
-
+				fill(x, y, window.maxx - x);
 				// fill area at the beginning of the next line
-				if (simple_fill)
-				{
-					sp.move_to(window.minx, cur_mark->y);
-					sp.put_hline(cur_mark->x - window.minx);
-				}
-				else
-				{
-					p.move_to(window.minx, cur_mark->y);
-					p.put_hline(cur_mark->x - window.minx);
-				}
+				fill(window.minx, cur_mark->y, cur_mark->x - window.minx);
 			}
 
 			cover = 0;
@@ -208,56 +275,45 @@ software::Contour::render_polyspan(
 			alpha = polyspan.extract_alpha(cover, winding_style);
 			if (invert) alpha = 1 - alpha;
 			if (alpha >= .5)
-			{
-				if (simple_fill)
-				{
-					sp.move_to(p);
-					sp.put_hline(cur_mark->x - x);
-					p.move_to(sp);
-				}
-				else
-				{
-					p.put_hline(cur_mark->x - x);
-				}
-			}
-
-			/*
-			if (antialias)
-			{
-				if (alpha) p.put_hline(cur_mark->x - x, alpha);
-			}
-			else
-			{
-				if (alpha >= .5) p.put_hline(cur_mark->x - x);
-			}
-			*/
+				fill(x, y, cur_mark->x - x);
 		}
 	}
 
 	// fill the after stuff
 	if (invert)
 	{
-		if (simple_fill)
-		{
-			sp.move_to(p);
+		//fill the area at the end of the line
+		fill(x, y, window.maxx - x);
 
-			//fill the area at the end of the line
-			sp.put_hline(window.maxx - x);
+		//fill area at the beginning of the next line
+		fill_block(window.minx, y + 1, window.maxx - window.minx, window.maxy - y - 1);
+	}
+}
 
-			//fill area at the beginning of the next line
-			sp.move_to(window.minx, y+1);
-			sp.put_block(window.maxy - y - 1, window.maxx - window.minx);
-		}
-		else
-		{
-			//fill the area at the end of the line
-			p.put_hline(window.maxx - x);
+} // end of anonymous namespace
 
-			//fill area at the beginning of the next line
-			p.move_to(window.minx, y+1);
-			p.put_block(window.maxy - y - 1, window.maxx - window.minx);
-		}
-	}
+/* === M E T H O D S ======================================================= */
+
+void
+software::Contour::render_polyspan(
+	synfig::Surface &target_surface,
+	const Polyspan &polyspan,
+	bool invert,
+	bool antialias,
+	rendering::Contour::WindingStyle winding_style,
+	const Color &color,
+	Color::value_type opacity,
+	Color::BlendMethod blend_method )
+{
+	PolyspanRenderer(
+		target_surface,
+		polyspan,
+		invert,
+		antialias,
+		winding_style,
+		color,
+		opacity,
+		blend_method ).run();
 }
 
 void
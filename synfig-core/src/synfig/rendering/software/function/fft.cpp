@@ -31,15 +31,21 @@
 
 #include <cassert>
 #include <climits>
+#include <cstdlib>
 //#include <ccomplex>
 
 #include <mutex>
 
+#include <list>
+#include <map>
+#include <memory>
 #include <vector>
 #include <set>
 
 #include <fftw3.h>
 
+#include <synfig/general.h>
+
 #include "fft.h"
 
 #endif
@@ -58,12 +64,122 @@ using namespace rendering;
 class software::FFT::Internal
 {
 public:
+	typedef std::vector<long long> Key;
+	typedef std::shared_ptr<fftw_plan_s> Plan;
+	typedef std::map<Key, Plan> PlanMap;
+
 	static std::set<int> counts;
-	static std::mutex mutex;
+
+	// FFTW planner is not thread-safe, plans are created and destroyed under this mutex,
+	// execution of plan by fftw_execute_dft is thread-safe
+	static std::recursive_mutex mutex;
+	static PlanMap plans;
+	static std::list<Key> plans_order;
+	static unsigned int flags;
+	static std::string wisdom_filename;
+
+	static void destroy_plan(fftw_plan plan) {
+		std::lock_guard<std::recursive_mutex> lock(mutex);
+		fftw_destroy_plan(plan);
+	}
+
+	static void add_dims(Key &key, int rank, const fftw_iodim *dims) {
+		key.push_back(rank);
+		for(int i = 0; i < rank; ++i) {
+			key.push_back(dims[i].n);
+			key.push_back(dims[i].is);
+			key.push_back(dims[i].os);
+		}
+	}
+
+	static void add_extent(int rank, const fftw_iodim *dims, int &min_offset, int &max_offset) {
+		for(int i = 0; i < rank; ++i) {
+			int offset = (dims[i].n - 1)*dims[i].is;
+			if (offset < 0) min_offset += offset; else max_offset += offset;
+		}
+	}
+
+	static Plan create_plan(
+		int rank, const fftw_iodim *dims,
+		int howmany_rank, const fftw_iodim *howmany_dims,
+		Complex *pointer, int sign )
+	{
+		fftw_complex *data = (fftw_complex*)pointer;
+		fftw_complex *buffer = NULL;
+
+		// measuring planner overwrites the arrays, so use temporary buffer
+		// with the same layout and alignment (required by fftw_execute_dft)
+		if (flags != FFTW_ESTIMATE) {
+			int min_offset = 0, max_offset = 0;
+			add_extent(rank, dims, min_offset, max_offset);
+			add_extent(howmany_rank, howmany_dims, min_offset, max_offset);
+			const int align = 64;
+			buffer = (fftw_complex*)fftw_malloc((max_offset - min_offset + 1)*sizeof(fftw_complex) + align);
+			data = (fftw_complex*)((char*)buffer + fftw_alignment_of((double*)pointer)) - min_offset;
+		}
+
+		fftw_plan plan = fftw_plan_guru_dft(
+			rank, dims, howmany_rank, howmany_dims,
+			data, data, sign, flags );
+
+		if (buffer)
+			fftw_free(buffer);
+		return plan ? Plan(plan, destroy_plan) : Plan();
+	}
+
+	static Plan get_plan(
+		int rank, const fftw_iodim *dims,
+		int howmany_rank, const fftw_iodim *howmany_dims,
+		Complex *pointer, bool invert )
+	{
+		int sign = invert ? FFTW_BACKWARD : FFTW_FORWARD;
+
+		Key key;
+		add_dims(key, rank, dims);
+		add_dims(key, howmany_rank, howmany_dims);
+		key.push_back(sign);
+		key.push_back(fftw_alignment_of((double*)pointer));
+
+		std::lock_guard<std::recursive_mutex> lock(mutex);
+		PlanMap::const_iterator i = plans.find(key);
+		if (i != plans.end())
+			return i->second;
+
+		Plan plan = create_plan(rank, dims, howmany_rank, howmany_dims, pointer, sign);
+		if (!plan)
+			return plan;
+
+		// remove the oldest plan, it will be destroyed when it's not in use
+		if ((int)plans.size() >= max_plans) {
+			plans.erase(plans_order.front());
+			plans_order.pop_front();
+		}
+		plans[key] = plan;
+		plans_order.push_back(key);
+		return plan;
+	}
+
+	static void execute(
+		int rank, const fftw_iodim *dims,
+		int howmany_rank, const fftw_iodim *howmany_dims,
+		Complex *pointer, bool invert )
+	{
+		Plan plan = get_plan(rank, dims, howmany_rank, howmany_dims, pointer, invert);
+		assert(plan);
+		if (plan)
+			fftw_execute_dft(plan.get(), (fftw_complex*)pointer, (fftw_complex*)pointer);
+	}
+
+	static void set_dim(fftw_iodim &dim, int count, int stride)
+		{ dim.n = count; dim.is = stride; dim.os = stride; }
 };
 
 std::set<int> software::FFT::Internal::counts;
-std::mutex software::FFT::Internal::mutex;
+std::recursive_mutex software::FFT::Internal::mutex;
+software::FFT::Internal::PlanMap software::FFT::Internal::plans;
+std::list<software::FFT::Internal::Key> software::FFT::Internal::plans_order;
+unsigned int software::FFT::Internal::flags = FFTW_ESTIMATE;
+std::string software::FFT::Internal::wisdom_filename;
 
 void
 software::FFT::initialize()
@@ -78,11 +194,30 @@ software::FFT::initialize()
 				for(int c7 = c5; c7 < max7; c7 *= 7)
 					Internal::counts.insert(c7);
 	fftw_set_timelimit(0.0);
+
+	Internal::flags = FFTW_ESTIMATE;
+	Internal::wisdom_filename.clear();
+	if (const char *s = getenv("SYNFIG_RENDERING_FFTW_WISDOM")) {
+		Internal::wisdom_filename = s;
+		if (!Internal::wisdom_filename.empty()) {
+			// measured plans are slower to create, so don't limit time
+			// and keep them in wisdom file for the next runs
+			fftw_set_timelimit(FFTW_NO_TIMELIMIT);
+			Internal::flags = FFTW_MEASURE;
+			fftw_import_wisdom_from_filename(Internal::wisdom_filename.c_str());
+		}
+	}
 }
 
 void
 software::FFT::deinitialize()
 {
+	std::lock_guard<std::recursive_mutex> lock(Internal::mutex);
+	Internal::plans.clear();
+	Internal::plans_order.clear();
+	if (!Internal::wisdom_filename.empty())
+		if (!fftw_export_wisdom_to_filename(Internal::wisdom_filename.c_str()))
+			synfig::warning("FFT: cannot write wisdom file '%s'", Internal::wisdom_filename.c_str());
 	Internal::counts.clear();
 }
 
@@ -113,19 +248,8 @@ software::FFT::fft(const Array<Complex, 1> &x, bool invert)
 	assert(is_valid_count(x.count));
 
 	fftw_iodim iodim;
-	iodim.n  = x.count;
-	iodim.is = x.stride;
-	iodim.os = x.stride;
-
-	{
-		std::lock_guard<std::mutex> lock(Internal::mutex);
-		fftw_plan plan = fftw_plan_guru_dft(
-			1, &iodim, 0, NULL,
-			(fftw_complex*)x.pointer, (fftw_complex*)x.pointer,
-			invert ? FFTW_BACKWARD : FFTW_FORWARD, FFTW_ESTIMATE );
-		fftw_execute(plan);
-		fftw_destroy_plan(plan);
-	}
+	Internal::set_dim(iodim, x.count, x.stride);
+	Internal::execute(1, &iodim, 0, NULL, x.pointer, invert);
 
 	// divide by count to complete back-FFT
 	if (invert)
@@ -145,34 +269,13 @@ software::FFT::fft2d(const Array<Complex, 2> &x, bool invert, bool do_rows, bool
 	if (!do_rows && !do_cols) return;
 
 	fftw_iodim iodim[2];
-	iodim[0].n  = x.sub().count;
-	iodim[0].is = x.sub().stride;
-	iodim[0].os = x.sub().stride;
-	iodim[1].n  = x.count;
-	iodim[1].is = x.stride;
-	iodim[1].os = x.stride;
+	Internal::set_dim(iodim[0], x.sub().count, x.sub().stride);
+	Internal::set_dim(iodim[1], x.count, x.stride);
 
-	{
-		std::lock_guard<std::mutex> lock(Internal::mutex);
-
-		fftw_plan plan;
-		if (do_rows && do_cols)
-		{
-			plan = fftw_plan_guru_dft(
-				2, iodim, 0, NULL,
-				(fftw_complex*)x.pointer, (fftw_complex*)x.pointer,
-				invert ? FFTW_BACKWARD : FFTW_FORWARD, FFTW_ESTIMATE );
-		}
-		else
-		{
-			plan = fftw_plan_guru_dft(
-				1, &iodim[do_rows ? 0 : 1], 1, &iodim[do_rows ? 1 : 0],
-				(fftw_complex*)x.pointer, (fftw_complex*)x.pointer,
-				invert ? FFTW_BACKWARD : FFTW_FORWARD, FFTW_ESTIMATE );
-		}
-		fftw_execute(plan);
-		fftw_destroy_plan(plan);
-	}
+	if (do_rows && do_cols)
+		Internal::execute(2, iodim, 0, NULL, x.pointer, invert);
+	else
+		Internal::execute(1, &iodim[do_rows ? 0 : 1], 1, &iodim[do_rows ? 1 : 0], x.pointer, invert);
 
 	// divide by count to complete back-FFT
 	if (invert)
@@ -183,4 +286,42 @@ software::FFT::fft2d(const Array<Complex, 2> &x, bool invert, bool do_rows, bool
 	}
 }
 
+void
+software::FFT::fft2d_batch(const Array<Complex, 3> &x, bool invert, bool do_rows, bool do_cols)
+{
+	if (x.count == 0 || x.sub().count == 0 || x.sub().sub().count == 0) return;
+	if ( (!do_cols || x.sub().count == 1)
+	  && (!do_rows || x.sub().sub().count == 1) )
+		return;
+
+	assert(is_valid_count(x.sub().count) && is_valid_count(x.sub().sub().count));
+
+	if (!do_rows && !do_cols) return;
+
+	// dims: rows, cols, channels
+	fftw_iodim iodim[3];
+	Internal::set_dim(iodim[0], x.sub().sub().count, x.sub().sub().stride);
+	Internal::set_dim(iodim[1], x.sub().count, x.sub().stride);
+	Internal::set_dim(iodim[2], x.count, x.stride);
+
+	if (do_rows && do_cols)
+		Internal::execute(2, iodim, 1, &iodim[2], x.pointer, invert);
+	else
+	if (do_rows)
+		Internal::execute(1, &iodim[0], 2, &iodim[1], x.pointer, invert);
+	else
+	{
+		fftw_iodim howmany_iodim[2] = { iodim[0], iodim[2] };
+		Internal::execute(1, &iodim[1], 2, howmany_iodim, x.pointer, invert);
+	}
+
+	// divide by count to complete back-FFT
+	if (invert)
+	{
+		int count = (do_cols ? x.sub().count : 1)
+			      * (do_rows ? x.sub().sub().count : 1);
+		x.process< std::multiplies<Complex> >( Complex(1.0/(Real)count) );
+	}
+}
+
 /* === E N T R Y P O I N T ================================================= */
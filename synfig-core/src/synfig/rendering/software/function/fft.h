@@ -43,17 +43,27 @@ namespace rendering
 namespace software
 {
 
+//! FFT by FFTW library.
+//! Plans are cached and executed without locks, so transforms may run simultaneously.
+//! Planner flags and wisdom file are set by environment variables:
+//! SYNFIG_RENDERING_FFTW_WISDOM - file to load and store FFTW wisdom,
+//! when set plans are measured (FFTW_MEASURE) instead of estimated
 class FFT
 {
 private:
 	class Internal;
 
 public:
+	//! maximum count of plans kept in cache
+	static const int max_plans = 256;
+
 	static int get_valid_count(int x);
 	static bool is_valid_count(int x);
 
 	static void fft(const Array<Complex, 1> &x, bool invert);
 	static void fft2d(const Array<Complex, 2> &x, bool invert, bool do_rows = true, bool do_cols = true);
+	//! Does fft2d() for each item of the first dimension (channels) by single plan
+	static void fft2d_batch(const Array<Complex, 3> &x, bool invert, bool do_rows = true, bool do_cols = true);
 
 	static void initialize();
 	static void deinitialize();
@@ -29,7 +29,13 @@
 #	include <config.h>
 #endif
 
+#include <algorithm>
+#include <vector>
+
+#include <synfig/threadpool.h>
+
 #include "mesh.h"
+#include "blend.h"
 
 #endif
 
@@ -83,6 +89,207 @@ namespace {
 			if (coords[1] < 0.0 || coords[1] > size[1])
 				coords[1] -= floor(coords[1]/size[1])*size[1];
 		}
+
+		//! per-thread buffer for pixels of one span
+		static Color* get_span_buffer(int count)
+		{
+			static thread_local std::vector<Color> buffer;
+			if ((int)buffer.size() < count) buffer.resize(count);
+			return &buffer.front();
+		}
+
+		//! blends pixels [x0, x1] of row y by color
+		static void fill_span(
+			synfig::Surface &target_surface,
+			int y, int x0, int x1,
+			const Color &color,
+			Color::value_type opacity,
+			Color::BlendMethod blend_method )
+		{
+			int count = x1 - x0 + 1;
+			Color *buffer = get_span_buffer(count);
+			std::fill(buffer, buffer + count, color);
+			software::Blend::blend_row(&target_surface[y][x0], buffer, count, opacity, blend_method);
+		}
+
+		//! samples texture for pixels [x0, x1] of row y and blends them,
+		//! pixels outside of texture bounds are untouched
+		static void texture_span(
+			synfig::Surface &target_surface,
+			int y, int x0, int x1,
+			Vector tex_point,
+			const Vector &tdx,
+			const synfig::Surface &texture,
+			const Rect &tex_bounds,
+			Color::value_type opacity,
+			Color::BlendMethod blend_method )
+		{
+			Color *buffer = get_span_buffer(x1 - x0 + 1) - x0;
+			int begin = x1 + 1;
+			for(int x = x0; x <= x1; ++x, tex_point += tdx)
+			{
+				if (tex_point[0] < tex_bounds.minx || tex_point[0] > tex_bounds.maxx
+				 || tex_point[1] < tex_bounds.miny || tex_point[1] > tex_bounds.maxy)
+				{
+					if (begin < x)
+						software::Blend::blend_row(&target_surface[y][begin], buffer + begin, x - begin, opacity, blend_method);
+					begin = x1 + 1;
+					continue;
+				}
+				if (begin > x) begin = x;
+				buffer[x] = texture.cubic_sample(tex_point[0], tex_point[1]);
+			}
+			if (begin <= x1)
+				software::Blend::blend_row(&target_surface[y][begin], buffer + begin, x1 + 1 - begin, opacity, blend_method);
+		}
+	};
+
+	//! Renders triangles of mesh in horizontal bands of target rect.
+	//! Triangles are binned into bands by their vertical extent,
+	//! bands are rendered in parallel, each band keeps order of triangles.
+	class MeshRenderer {
+	public:
+		static const int min_band_rows = 32;
+		static const int min_parallel_pixels = 256*256;
+
+		synfig::Surface &target_surface;
+		RectInt bounds;
+		const int *triangles;
+		int triangles_strip;
+		int triangles_count;
+		std::vector<Vector> vertices;
+		std::vector<Vector> tex_coords;
+		const synfig::Surface *texture;
+		Rect texture_rect;
+		Color color;
+		Color::value_type opacity;
+		Color::BlendMethod blend_method;
+
+		std::vector<RectInt> band_rects;
+		std::vector< std::vector<int> > band_triangles;
+
+		MeshRenderer(
+			synfig::Surface &target_surface,
+			const RectInt &bounds,
+			const int *triangles,
+			int triangles_strip,
+			int triangles_count
+		):
+			target_surface(target_surface),
+			bounds(bounds),
+			triangles(triangles),
+			triangles_strip(triangles_strip),
+			triangles_count(triangles_count),
+			texture(),
+			opacity(),
+			blend_method()
+		{ }
+
+		const int* triangle(int index) const
+			{ return (const int*)((const char*)triangles + index*triangles_strip); }
+
+		//! transforms each vertex once, vertices are shared by triangles
+		static void transform(
+			std::vector<Vector> &out,
+			const Vector *vertices,
+			int vertices_strip,
+			int count,
+			const Matrix &matrix )
+		{
+			out.resize(count);
+			for(int i = 0; i < count; ++i)
+				out[i] = matrix.get_transformed(*(const Vector*)((const char*)vertices + i*vertices_strip));
+		}
+
+		int get_vertices_count() const
+		{
+			int count = 0;
+			for(int i = 0; i < triangles_count; ++i)
+				for(int j = 0; j < 3; ++j)
+					count = std::max(count, triangle(i)[j] + 1);
+			return count;
+		}
+
+		void split()
+		{
+			int rows = bounds.maxy - bounds.miny;
+			int count = 1;
+			if ( rows >= 2*min_band_rows
+			  && (long long)rows*(bounds.maxx - bounds.minx) >= min_parallel_pixels )
+				count = std::min(rows/min_band_rows, 4*std::max(1, ThreadPool::instance().get_max_threads()));
+
+			band_rects.resize(count, bounds);
+			band_triangles.resize(count);
+			std::vector<int> band_of_row(rows);
+			for(int i = 0; i < count; ++i)
+			{
+				band_rects[i].miny = bounds.miny + (int)((long long)rows*i/count);
+				band_rects[i].maxy = bounds.miny + (int)((long long)rows*(i + 1)/count);
+				for(int y = band_rects[i].miny; y < band_rects[i].maxy; ++y)
+					band_of_row[y - bounds.miny] = i;
+			}
+			if (count == 1)
+			{
+				band_triangles[0].reserve(triangles_count);
+				for(int i = 0; i < triangles_count; ++i)
+					band_triangles[0].push_back(i);
+				return;
+			}
+
+			for(int i = 0; i < triangles_count; ++i)
+			{
+				const int *t = triangle(i);
+				// same rounding as in render_triangle()
+				int y0 = Internal::IntVector(vertices[t[0]]).y;
+				int y1 = y0;
+				for(int j = 1; j < 3; ++j)
+				{
+					int y = Internal::IntVector(vertices[t[j]]).y;
+					y0 = std::min(y0, y);
+					y1 = std::max(y1, y);
+				}
+				if (y1 < bounds.miny || y0 >= bounds.maxy) continue;
+				int b0 = band_of_row[std::max(y0, bounds.miny) - bounds.miny];
+				int b1 = band_of_row[std::min(y1, bounds.maxy - 1) - bounds.miny];
+				for(int b = b0; b <= b1; ++b)
+					band_triangles[b].push_back(i);
+			}
+		}
+
+		void render_band(int index)
+		{
+			const RectInt &rect = band_rects[index];
+			const std::vector<int> &list = band_triangles[index];
+			for(std::vector<int>::const_iterator i = list.begin(); i != list.end(); ++i)
+			{
+				const int *t = triangle(*i);
+				if (texture)
+					software::Mesh::render_triangle(
+						target_surface, rect,
+						vertices[t[0]], tex_coords[t[0]],
+						vertices[t[1]], tex_coords[t[1]],
+						vertices[t[2]], tex_coords[t[2]],
+						*texture, texture_rect, opacity, blend_method );
+				else
+					software::Mesh::render_triangle(
+						target_surface, rect,
+						vertices[t[0]], vertices[t[1]], vertices[t[2]],
+						color, opacity, blend_method );
+			}
+		}
+
+		void run()
+		{
+			split();
+			if (band_rects.size() == 1)
+				{ render_band(0); return; }
+
+			ThreadPool::Group group;
+			for(int i = 0; i < (int)band_rects.size(); ++i)
+				if (!band_triangles[i].empty())
+					group.enqueue( sigc::bind(sigc::mem_fun(*this, &MeshRenderer::render_band), i) );
+			group.run();
+		}
 	};
 }
 
@@ -111,10 +318,6 @@ software::Mesh::render_triangle(
 	if (ip0.x >= bounds.maxx && ip1.x >= bounds.maxx && ip2.x >= bounds.maxx) return;
 	if (ip0.y >= bounds.maxy && ip1.y >= bounds.maxy && ip2.y >= bounds.maxy) return;
 
-	synfig::Surface::alpha_pen apen(target_surface.get_pen(0, 0));
-	apen.set_alpha(opacity);
-	apen.set_blend_method(blend_method);
-
 	// sort points
 	if (ip0.y > ip1.y) std::swap(ip0, ip1);
 	if (ip0.y > ip2.y) std::swap(ip0, ip2);
@@ -147,14 +350,7 @@ software::Mesh::render_triangle(
 			if (x0 <  bounds.minx) x0 = bounds.minx;
 			if (x1 >= bounds.maxx) x1 = bounds.maxx-1;
 			if (x1 >= x0)
-			{
-				apen.move_to(x0, y);
-				for(int x = x0; x <= x1; ++x)
-				{
-					apen.put_value(color);
-					apen.inc_x();
-				}
-			}
+				Internal::fill_span(target_surface, y, x0, x1, color, opacity, blend_method);
     	}
 
 		wx0 += dx02;
@@ -182,14 +378,7 @@ software::Mesh::render_triangle(
 			if (x0 <  bounds.minx) x0 = bounds.minx;
 			if (x1 >= bounds.maxx) x1 = bounds.maxx-1;
 			if (x1 >= x0)
-			{
-				apen.move_to(x0, y);
-				for(int x = x0; x <= x1; ++x)
-				{
-					apen.put_value(color);
-					apen.inc_x();
-				}
-			}
+				Internal::fill_span(target_surface, y, x0, x1, color, opacity, blend_method);
     	}
 
 		wx0 += dx02_copy;
@@ -257,10 +446,6 @@ software::Mesh::render_triangle(
 	Vector tdx = matrix.get_transformed(Vector(1.0, 0.0), false);
 	//Vector tdy = matrix.get_transformed(Vector(0.0, 1.0), false);
 
-	synfig::Surface::alpha_pen apen(target_surface.get_pen(0, 0));
-	apen.set_alpha(opacity);
-	apen.set_blend_method(blend_method);
-
     // sort points
     if (ip0.y > ip1.y) std::swap(ip0, ip1);
     if (ip0.y > ip2.y) std::swap(ip0, ip2);
@@ -293,28 +478,10 @@ software::Mesh::render_triangle(
 			if (x0 <  bounds.minx) x0 = bounds.minx;
 			if (x1 >= bounds.maxx) x1 = bounds.maxx-1;
 			if (x1 >= x0)
-			{
-				apen.move_to(x0, y);
-				Vector tex_point = matrix.get_transformed(Vector(Real(x0), Real(y)));
-				for(int x = x0; x <= x1; ++x)
-				{
-					if (tex_point[0] < tex_bounds.minx || tex_point[0] > tex_bounds.maxx
-					 || tex_point[1] < tex_bounds.miny || tex_point[1] > tex_bounds.maxy)
-					{
-						apen.set_alpha(0.0);
-						apen.put_value(Color());
-					}
-					else
-					{
-						apen.set_alpha(opacity);
-						apen.put_value(texture.cubic_sample(tex_point[0], tex_point[1]));
-					}
-					// uncomment following line to debug
-					//apen.put_value(Color(0,0,1,0.5));
-					apen.inc_x();
-					tex_point += tdx;
-				}
-			}
+				Internal::texture_span(
+					target_surface, y, x0, x1,
+					matrix.get_transformed(Vector(Real(x0), Real(y))), tdx,
+					texture, tex_bounds, opacity, blend_method );
     	}
 
 		wx0 += dx02;
@@ -342,28 +509,10 @@ software::Mesh::render_triangle(
 			if (x0 <  bounds.minx) x0 = bounds.minx;
 			if (x1 >= bounds.maxx) x1 = bounds.maxx-1;
 			if (x1 >= x0)
-			{
-				apen.move_to(x0, y);
-				Vector tex_point = matrix.get_transformed(Vector(Real(x0), Real(y)));
-				for(int x = x0; x <= x1; ++x)
-				{
-					if (tex_point[0] < tex_bounds.minx || tex_point[0] > tex_bounds.maxx
-					 || tex_point[1] < tex_bounds.miny || tex_point[1] > tex_bounds.maxy)
-					{
-						apen.set_alpha(0.0);
-						apen.put_value(Color());
-					}
-					else
-					{
-						apen.set_alpha(opacity);
-						apen.put_value(texture.cubic_sample(tex_point[0], tex_point[1]));
-					}
-					// uncomment following line to debug
-					//apen.put_value(Color(1,0,0,0.5));
-					apen.inc_x();
-					tex_point += tdx;
-				}
-			}
+				Internal::texture_span(
+					target_surface, y, x0, x1,
+					matrix.get_transformed(Vector(Real(x0), Real(y))), tdx,
+					texture, tex_bounds, opacity, blend_method );
     	}
 
 		wx0 += dx02_copy;
@@ -393,19 +542,12 @@ software::Mesh::render_polygon(
 	if (vertices_strip <= 0) vertices_strip = sizeof(Vector);
 	if (triangles_strip <= 0) triangles_strip = sizeof(int[3]);
 
-	for(int i = 0; i < triangles_count; ++i)
-	{
-		int *triangle = (int*)((char*)triangles + i*triangles_strip);
-		render_triangle(
-			target_surface,
-			target_rect,
-			transform_matrix.get_transformed(*(Vector*)((char*)vertices + triangle[0]*vertices_strip)),
-			transform_matrix.get_transformed(*(Vector*)((char*)vertices + triangle[1]*vertices_strip)),
-			transform_matrix.get_transformed(*(Vector*)((char*)vertices + triangle[2]*vertices_strip)),
-			color,
-			opacity,
-			blend_method );
-	}
+	MeshRenderer renderer(target_surface, bounds, triangles, triangles_strip, triangles_count);
+	MeshRenderer::transform(renderer.vertices, vertices, vertices_strip, renderer.get_vertices_count(), transform_matrix);
+	renderer.color = color;
+	renderer.opacity = opacity;
+	renderer.blend_method = blend_method;
+	renderer.run();
 }
 
 void
@@ -471,23 +613,15 @@ software::Mesh::render_mesh(
 	if (tex_coords_strip <= 0) tex_coords_strip = sizeof(Vector);
 	if (triangles_strip <= 0) triangles_strip = sizeof(int[3]);
 
-	for(int i = 0; i < triangles_count; ++i)
-	{
-		int *triangle = (int*)((char*)triangles + i*triangles_strip);
-		render_triangle(
-			target_surface,
-			target_rect,
-			transform_matrix.get_transformed(*(Vector*)((char*)vertices + triangle[0]*vertices_strip)),
-			texture_matrix.get_transformed(*(Vector*)((char*)tex_coords + triangle[0]*tex_coords_strip)),
-			transform_matrix.get_transformed(*(Vector*)((char*)vertices + triangle[1]*vertices_strip)),
-			texture_matrix.get_transformed(*(Vector*)((char*)tex_coords + triangle[1]*tex_coords_strip)),
-			transform_matrix.get_transformed(*(Vector*)((char*)vertices + triangle[2]*vertices_strip)),
-			texture_matrix.get_transformed(*(Vector*)((char*)tex_coords + triangle[2]*tex_coords_strip)),
-			texture,
-			texture_rect,
-			opacity,
-			blend_method );
-	}
+	MeshRenderer renderer(target_surface, bounds, triangles, triangles_strip, triangles_count);
+	int vertices_count = renderer.get_vertices_count();
+	MeshRenderer::transform(renderer.vertices, vertices, vertices_strip, vertices_count, transform_matrix);
+	MeshRenderer::transform(renderer.tex_coords, tex_coords, tex_coords_strip, vertices_count, texture_matrix);
+	renderer.texture = &texture;
+	renderer.texture_rect = texture_rect;
+	renderer.opacity = opacity;
+	renderer.blend_method = blend_method;
+	renderer.run();
 }
 
 void
@@ -0,0 +1,154 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/mipmap.cpp
+**	\brief Mipmap
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cassert>
+
+#include "mipmap.h"
+
+#include "resample.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+	int count_levels(int size)
+	{
+		int count = 1;
+		while(software::Mipmap::reduce_size(size, count - 1) > 1)
+			++count;
+		return count;
+	}
+}
+
+/* === M E T H O D S ======================================================= */
+
+software::Mipmap::Mipmap():
+	surface(),
+	packed_surface(),
+	width(),
+	height(),
+	levels_x(),
+	levels_y()
+{ }
+
+void
+software::Mipmap::init(int width, int height)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (width > 0 && height > 0) {
+		this->width = width;
+		this->height = height;
+		levels_x = count_levels(width);
+		levels_y = count_levels(height);
+	} else {
+		this->width = this->height = 0;
+		levels_x = levels_y = 0;
+	}
+	// vector is never resized later, so returned levels keep their addresses
+	levels.clear();
+	levels.resize(levels_x*levels_y);
+}
+
+void
+software::Mipmap::clear()
+{
+	surface = NULL;
+	packed_surface = NULL;
+	init(0, 0);
+}
+
+void
+software::Mipmap::set_source(const synfig::Surface &surface)
+{
+	clear();
+	this->surface = &surface;
+	init(surface.get_w(), surface.get_h());
+}
+
+void
+software::Mipmap::set_source(const PackedSurface &surface)
+{
+	clear();
+	packed_surface = &surface;
+	init(surface.get_width(), surface.get_height());
+}
+
+const synfig::Surface&
+software::Mipmap::build_level(int lx, int ly) const
+{
+	assert(lx > 0 || ly > 0);
+	synfig::Surface &level = levels[ly*levels_x + lx];
+	if (level.is_valid())
+		return level;
+
+	// halve both sides of diagonal parent when possible, it's the shortest chain
+	int px = lx > 0 ? lx - 1 : lx;
+	int py = ly > 0 ? ly - 1 : ly;
+
+	VectorInt size = get_level_size(lx, ly);
+	VectorInt parent_size = get_level_size(px, py);
+	level.set_wh(size[0], size[1]);
+	level.clear();
+
+	if (px == 0 && py == 0) {
+		if (surface)
+			Resample::downscale(
+				level, RectInt(0, 0, size[0], size[1]),
+				*surface, RectInt(0, 0, parent_size[0], parent_size[1]) );
+		else
+			Resample::downscale(
+				level, RectInt(0, 0, size[0], size[1]),
+				*packed_surface, RectInt(0, 0, parent_size[0], parent_size[1]) );
+	} else {
+		Resample::downscale(
+			level, RectInt(0, 0, size[0], size[1]),
+			build_level(px, py), RectInt(0, 0, parent_size[0], parent_size[1]) );
+	}
+	return level;
+}
+
+const synfig::Surface&
+software::Mipmap::get_level(int lx, int ly) const
+{
+	assert(lx >= 0 && lx < levels_x && ly >= 0 && ly < levels_y);
+	std::lock_guard<std::mutex> lock(mutex);
+	return build_level(lx, ly);
+}
+
+/* === E N T R Y P O I N T ================================================= */
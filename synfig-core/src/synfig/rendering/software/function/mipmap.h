@@ -0,0 +1,118 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/mipmap.h
+**	\brief Mipmap Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SOFTWARE_MIPMAP_H
+#define __SYNFIG_RENDERING_SOFTWARE_MIPMAP_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include <synfig/rect.h>
+#include <synfig/surface.h>
+
+#include "packedsurface.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+namespace software
+{
+
+//! Pyramid of downscaled copies of source surface.
+//! Level (lx, ly) is source reduced 2^lx times by width and 2^ly times by height
+//! (rip-map, so anisotropic transformations may select different levels by axes).
+//! Level (0, 0) is the source itself, other levels are built by box filter
+//! on first request and kept until source is changed.
+//! Source is not copied, it should live longer than mipmap.
+class Mipmap
+{
+private:
+	const synfig::Surface *surface;
+	const PackedSurface *packed_surface;
+	int width;
+	int height;
+	int levels_x;
+	int levels_y;
+
+	mutable std::mutex mutex;
+	mutable std::vector<synfig::Surface> levels;
+
+	void init(int width, int height);
+	const synfig::Surface& build_level(int lx, int ly) const;
+
+	Mipmap(const Mipmap&) = delete;
+	Mipmap& operator=(const Mipmap&) = delete;
+
+public:
+	Mipmap();
+
+	void clear();
+	void set_source(const synfig::Surface &surface);
+	void set_source(const PackedSurface &surface);
+
+	const synfig::Surface* get_surface() const
+		{ return surface; }
+	const PackedSurface* get_packed_surface() const
+		{ return packed_surface; }
+
+	int get_width() const
+		{ return width; }
+	int get_height() const
+		{ return height; }
+	bool is_valid() const
+		{ return width > 0 && height > 0; }
+
+	//! Count of levels by width and by height, including level 0
+	int get_levels_x() const
+		{ return levels_x; }
+	int get_levels_y() const
+		{ return levels_y; }
+
+	static int reduce_size(int size, int level)
+		{ return std::max(1, (size + (1 << level) - 1) >> level); }
+	VectorInt get_level_size(int lx, int ly) const
+		{ return VectorInt(reduce_size(width, lx), reduce_size(height, ly)); }
+
+	//! Returns downscaled level, builds it if necessary, thread-safe.
+	//! Should not be called for level (0, 0), use source instead.
+	const synfig::Surface& get_level(int lx, int ly) const;
+};
+
+} /* end namespace software */
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -165,6 +165,11 @@ public:
 	void set_pixels(const Color *pixels, int width, int height, int pitch = 0);
 	int get_width() const { return width; }
 	int get_height() const { return height; }
+	//! size of packed pixel data in bytes
+	size_t get_memory_size() const { return data.size(); }
+	//! alpha of all pixels is one
+	bool is_opaque() const
+		{ return width > 0 && height > 0 && channels[3] < 0 && approximate_equal_lp(constant.get_a(), Color::value_type(1.0)); }
 	void get_pixels(Color *target) const;
 };
 
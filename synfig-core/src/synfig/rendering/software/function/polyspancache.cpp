@@ -0,0 +1,319 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/polyspancache.cpp
+**	\brief PolyspanCache
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "polyspancache.h"
+
+#include "contour.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+typedef std::shared_ptr<const Polyspan::cover_array> CoversHandle;
+
+inline void hash_combine(size_t &seed, Real x)
+	{ seed ^= std::hash<Real>()(x) + 0x9e3779b9 + (seed << 6) + (seed >> 2); }
+
+//! Everything except translation should be the same to reuse marks
+bool
+same_shape(const Matrix &a, const Matrix &b)
+{
+	return a.m00 == b.m00 && a.m01 == b.m01 && a.m02 == b.m02
+		&& a.m10 == b.m10 && a.m11 == b.m11 && a.m12 == b.m12
+		&& a.m22 == b.m22;
+}
+
+bool
+same_chunks(const rendering::Contour::ChunkList &a, const rendering::Contour::ChunkList &b)
+{
+	if (a.size() != b.size())
+		return false;
+	for(rendering::Contour::ChunkList::const_iterator i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j)
+		if ( i->type != j->type
+		  || i->p1[0]  != j->p1[0]  || i->p1[1]  != j->p1[1]
+		  || i->pp0[0] != j->pp0[0] || i->pp0[1] != j->pp0[1]
+		  || i->pp1[0] != j->pp1[0] || i->pp1[1] != j->pp1[1] )
+			return false;
+	return true;
+}
+
+//! Hash of contour and of transformation without translation,
+//! and bounds of transformed control points
+class Key
+{
+public:
+	size_t hash;
+	Rect bounds;
+
+	Key(const rendering::Contour::ChunkList &chunks, const Matrix &matrix, Real detail):
+		hash(chunks.size())
+	{
+		hash_combine(hash, detail);
+		for(int i = 0; i < 3; ++i)
+			for(int j = 0; j < 3; ++j)
+				if (i < 2 || j == 2) hash_combine(hash, matrix.m[i][j]);
+
+		bool first = true;
+		for(rendering::Contour::ChunkList::const_iterator i = chunks.begin(); i != chunks.end(); ++i)
+		{
+			hash_combine(hash, (Real)i->type);
+			const Vector *points[] = { &i->p1, &i->pp0, &i->pp1 };
+			for(int j = 0; j < 3; ++j)
+			{
+				hash_combine(hash, (*points[j])[0]);
+				hash_combine(hash, (*points[j])[1]);
+				Vector p = matrix.get_transformed(*points[j]);
+				if (first) bounds = Rect(p), first = false; else bounds.expand(p);
+			}
+		}
+	}
+
+	//! Is any part of contour may be clipped by window
+	bool clipped(const RectInt &window) const
+	{
+		// one pixel margin for cells touched by border points
+		return !( bounds.minx >= window.minx + 1 && bounds.maxx <= window.maxx - 1
+		       && bounds.miny >= window.miny + 1 && bounds.maxy <= window.maxy - 1 );
+	}
+};
+
+class Entry
+{
+public:
+	size_t hash;
+	rendering::Contour::ChunkList chunks;
+	Matrix matrix;
+	Real detail;
+	RectInt window;
+	bool clipped;
+	CoversHandle covers;
+
+	long long get_bytes() const
+	{
+		return sizeof(*this)
+		     + chunks.size()*sizeof(chunks.front())
+		     + covers->size()*sizeof(covers->front());
+	}
+};
+
+class Cache
+{
+public:
+	typedef std::list<Entry> List;
+	typedef std::unordered_multimap<size_t, List::iterator> Index;
+
+	std::mutex mutex;
+	List entries; // recently used first
+	Index index;
+	long long max_bytes;
+	long long bytes;
+
+	Cache():
+		max_bytes(software::PolyspanCache::default_max_bytes),
+		bytes()
+	{
+		if (const char *s = getenv("SYNFIG_RENDERING_POLYSPAN_CACHE_SIZE"))
+			max_bytes = std::max(0ll, atoll(s))*1024*1024;
+	}
+
+	void remove(List::iterator i)
+	{
+		std::pair<Index::iterator, Index::iterator> range = index.equal_range(i->hash);
+		for(Index::iterator j = range.first; j != range.second; ++j)
+			if (j->second == i) { index.erase(j); break; }
+		bytes -= i->get_bytes();
+		entries.erase(i);
+	}
+
+	void shrink()
+	{
+		while(bytes > max_bytes && !entries.empty())
+			remove(--entries.end());
+	}
+
+	void clear()
+	{
+		index.clear();
+		entries.clear();
+		bytes = 0;
+	}
+
+	//! Finds suitable marks and offset for them, moves found entry to the front
+	CoversHandle find(
+		const Key &key,
+		const rendering::Contour::ChunkList &chunks,
+		const Matrix &matrix,
+		const RectInt &window,
+		Real detail,
+		VectorInt &offset )
+	{
+		const Real precision = 1e-8;
+		bool clipped = key.clipped(window);
+
+		std::pair<Index::iterator, Index::iterator> range = index.equal_range(key.hash);
+		for(Index::iterator i = range.first; i != range.second; ++i)
+		{
+			const Entry &entry = *i->second;
+			if ( entry.detail != detail
+			  || !same_shape(entry.matrix, matrix)
+			  || !same_chunks(entry.chunks, chunks) )
+				continue;
+
+			Real dx = matrix.m20 - entry.matrix.m20;
+			Real dy = matrix.m21 - entry.matrix.m21;
+			if (dx == 0.0 && dy == 0.0 && window == entry.window)
+			{
+				offset = VectorInt();
+			}
+			else
+			{
+				// marks may be moved only when nothing was cut by window
+				if (clipped || entry.clipped)
+					continue;
+				offset = VectorInt((int)round(dx), (int)round(dy));
+				if (fabs(dx - offset[0]) > precision || fabs(dy - offset[1]) > precision)
+					continue;
+			}
+
+			entries.splice(entries.begin(), entries, i->second);
+			return entry.covers;
+		}
+		return CoversHandle();
+	}
+};
+
+// cache is never destroyed, because polyspans may be built
+// while other static objects are destroyed
+Cache& get_cache() {
+	static Cache *cache = new Cache();
+	return *cache;
+}
+
+} // end of anonymous namespace
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+void
+software::PolyspanCache::build_polyspan(
+	const rendering::Contour::ChunkList &chunks,
+	const Matrix &transform_matrix,
+	const RectInt &window,
+	Polyspan &out_polyspan,
+	Real detail )
+{
+	Cache &cache = get_cache();
+	Key key(chunks, transform_matrix, detail);
+
+	CoversHandle covers;
+	VectorInt offset;
+	bool enabled;
+	{
+		std::lock_guard<std::mutex> lock(cache.mutex);
+		enabled = cache.max_bytes > 0;
+		if (enabled)
+			covers = cache.find(key, chunks, transform_matrix, window, detail, offset);
+	}
+
+	if (covers)
+	{
+		out_polyspan.init(window, *covers, offset);
+		return;
+	}
+
+	out_polyspan.init(window);
+	software::Contour::build_polyspan(chunks, transform_matrix, out_polyspan, detail);
+	out_polyspan.close();
+	out_polyspan.sort_marks();
+	if (!enabled)
+		return;
+
+	Entry entry;
+	entry.hash = key.hash;
+	entry.chunks = chunks;
+	entry.matrix = transform_matrix;
+	entry.detail = detail;
+	entry.window = window;
+	entry.clipped = key.clipped(window);
+	entry.covers = CoversHandle(new Polyspan::cover_array(out_polyspan.get_covers()));
+	long long bytes = entry.get_bytes();
+
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	if (bytes > cache.max_bytes/4)
+		return;
+	cache.entries.push_front(entry);
+	cache.index.insert(Cache::Index::value_type(entry.hash, cache.entries.begin()));
+	cache.bytes += bytes;
+	cache.shrink();
+}
+
+long long
+software::PolyspanCache::get_max_bytes()
+{
+	Cache &cache = get_cache();
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	return cache.max_bytes;
+}
+
+void
+software::PolyspanCache::set_max_bytes(long long max_bytes)
+{
+	Cache &cache = get_cache();
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	cache.max_bytes = std::max(0ll, max_bytes);
+	cache.shrink();
+}
+
+void
+software::PolyspanCache::clear()
+{
+	Cache &cache = get_cache();
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	cache.clear();
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,83 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/function/polyspancache.h
+**	\brief PolyspanCache Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SOFTWARE_POLYSPANCACHE_H
+#define __SYNFIG_RENDERING_SOFTWARE_POLYSPANCACHE_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <synfig/matrix.h>
+#include <synfig/rect.h>
+
+#include "../../primitive/contour.h"
+#include "../../primitive/polyspan.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+namespace software
+{
+
+//! Keeps flattened and sorted contours (polyspans) between frames.
+//! Entries are keyed by contour chunks, transformation and detail.
+//! When unclipped contour is only moved by whole pixels,
+//! cached marks are reused with offset instead of new tessellation.
+class PolyspanCache
+{
+public:
+	//! default limit of memory used by cached marks
+	static const long long default_max_bytes = 64ll*1024*1024;
+
+	//! Fills \a out_polyspan by closed and sorted marks of contour,
+	//! takes them from cache or builds by software::Contour::build_polyspan()
+	static void build_polyspan(
+		const rendering::Contour::ChunkList &chunks,
+		const Matrix &transform_matrix,
+		const RectInt &window,
+		Polyspan &out_polyspan,
+		Real detail );
+
+	//! Limit of memory used by cache, zero disables cache.
+	//! Initial value is taken from environment variable SYNFIG_RENDERING_POLYSPAN_CACHE_SIZE (megabytes)
+	static long long get_max_bytes();
+	static void set_max_bytes(long long max_bytes);
+
+	//! Frees all cached polyspans
+	static void clear();
+};
+
+} /* end namespace software */
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
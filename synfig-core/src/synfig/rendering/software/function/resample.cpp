@@ -29,12 +29,17 @@
 #	include <config.h>
 #endif
 
+#include <cmath>
+
+#include <algorithm>
+
 #include <synfig/general.h>
 #include <synfig/localization.h>
 
 #include <synfig/debug/debugsurface.h>
 
 #include "resample.h"
+#include "mipmap.h"
 #include "../../primitive/transformationaffine.h"
 
 #endif
@@ -63,6 +68,53 @@ namespace {
 		struct MapPixelFull { int src; int dst; };
 		struct MapPixelPart { int src; int dst; ColorReal k0; ColorReal k1; };
 
+		//! how many times source should be reduced before sampling, by axes
+		static Vector get_reduction(const Matrix &transformation)
+		{
+			const Real threshold = 1.2;
+			synfig::rendering::Transformation::Bounds bounds =
+				TransformationAffine( transformation.get_inverted() )
+					.transform_bounds( Rect(0.0, 0.0, 1.0, 1.0), Vector(1.0, 1.0) );
+			return Vector(
+				1.0/(bounds.resolution[0]*threshold),
+				1.0/(bounds.resolution[1]*threshold) );
+		}
+
+		//! samples one or two mipmap levels (trilinear filtering),
+		//! coordinates are given in pixels of level 0
+		class MipmapSampler {
+		public:
+			typedef ColorAccumulator SamplerCookFunc(const void*, float, float);
+
+			struct Level {
+				const void *surface;
+				SamplerCookFunc *func;
+				Real kx, ky;
+				Level(): surface(), func(), kx(1.0), ky(1.0) { }
+				inline ColorAccumulator sample(Real x, Real y) const
+					{ return func(surface, (float)((x + 0.5)*kx - 0.5), (float)((y + 0.5)*ky - 0.5)); }
+			};
+
+			//! up to two levels by each axis, with weights of bilinear interpolation
+			Level levels[4];
+			ColorReal weights[4];
+			int count;
+
+			MipmapSampler(): weights(), count() { }
+
+			static Color sample(const void *sampler, const float x, const float y)
+			{
+				const MipmapSampler &s = *(const MipmapSampler*)sampler;
+				ColorAccumulator c = s.levels[0].sample(x, y);
+				if (s.count > 1) {
+					c = c*s.weights[0];
+					for(int i = 1; i < s.count; ++i)
+						c = c + s.levels[i].sample(x, y)*s.weights[i];
+				}
+				return ColorPrep::uncook_static(c);
+			}
+		};
+
 		template< Color reader(const void*,int,int),
 				ColorAccumulator reader_cook(const void*,int,int) >
 		class Generic {
@@ -169,9 +221,25 @@ namespace {
 						fill_cut<pen, sampler_func>(p, i);
 			}
 
+			static SamplerCookFunc* get_sampler_cook(Color::Interpolation interpolation)
+			{
+				switch(interpolation)
+				{
+				case Color::INTERPOLATION_COSINE:
+					return SamplerCook::cosine_sample;
+				case Color::INTERPOLATION_CUBIC:
+					return SamplerCook::cubic_sample;
+				default:
+					return SamplerCook::linear_sample;
+				}
+			}
+
 			template<typename pen>
-			static inline void fill(Color::Interpolation interpolation, bool cut, pen &p, Iterator &i)
+			static inline void fill(Color::Interpolation interpolation, bool cut, bool mipmap, pen &p, Iterator &i)
 			{
+				if (mipmap)
+					{ fill< pen, MipmapSampler::sample >(cut, true, p, i); return; }
+
 				bool no_transform =
 					approximate_equal(fabs(i.pos_dx[0]), 0.0)
 				&& approximate_equal(fabs(i.pos_dx[1]), 1.0)
@@ -205,7 +273,8 @@ namespace {
 				Color::Interpolation interpolation,
 				bool blend,
 				ColorReal blend_amount,
-				Color::BlendMethod blend_method )
+				Color::BlendMethod blend_method,
+				bool mipmap = false )
 			{
 				// bounds
 
@@ -288,10 +357,10 @@ namespace {
 						synfig::Surface::alpha_pen p(dest.get_pen(bounds.minx, bounds.miny));
 						p.set_blend_method(blend_method);
 						p.set_alpha(blend_amount);
-						fill(interpolation, cut, p, i);
+						fill(interpolation, cut, mipmap, p, i);
 					} else {
 						synfig::Surface::pen p(dest.get_pen(bounds.minx, bounds.miny));
-						fill(interpolation, cut, p, i);
+						fill(interpolation, cut, mipmap, p, i);
 					}
 				}
 			}
@@ -441,17 +510,12 @@ namespace {
 				Color::BlendMethod blend_method )
 			{
 				if (interpolation != Color::INTERPOLATION_NEAREST) {
-					const Real threshold = 1.2;
-
-					synfig::rendering::Transformation::Bounds bounds =
-						TransformationAffine( transformation.get_inverted() )
-							.transform_bounds( Rect(0.0, 0.0, 1.0, 1.0), Vector(1.0, 1.0) );
-					bounds.resolution *= threshold;
+					Vector reduction = get_reduction(transformation);
 
 					int sw = src_bounds.get_width();
 					int sh = src_bounds.get_height();
-					int w = std::min( sw, std::max(1, (int)ceil((Real)sw * bounds.resolution[0])) );
-					int h = std::min( sh, std::max(1, (int)ceil((Real)sh * bounds.resolution[1])) );
+					int w = std::min( sw, std::max(1, (int)ceil((Real)sw / reduction[0])) );
+					int h = std::min( sh, std::max(1, (int)ceil((Real)sh / reduction[1])) );
 
 					if (w < sw || h < sh) {
 						synfig::Surface new_src(w, h);
@@ -515,9 +579,10 @@ software::Resample::downscale(
 	bool keep_cooked )
 {
 	typedef software::PackedSurface::Reader Reader;
+	software::PackedSurface::Reader src_reader(src);
 	Helper::Generic<Reader::reader, Reader::reader_cook>::downscale(
 		dest, dest_bounds,
-		&src, src_bounds,
+		&src_reader, src_bounds,
 		keep_cooked );
 }
 
@@ -573,5 +638,111 @@ software::Resample::resample(
 		blend_method );
 }
 
+bool
+software::Resample::is_downscale(
+	const Matrix &transformation,
+	Color::Interpolation interpolation )
+{
+	if (interpolation == Color::INTERPOLATION_NEAREST)
+		return false;
+	Vector reduction = Helper::get_reduction(transformation);
+	return reduction[0] > 1.0 || reduction[1] > 1.0;
+}
+
+void
+software::Resample::resample(
+	synfig::Surface &dest,
+	const RectInt &dest_bounds,
+	const software::Mipmap &src,
+	const Matrix &transformation,
+	Color::Interpolation interpolation,
+	bool blend,
+	ColorReal blend_amount,
+	Color::BlendMethod blend_method )
+{
+	typedef synfig::Surface Surface;
+	typedef software::PackedSurface::Reader Reader;
+	typedef Helper::Generic<Surface::reader, Surface::reader_cook> GenericSurface;
+	typedef Helper::Generic<Reader::reader, Reader::reader_cook> GenericPacked;
+
+	if (!src.is_valid())
+		return;
+	RectInt src_bounds(0, 0, src.get_width(), src.get_height());
+
+	if (!is_downscale(transformation, interpolation)) {
+		if (src.get_surface())
+			resample(
+				dest, dest_bounds,
+				*src.get_surface(), src_bounds,
+				transformation, interpolation,
+				blend, blend_amount, blend_method );
+		else
+			resample(
+				dest, dest_bounds,
+				*src.get_packed_surface(), src_bounds,
+				transformation, interpolation,
+				blend, blend_amount, blend_method );
+		return;
+	}
+
+	// choose levels by axes (rip-map allows anisotropic reduction),
+	// and interpolate between two nearest levels by each axis separately,
+	// so reduction by one axis doesn't blur another one
+	Vector reduction = Helper::get_reduction(transformation);
+	Real fx = std::log2(std::max(Real(1.0), reduction[0]));
+	Real fy = std::log2(std::max(Real(1.0), reduction[1]));
+	int lx[2], ly[2];
+	lx[0] = std::min((int)fx, src.get_levels_x() - 1);
+	ly[0] = std::min((int)fy, src.get_levels_y() - 1);
+	lx[1] = std::min(lx[0] + 1, src.get_levels_x() - 1);
+	ly[1] = std::min(ly[0] + 1, src.get_levels_y() - 1);
+	Real kx[2], ky[2];
+	kx[1] = lx[1] > lx[0] ? fx - lx[0] : 0.0;
+	ky[1] = ly[1] > ly[0] ? fy - ly[0] : 0.0;
+	kx[0] = 1.0 - kx[1];
+	ky[0] = 1.0 - ky[1];
+
+	Helper::MipmapSampler sampler;
+	Reader reader;
+	for(int j = 0; j < 4; ++j) {
+		int jx = j % 2, jy = j / 2;
+		ColorReal weight = (ColorReal)(kx[jx]*ky[jy]);
+		if (approximate_equal_lp(weight, ColorReal(0)))
+			continue;
+
+		sampler.weights[sampler.count] = weight;
+		Helper::MipmapSampler::Level &level = sampler.levels[sampler.count++];
+		if (lx[jx] == 0 && ly[jy] == 0) {
+			if (src.get_surface()) {
+				level.surface = src.get_surface();
+				level.func = GenericSurface::get_sampler_cook(interpolation);
+			} else {
+				if (!reader.is_opened())
+					reader.open(*src.get_packed_surface());
+				level.surface = &reader;
+				level.func = GenericPacked::get_sampler_cook(interpolation);
+			}
+		} else {
+			VectorInt size = src.get_level_size(lx[jx], ly[jy]);
+			level.surface = &src.get_level(lx[jx], ly[jy]);
+			level.func = GenericSurface::get_sampler_cook(interpolation);
+			level.kx = (Real)size[0]/(Real)src.get_width();
+			level.ky = (Real)size[1]/(Real)src.get_height();
+		}
+	}
+
+	GenericSurface::resample(
+		dest,
+		dest_bounds,
+		&sampler,
+		src_bounds,
+		transformation,
+		interpolation,
+		blend,
+		blend_amount,
+		blend_method,
+		true );
+}
+
 
 /* === E N T R Y P O I N T ================================================= */
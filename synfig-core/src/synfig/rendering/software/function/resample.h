@@ -31,6 +31,7 @@
 #include <synfig/surface.h>
 
 #include "../surfaceswpacked.h"
+#include "mipmap.h"
 
 /* === M A C R O S ========================================================= */
 
@@ -83,6 +84,23 @@ public:
 		bool blend,
 		ColorReal blend_amount,
 		Color::BlendMethod blend_method );
+
+	//! Returns true when resample() reduces source before sampling,
+	//! so source may be sampled from mipmap instead
+	static bool is_downscale(
+		const Matrix &transformation,
+		Color::Interpolation interpolation );
+
+	//! Samples whole source from one or two nearest levels of mipmap
+	static void resample(
+		synfig::Surface &dest,
+		const RectInt &dest_bounds,
+		const software::Mipmap &src,
+		const Matrix &transformation,
+		Color::Interpolation interpolation,
+		bool blend,
+		ColorReal blend_amount,
+		Color::BlendMethod blend_method );
 };
 
 } /* end namespace software */
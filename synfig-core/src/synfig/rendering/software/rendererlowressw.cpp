@@ -35,14 +35,20 @@
 
 #include "task/tasksw.h"
 
+#include "surfaceswbyte.h"
+#include "surfaceswhalf.h"
+
 #include "../common/optimizer/optimizerblendassociative.h"
 #include "../common/optimizer/optimizerblendmerge.h"
 #include "../common/optimizer/optimizerblendtotarget.h"
 #include "../common/optimizer/optimizerdraft.h"
 #include "../common/optimizer/optimizerlist.h"
+#include "../common/optimizer/optimizerocclusion.h"
 #include "../common/optimizer/optimizersplit.h"
+#include "../common/optimizer/optimizersurfaceformat.h"
 #include "../common/optimizer/optimizertransformation.h"
 #include "../common/optimizer/optimizerpass.h"
+#include "../common/optimizer/optimizerpixelmerge.h"
 
 #endif
 
@@ -67,13 +73,16 @@ RendererLowResSW::RendererLowResSW(int level):
 	register_optimizer(new OptimizerTransformation());
 	register_optimizer(new OptimizerDraftTransformation());
 
+	register_optimizer(new OptimizerOcclusion());
+	register_optimizer(new OptimizerPixelMerge());
 	register_optimizer(new OptimizerPass(false));
 	register_optimizer(new OptimizerPass(true));
 	register_optimizer(new OptimizerBlendMerge());
 	register_optimizer(new OptimizerBlendToTarget());
 	register_optimizer(new OptimizerList());
 	register_optimizer(new OptimizerBlendAssociative());
-	//register_optimizer(new OptimizerSplit());
+	register_optimizer(new OptimizerSplit());
+	register_optimizer(new OptimizerSurfaceFormat(SurfaceSWByte::token.handle(), SurfaceSWHalf::token.handle()));
 }
 
 String RendererLowResSW::get_name() const
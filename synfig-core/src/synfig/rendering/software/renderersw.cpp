@@ -29,19 +29,26 @@
 #	include <config.h>
 #endif
 
+#include <cstdlib>
+
 #include <synfig/localization.h>
 
 #include "renderersw.h"
 
 #include  "task/tasksw.h"
 
+#include "surfaceswhalf.h"
+
 #include "../common/optimizer/optimizerblendassociative.h"
 #include "../common/optimizer/optimizerblendmerge.h"
 #include "../common/optimizer/optimizerblendtotarget.h"
 #include "../common/optimizer/optimizerlist.h"
+#include "../common/optimizer/optimizerocclusion.h"
 #include "../common/optimizer/optimizersplit.h"
+#include "../common/optimizer/optimizersurfaceformat.h"
 #include "../common/optimizer/optimizertransformation.h"
 #include "../common/optimizer/optimizerpass.h"
+#include "../common/optimizer/optimizerpixelmerge.h"
 
 #include "function/fft.h"
 
@@ -65,13 +72,21 @@ RendererSW::RendererSW()
 	// register optimizers
 	register_optimizer(new OptimizerTransformation());
 
+	register_optimizer(new OptimizerOcclusion());
+	register_optimizer(new OptimizerPixelMerge());
 	register_optimizer(new OptimizerPass(false));
 	register_optimizer(new OptimizerPass(true));
 	register_optimizer(new OptimizerBlendMerge());
 	register_optimizer(new OptimizerList());
 	register_optimizer(new OptimizerBlendToTarget());
 	register_optimizer(new OptimizerBlendAssociative());
-	//register_optimizer(new OptimizerSplit());
+	register_optimizer(new OptimizerSplit());
+
+	// half floats keep 11 bits of mantissa only, so final quality
+	// renderer uses them when explicitly allowed
+	if (const char *s = getenv("SYNFIG_RENDERING_HALF_INTERMEDIATES"))
+		if (atoi(s) != 0)
+			register_optimizer(new OptimizerSurfaceFormat(SurfaceSWHalf::token.handle()));
 }
 
 RendererSW::~RendererSW() { }
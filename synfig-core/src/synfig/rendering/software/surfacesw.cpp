@@ -30,6 +30,7 @@
 #endif
 
 #include "surfacesw.h"
+#include "surfaceswpool.h"
 
 #endif
 
@@ -51,12 +52,16 @@ rendering::Surface::Token SurfaceSW::token(
 
 SurfaceSW::SurfaceSW():
 	own_surface(true),
-	surface(new synfig::Surface())
+	surface(new synfig::Surface()),
+	pool_buffer(),
+	pool_buffer_capacity()
 { }
 
 SurfaceSW::SurfaceSW(synfig::Surface &surface, bool own_surface):
 	own_surface(own_surface),
-	surface(&surface)
+	surface(&surface),
+	pool_buffer(),
+	pool_buffer_capacity()
 {
 	assert(this->surface);
 	set_desc(this->surface->get_w(), this->surface->get_h(), false);
@@ -68,14 +73,46 @@ SurfaceSW::~SurfaceSW()
 	if (own_surface)
 		{ assert(surface); delete surface; }
 	surface = NULL;
+	release_pool_buffer();
 	set_desc(0, 0, true);
 }
 
+void
+SurfaceSW::set_wh(int width, int height)
+{
+	assert(surface);
+
+	// take buffer from pool only for own surface,
+	// otherwise buffer may be used after release
+	Color *prev_buffer = pool_buffer;
+	size_t prev_capacity = pool_buffer_capacity;
+	pool_buffer = NULL;
+	pool_buffer_capacity = 0;
+	if (own_surface && width > 0 && height > 0)
+		pool_buffer = SurfaceSWPool::alloc((size_t)width*height, pool_buffer_capacity);
+
+	if (pool_buffer)
+		surface->set_wh(width, height, (unsigned char*)pool_buffer, width*(int)sizeof(Color));
+	else
+		surface->set_wh(width, height);
+
+	// surface don't refer to the previous buffer anymore
+	SurfaceSWPool::release(prev_buffer, prev_capacity);
+}
+
+void
+SurfaceSW::release_pool_buffer()
+{
+	SurfaceSWPool::release(pool_buffer, pool_buffer_capacity);
+	pool_buffer = NULL;
+	pool_buffer_capacity = 0;
+}
+
 bool
 SurfaceSW::create_vfunc(int width, int height)
 {
 	assert(surface);
-	surface->set_wh(width, height);
+	set_wh(width, height);
 	surface->clear();
 	return true;
 }
@@ -84,10 +121,10 @@ bool
 SurfaceSW::assign_vfunc(const rendering::Surface &surface)
 {
 	assert(this->surface);
-	this->surface->set_wh(surface.get_width(), surface.get_height());
+	set_wh(surface.get_width(), surface.get_height());
 	if (surface.get_pixels(&(*this->surface)[0][0]))
 		return true;
-	this->surface->set_wh(0, 0);
+	set_wh(0, 0);
 	set_desc(0, 0, true);
 	return false;
 }
@@ -104,7 +141,7 @@ bool
 SurfaceSW::reset_vfunc()
 {
 	assert(surface);
-	surface->set_wh(0, 0);
+	set_wh(0, 0);
 	return true;
 }
 
@@ -128,8 +165,10 @@ SurfaceSW::set_surface(synfig::Surface &surface, bool own_surface)
 		assert(this->surface);
 		delete(this->surface);
 	}
+	release_pool_buffer();
 
 	this->surface = &surface;
+	this->own_surface = own_surface;
 	assert(this->surface);
 	set_desc(surface.get_w(), surface.get_h(), false);
 	assert((int)this->surface->get_pitch() == (int)sizeof(Color)*get_width());
@@ -142,6 +181,7 @@ SurfaceSW::reset_surface()
 		assert(surface);
 		delete(surface);
 	}
+	release_pool_buffer();
 	own_surface = true;
 	surface = new synfig::Surface();
 	set_desc(0, 0, true);
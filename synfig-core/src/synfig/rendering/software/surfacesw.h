@@ -54,6 +54,11 @@ public:
 private:
 	bool own_surface;
 	synfig::Surface *surface;
+	Color *pool_buffer;
+	size_t pool_buffer_capacity;
+
+	void set_wh(int width, int height);
+	void release_pool_buffer();
 
 protected:
 	virtual bool create_vfunc(int width, int height);
@@ -0,0 +1,144 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfaceswbyte.cpp
+**	\brief SurfaceSWByte
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+
+#include "surfaceswbyte.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+	inline bool check_range(ColorReal x)
+		{ return x >= 0.f && x <= 1.f; } // also fails for NaN
+
+	inline uint8_t pack(ColorReal x)
+		{ return (uint8_t)(int)(x*255.f + 0.5f); }
+}
+
+/* === M E T H O D S ======================================================= */
+
+
+rendering::Surface::Token SurfaceSWByte::token(
+	Desc<SurfaceSWByte>("SurfaceSWByte") );
+
+
+bool
+SurfaceSWByte::create_vfunc(int width, int height)
+{
+	data.clear();
+	data.resize(4*(size_t)width*height, 0);
+	return true;
+}
+
+bool
+SurfaceSWByte::assign_vfunc(const rendering::Surface &surface)
+{
+	size_t count = (size_t)surface.get_pixels_count();
+	std::vector<Color> buffer;
+	const Color *pixels = surface.get_pixels_pointer();
+	if (!pixels) {
+		buffer.resize(count);
+		if (!surface.get_pixels(&buffer.front()))
+			return false;
+		pixels = &buffer.front();
+	}
+
+	data.resize(4*count);
+	uint8_t *d = &data.front();
+	for(const Color *c = pixels, *end = c + count; c < end; ++c, d += 4) {
+		ColorReal a = c->get_a();
+		if ( !check_range(a)
+		  || !check_range(c->get_r())
+		  || !check_range(c->get_g())
+		  || !check_range(c->get_b()) )
+			{ data.clear(); return false; }
+		d[3] = pack(a);
+		if (!d[3]) {
+			// color of transparent pixel will be lost
+			if (c->get_r() || c->get_g() || c->get_b())
+				{ data.clear(); return false; }
+			d[0] = d[1] = d[2] = 0;
+			continue;
+		}
+		d[0] = pack(c->get_r()*a);
+		d[1] = pack(c->get_g()*a);
+		d[2] = pack(c->get_b()*a);
+	}
+	return true;
+}
+
+bool
+SurfaceSWByte::clear_vfunc()
+{
+	std::fill(data.begin(), data.end(), 0);
+	return true;
+}
+
+bool
+SurfaceSWByte::reset_vfunc()
+{
+	std::vector<uint8_t>().swap(data);
+	return true;
+}
+
+bool
+SurfaceSWByte::get_pixels_vfunc(Color *buffer) const
+{
+	const uint8_t *s = get_data();
+	if (!s) return false;
+
+	ColorReal to_float[256];
+	for(int i = 0; i < 256; ++i)
+		to_float[i] = ColorReal(i)/ColorReal(255);
+
+	for(Color *c = buffer, *end = c + data.size()/4; c < end; ++c, s += 4) {
+		if (!s[3]) { *c = Color(); continue; }
+		ColorReal k = ColorReal(1)/ColorReal(s[3]);
+		*c = Color(
+			std::min(ColorReal(1), ColorReal(s[0])*k),
+			std::min(ColorReal(1), ColorReal(s[1])*k),
+			std::min(ColorReal(1), ColorReal(s[2])*k),
+			to_float[s[3]] );
+	}
+	return true;
+}
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,177 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfaceswhalf.cpp
+**	\brief SurfaceSWHalf
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cstring>
+
+#include <algorithm>
+
+#include "surfaceswhalf.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+namespace {
+	inline uint32_t float_bits(float x)
+		{ uint32_t b; memcpy(&b, &x, sizeof(b)); return b; }
+	inline float bits_float(uint32_t b)
+		{ float x; memcpy(&x, &b, sizeof(x)); return x; }
+
+	inline bool check_range(const Color &c)
+	{
+		// also fails for NaN
+		const ColorReal m = SurfaceSWHalf::max_value;
+		return c.get_r() >= -m && c.get_r() <= m
+		    && c.get_g() >= -m && c.get_g() <= m
+		    && c.get_b() >= -m && c.get_b() <= m
+		    && c.get_a() >= -m && c.get_a() <= m;
+	}
+}
+
+/* === M E T H O D S ======================================================= */
+
+
+rendering::Surface::Token SurfaceSWHalf::token(
+	Desc<SurfaceSWHalf>("SurfaceSWHalf") );
+
+const ColorReal SurfaceSWHalf::max_value = 65504.f;
+
+
+uint16_t
+SurfaceSWHalf::pack(float x)
+{
+	// round to nearest even, values should be in range [-max_value, max_value]
+	uint32_t b = float_bits(x);
+	uint32_t sign = (b >> 16) & 0x8000u;
+	uint32_t abs = b & 0x7fffffffu;
+
+	if (abs >= 0x477ff000u) // out of range, infinity or NaN
+		return (uint16_t)(sign | (abs > 0x7f800000u ? 0x7e00u : 0x7c00u));
+
+	if (abs < 0x38800000u) { // subnormal
+		if (abs < 0x33000000u) return (uint16_t)sign;
+		uint32_t mantissa = (abs & 0x7fffffu) | 0x800000u;
+		int shift = 126 - (int)(abs >> 23);
+		uint32_t h = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t half = 1u << (shift - 1);
+		if (rest > half || (rest == half && (h & 1u))) ++h;
+		return (uint16_t)(sign | h);
+	}
+
+	uint32_t h = (abs - 0x38000000u) >> 13;
+	uint32_t rest = abs & 0x1fffu;
+	if (rest > 0x1000u || (rest == 0x1000u && (h & 1u))) ++h;
+	return (uint16_t)(sign | h);
+}
+
+float
+SurfaceSWHalf::unpack(uint16_t x)
+{
+	uint32_t sign = (uint32_t)(x & 0x8000u) << 16;
+	uint32_t exponent = (x >> 10) & 0x1fu;
+	uint32_t mantissa = x & 0x3ffu;
+	if (exponent == 0) {
+		float f = (float)mantissa*(1.f/16777216.f);
+		return sign ? -f : f;
+	}
+	if (exponent == 0x1fu)
+		return bits_float(sign | 0x7f800000u | (mantissa << 13));
+	return bits_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+bool
+SurfaceSWHalf::create_vfunc(int width, int height)
+{
+	data.clear();
+	data.resize(4*(size_t)width*height, 0);
+	return true;
+}
+
+bool
+SurfaceSWHalf::assign_vfunc(const rendering::Surface &surface)
+{
+	size_t count = (size_t)surface.get_pixels_count();
+	std::vector<Color> buffer;
+	const Color *pixels = surface.get_pixels_pointer();
+	if (!pixels) {
+		buffer.resize(count);
+		if (!surface.get_pixels(&buffer.front()))
+			return false;
+		pixels = &buffer.front();
+	}
+
+	data.resize(4*count);
+	uint16_t *d = &data.front();
+	for(const Color *c = pixels, *end = c + count; c < end; ++c, d += 4) {
+		if (!check_range(*c))
+			{ data.clear(); return false; }
+		d[0] = pack(c->get_r());
+		d[1] = pack(c->get_g());
+		d[2] = pack(c->get_b());
+		d[3] = pack(c->get_a());
+	}
+	return true;
+}
+
+bool
+SurfaceSWHalf::clear_vfunc()
+{
+	std::fill(data.begin(), data.end(), 0);
+	return true;
+}
+
+bool
+SurfaceSWHalf::reset_vfunc()
+{
+	std::vector<uint16_t>().swap(data);
+	return true;
+}
+
+bool
+SurfaceSWHalf::get_pixels_vfunc(Color *buffer) const
+{
+	const uint16_t *s = get_data();
+	if (!s) return false;
+	for(Color *c = buffer, *end = c + data.size()/4; c < end; ++c, s += 4)
+		*c = Color(unpack(s[0]), unpack(s[1]), unpack(s[2]), unpack(s[3]));
+	return true;
+}
+
+/* === E N T R Y P O I N T ================================================= */
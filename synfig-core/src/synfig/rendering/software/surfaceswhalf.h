@@ -0,0 +1,88 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfaceswhalf.h
+**	\brief SurfaceSWHalf Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SURFACESWHALF_H
+#define __SYNFIG_RENDERING_SURFACESWHALF_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <cstdint>
+#include <vector>
+
+#include "../surface.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Storage of pixels as four 16-bit floats (RGBA16F, straight alpha like synfig::Color),
+//! half size of SurfaceSW. Values out of range of 16-bit float cannot be assigned,
+//! values in range are rounded to 11 significant bits.
+class SurfaceSWHalf: public Surface
+{
+public:
+	typedef etl::handle<SurfaceSWHalf> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const
+		{ return token.handle(); }
+
+	//! max absolute value which can be stored
+	static const ColorReal max_value;
+
+protected:
+	virtual bool create_vfunc(int width, int height);
+	virtual bool assign_vfunc(const Surface &surface);
+	virtual bool clear_vfunc();
+	virtual bool reset_vfunc();
+	virtual bool get_pixels_vfunc(Color *buffer) const;
+
+private:
+	std::vector<uint16_t> data;
+
+public:
+	static uint16_t pack(float x);
+	static float unpack(uint16_t x);
+
+	SurfaceSWHalf()
+		{ }
+	explicit SurfaceSWHalf(const Surface &other)
+		{ assign(other); }
+
+	const uint16_t* get_data() const
+		{ return data.empty() ? NULL : &data.front(); }
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,104 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfaceswmipmap.cpp
+**	\brief SurfaceSWMipmap
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include "surfaceswmipmap.h"
+
+#include "surfacesw.h"
+#include "surfaceswpacked.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+
+rendering::Surface::Token SurfaceSWMipmap::token(
+	Desc<SurfaceSWMipmap>("SurfaceSWMipmap") );
+
+
+bool
+SurfaceSWMipmap::create_vfunc(int width, int height)
+{
+	SurfaceSW::Handle surface = new SurfaceSW();
+	if (!surface->create(width, height))
+		return false;
+	mipmap.set_source(surface->get_surface());
+	source = surface;
+	return true;
+}
+
+bool
+SurfaceSWMipmap::assign_vfunc(const rendering::Surface &surface)
+{
+	// refer to surfaces owned by handles (i.e. stored in SurfaceResource),
+	// temporary surfaces are copied
+	if (surface.count() > 0) {
+		if (const SurfaceSW *surface_sw = dynamic_cast<const SurfaceSW*>(&surface)) {
+			source = surface_sw;
+			mipmap.set_source(surface_sw->get_surface());
+			return true;
+		}
+		if (const SurfaceSWPacked *surface_packed = dynamic_cast<const SurfaceSWPacked*>(&surface)) {
+			source = surface_packed;
+			mipmap.set_source(surface_packed->get_surface());
+			return true;
+		}
+	}
+
+	SurfaceSW::Handle copy = new SurfaceSW();
+	if (!copy->assign(surface))
+		return false;
+	mipmap.set_source(copy->get_surface());
+	source = copy;
+	return true;
+}
+
+bool
+SurfaceSWMipmap::reset_vfunc()
+{
+	mipmap.clear();
+	source.reset();
+	return true;
+}
+
+bool
+SurfaceSWMipmap::get_pixels_vfunc(Color *buffer) const
+	{ return source && source->get_pixels(buffer); }
+
+/* === E N T R Y P O I N T ================================================= */
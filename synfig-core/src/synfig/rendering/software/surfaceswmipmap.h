@@ -0,0 +1,80 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfaceswmipmap.h
+**	\brief SurfaceSWMipmap Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SURFACESWMIPMAP_H
+#define __SYNFIG_RENDERING_SURFACESWMIPMAP_H
+
+/* === H E A D E R S ======================================================= */
+
+#include "../surface.h"
+
+#include "function/mipmap.h"
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Read-only surface with lazily built mipmap of the source.
+//! Being converted inside of SurfaceResource it refers to the source
+//! surface of the resource instead of copying it,
+//! and lives until resource will be changed, so mipmap levels
+//! are shared between frames and threads.
+class SurfaceSWMipmap: public Surface
+{
+public:
+	typedef etl::handle<SurfaceSWMipmap> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const
+		{ return token.handle(); }
+
+protected:
+	virtual bool create_vfunc(int width, int height);
+	virtual bool assign_vfunc(const Surface &surface);
+	virtual bool reset_vfunc();
+	virtual bool get_pixels_vfunc(Color *buffer) const;
+
+private:
+	etl::handle<const Surface> source;
+	software::Mipmap mipmap;
+
+public:
+	SurfaceSWMipmap()
+		{ }
+	const software::Mipmap& get_mipmap() const
+		{ return mipmap; }
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
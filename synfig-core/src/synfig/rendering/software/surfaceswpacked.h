@@ -63,6 +63,8 @@ public:
 		{ }
 	explicit SurfaceSWPacked(const Surface &other)
 		{ assign(other); }
+	virtual bool is_opaque() const
+		{ return surface.is_opaque(); }
 	const software::PackedSurface& get_surface() const
 		{ return surface; }
 };
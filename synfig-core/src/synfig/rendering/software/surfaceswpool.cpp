@@ -0,0 +1,213 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfaceswpool.cpp
+**	\brief SurfaceSWPool
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "surfaceswpool.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+namespace {
+
+class Pool
+{
+public:
+	enum { shards_count = 8 };
+
+	struct Shard
+	{
+		std::mutex mutex;
+		std::map<size_t, std::vector<char*> > buffers; // by capacity
+	};
+
+	Shard shards[shards_count];
+
+	std::atomic<long long> max_bytes;
+	std::atomic<long long> hits;
+	std::atomic<long long> misses;
+	std::atomic<long long> used_bytes;
+	std::atomic<long long> free_bytes;
+	std::atomic<long long> peak_bytes;
+
+	Pool():
+		max_bytes(SurfaceSWPool::default_max_bytes),
+		hits(), misses(), used_bytes(), free_bytes(), peak_bytes()
+	{
+		if (const char *s = getenv("SYNFIG_RENDERING_SURFACE_POOL_SIZE"))
+			max_bytes = std::max(0ll, atoll(s))*1024*1024;
+	}
+
+	Shard& current_shard()
+		{ return shards[ std::hash<std::thread::id>()(std::this_thread::get_id()) % shards_count ]; }
+
+	void update_peak() {
+		long long bytes = used_bytes + free_bytes;
+		long long peak = peak_bytes;
+		while(peak < bytes && !peak_bytes.compare_exchange_weak(peak, bytes)) { }
+	}
+
+	static char* take(Shard &shard, size_t capacity) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		std::map<size_t, std::vector<char*> >::iterator i = shard.buffers.find(capacity);
+		if (i == shard.buffers.end() || i->second.empty())
+			return NULL;
+		char *buffer = i->second.back();
+		i->second.pop_back();
+		return buffer;
+	}
+
+	void clear() {
+		for(int i = 0; i < shards_count; ++i) {
+			std::lock_guard<std::mutex> lock(shards[i].mutex);
+			for(std::map<size_t, std::vector<char*> >::iterator j = shards[i].buffers.begin(); j != shards[i].buffers.end(); ++j)
+				for(std::vector<char*>::iterator k = j->second.begin(); k != j->second.end(); ++k) {
+					delete[] *k;
+					free_bytes -= j->first;
+				}
+			shards[i].buffers.clear();
+		}
+	}
+};
+
+// pool is never destroyed, because surfaces may be released
+// by destructors of other static objects
+Pool& get_pool() {
+	static Pool *pool = new Pool();
+	return *pool;
+}
+
+//! rounds size up to one of 4*2^n, 5*2^n, 6*2^n, 7*2^n,
+//! so at most 25% of buffer may be unused
+size_t
+size_class(size_t size) {
+	size_t step = 1;
+	while(size > 8*step) step *= 2;
+	return (size + step - 1)/step*step;
+}
+
+} // end of anonymous namespace
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+Color*
+SurfaceSWPool::alloc(size_t count, size_t &capacity)
+{
+	capacity = 0;
+	size_t bytes = count*sizeof(Color);
+	Pool &pool = get_pool();
+	if (bytes < min_bytes || pool.max_bytes <= 0)
+		return NULL;
+
+	capacity = size_class(bytes);
+
+	// look into shard of current thread first
+	Pool::Shard &current = pool.current_shard();
+	char *buffer = Pool::take(current, capacity);
+	for(int i = 0; !buffer && i < Pool::shards_count; ++i)
+		if (&pool.shards[i] != &current)
+			buffer = Pool::take(pool.shards[i], capacity);
+
+	if (buffer) {
+		++pool.hits;
+		pool.free_bytes -= capacity;
+		pool.used_bytes += capacity;
+	} else {
+		++pool.misses;
+		buffer = new char[capacity];
+		pool.used_bytes += capacity;
+		pool.update_peak();
+	}
+	return (Color*)buffer;
+}
+
+void
+SurfaceSWPool::release(Color *buffer, size_t capacity)
+{
+	if (!buffer) return;
+	Pool &pool = get_pool();
+	pool.used_bytes -= capacity;
+
+	if (pool.free_bytes + (long long)capacity > pool.max_bytes)
+		{ delete[] (char*)buffer; return; }
+
+	Pool::Shard &shard = pool.current_shard();
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	shard.buffers[capacity].push_back((char*)buffer);
+	pool.free_bytes += capacity;
+}
+
+long long
+SurfaceSWPool::get_max_bytes()
+	{ return get_pool().max_bytes; }
+
+void
+SurfaceSWPool::set_max_bytes(long long max_bytes)
+{
+	Pool &pool = get_pool();
+	pool.max_bytes = std::max(0ll, max_bytes);
+	if (pool.free_bytes > pool.max_bytes)
+		pool.clear();
+}
+
+SurfaceSWPool::Stats
+SurfaceSWPool::get_stats()
+{
+	Pool &pool = get_pool();
+	Stats stats;
+	stats.hits       = pool.hits;
+	stats.misses     = pool.misses;
+	stats.used_bytes = pool.used_bytes;
+	stats.free_bytes = pool.free_bytes;
+	stats.peak_bytes = pool.peak_bytes;
+	return stats;
+}
+
+void
+SurfaceSWPool::clear()
+	{ get_pool().clear(); }
+
+/* === E N T R Y P O I N T ================================================= */
@@ -0,0 +1,89 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/surfaceswpool.h
+**	\brief SurfaceSWPool Header
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === S T A R T =========================================================== */
+
+#ifndef __SYNFIG_RENDERING_SURFACESWPOOL_H
+#define __SYNFIG_RENDERING_SURFACESWPOOL_H
+
+/* === H E A D E R S ======================================================= */
+
+#include <cstddef>
+
+#include <synfig/color.h>
+
+/* === M A C R O S ========================================================= */
+
+/* === T Y P E D E F S ===================================================== */
+
+/* === C L A S S E S & S T R U C T S ======================================= */
+
+namespace synfig
+{
+namespace rendering
+{
+
+//! Pool of pixel buffers for SurfaceSW.
+//! Buffers are grouped by size classes (four classes per power of two),
+//! released buffers are kept and reused by the next surfaces of the same class.
+//! Pool is split into shards selected by thread, so threads
+//! mostly don't wait each other.
+class SurfaceSWPool
+{
+public:
+	struct Stats
+	{
+		long long hits;        //!< buffers taken from pool
+		long long misses;      //!< buffers allocated by system
+		long long used_bytes;  //!< bytes in buffers which are in use now
+		long long free_bytes;  //!< bytes in buffers kept by pool
+		long long peak_bytes;  //!< maximum of used_bytes + free_bytes
+		Stats(): hits(), misses(), used_bytes(), free_bytes(), peak_bytes() { }
+	};
+
+	//! smaller buffers are not pooled
+	static const size_t min_bytes = 16*1024;
+	//! default limit of memory kept by pool in free buffers
+	static const long long default_max_bytes = 512ll*1024*1024;
+
+	//! Returns buffer for \a count pixels, \a capacity receives size of buffer in bytes.
+	//! Returns NULL when pool is disabled or buffer is too small for pool.
+	static Color* alloc(size_t count, size_t &capacity);
+	//! Returns buffer to pool, \a capacity should be the same as returned by alloc()
+	static void release(Color *buffer, size_t capacity);
+
+	//! Limit of memory kept by pool in free buffers, zero disables pool.
+	//! Initial value is taken from environment variable SYNFIG_RENDERING_SURFACE_POOL_SIZE (megabytes)
+	static long long get_max_bytes();
+	static void set_max_bytes(long long max_bytes);
+
+	static Stats get_stats();
+	//! Frees all pooled buffers
+	static void clear();
+};
+
+} /* end namespace rendering */
+} /* end namespace synfig */
+
+/* -- E N D ----------------------------------------------------------------- */
+
+#endif
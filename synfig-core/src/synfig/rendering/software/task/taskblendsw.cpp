@@ -34,6 +34,7 @@
 #include <synfig/debug/debugsurface.h>
 
 #include "../../common/task/taskblend.h"
+#include "../function/blend.h"
 #include "tasksw.h"
 
 #endif
@@ -130,15 +131,19 @@ public:
 					assert( 0 <= rb.minx + ob[0] && rb.maxx + ob[0] <= b.get_w()
 						 && 0 <= rb.miny + ob[1] && rb.maxy + ob[1] <= b.get_h() );
 
-					synfig::Surface::alpha_pen ap(c.get_pen(rb.minx, rb.miny));
-					ap.set_blend_method(blend_method);
-					ap.set_alpha(amount);
-					b.blit_to(
-						ap,
-						rb.minx + ob[0],
-						rb.miny + ob[1],
-						rb.maxx - rb.minx,
-						rb.maxy - rb.miny );
+					if (software::Blend::is_vectorized(blend_method)) {
+						software::Blend::blend(c, rb.get_min(), b, rb + ob, amount, blend_method);
+					} else {
+						synfig::Surface::alpha_pen ap(c.get_pen(rb.minx, rb.miny));
+						ap.set_blend_method(blend_method);
+						ap.set_alpha(amount);
+						b.blit_to(
+							ap,
+							rb.minx + ob[0],
+							rb.miny + ob[1],
+							rb.maxx - rb.minx,
+							rb.maxy - rb.miny );
+					}
 
 					if (ra.is_valid())
 					{
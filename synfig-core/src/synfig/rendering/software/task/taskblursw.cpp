@@ -51,18 +51,29 @@ using namespace rendering;
 
 namespace {
 
-class TaskBlurSW: public TaskBlur, public TaskSW, public TaskInterfaceBlendToTarget
+class TaskBlurSW: public TaskBlur, public TaskSW,
+	public TaskInterfaceBlendToTarget,
+	public TaskInterfaceSplit
 {
 public:
 	typedef etl::handle<TaskBlurSW> Handle;
 	static Token token;
 	virtual Token::Handle get_token() const { return token.handle(); }
 
+	static const int max_split_extra_rows = 32;
+
 	virtual int get_target_subtask_index() const
 		{ return 1; }
 	virtual Color::BlendMethodFlags get_supported_blend_methods() const
 		{ return Color::BLEND_METHODS_ALL & ~Color::BLEND_METHODS_STRAIGHT; }
 
+	//! each band reads extra rows around self, so don't split large blurs
+	virtual bool is_splittable() const {
+		if (!is_valid_coords()) return false;
+		Vector s = blur.size.multiply_coords(get_pixels_per_unit());
+		return software::Blur::get_extra_size(blur.type, s)[1] <= max_split_extra_rows;
+	}
+
 	virtual bool run(RunParams&) const {
 		if (!is_valid() || !sub_task() || !sub_task()->is_valid())
 			return true;
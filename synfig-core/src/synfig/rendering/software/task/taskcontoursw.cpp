@@ -36,6 +36,7 @@
 #include "../../common/task/taskblend.h"
 #include "tasksw.h"
 #include "../function/contour.h"
+#include "../function/polyspancache.h"
 
 #endif
 
@@ -93,10 +94,7 @@ public:
 		Matrix matrix = bounds_transfromation * transformation->matrix;
 
 		Polyspan polyspan;
-		polyspan.init(target_rect);
-		software::Contour::build_polyspan(contour->get_chunks(), matrix, polyspan, detail);
-		polyspan.close();
-		polyspan.sort_marks();
+		software::PolyspanCache::build_polyspan(contour->get_chunks(), matrix, target_rect, polyspan, detail);
 
 		LockWrite la(this);
 		if (!la)
@@ -0,0 +1,249 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file synfig/rendering/software/task/taskpixelchainsw.cpp
+**	\brief TaskPixelChainSW
+**
+**	$Id$
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+/* === H E A D E R S ======================================================= */
+
+#ifdef USING_PCH
+#	include "pch.h"
+#else
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <vector>
+
+#include <synfig/general.h>
+
+#include "../../common/task/taskpixelprocessor.h"
+#include "tasksw.h"
+
+#endif
+
+using namespace synfig;
+using namespace rendering;
+
+/* === M A C R O S ========================================================= */
+
+/* === G L O B A L S ======================================================= */
+
+/* === P R O C E D U R E S ================================================= */
+
+/* === M E T H O D S ======================================================= */
+
+namespace {
+
+class TaskPixelChainSW: public TaskPixelChain, public TaskSW
+{
+public:
+	typedef etl::handle<TaskPixelChainSW> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+private:
+	//! pixels processed by all steps while they are in cache
+	enum { CHUNK_SIZE = 256 };
+
+	//! gamma correction of one channel, same as in TaskPixelGammaSW,
+	//! values in range [0, 1] are taken from lookup table
+	class GammaChannel {
+	public:
+		enum { TABLE_SIZE = 4096, TABLE_MIN = 16 };
+
+	private:
+		ColorReal gamma;
+		bool copy;
+		bool one;
+		std::vector<ColorReal> table;
+
+		static inline ColorReal clamp(const ColorReal &x)
+		{
+			const ColorReal max = ColorReal(1.0)/real_low_precision<ColorReal>();
+			return std::max(-max, std::min(max, x));
+		}
+
+		static inline ColorReal clamp_positive(const ColorReal &x)
+		{
+			const ColorReal max = ColorReal(1.0)/real_low_precision<ColorReal>();
+			return std::max(real_low_precision<ColorReal>(), std::min(max, x));
+		}
+
+		inline ColorReal pow(const ColorReal &x) const
+			{ return clamp(x < 0 ? -std::pow(-x, gamma) : std::pow(x, gamma)); }
+
+	public:
+		GammaChannel(): gamma(1.0), copy(true), one() { }
+
+		void init(ColorReal gamma, bool use_table)
+		{
+			this->gamma = clamp_positive(gamma);
+			one = approximate_equal_lp(this->gamma, ColorReal(0.0));
+			copy = !one && approximate_equal_lp(this->gamma, ColorReal(1.0));
+			table.clear();
+			if (use_table && !one && !copy) {
+				// near zero curve may be too steep for linear interpolation,
+				// so first TABLE_MIN entries are never used
+				table.resize(TABLE_SIZE + 1);
+				for(int i = 0; i <= TABLE_SIZE; ++i)
+					table[i] = pow(ColorReal(i)/ColorReal(TABLE_SIZE));
+			}
+		}
+
+		inline void process(ColorReal &x) const
+		{
+			if (copy) return;
+			if (one) { x = ColorReal(1.0); return; }
+			if (!table.empty() && x >= ColorReal(TABLE_MIN)/ColorReal(TABLE_SIZE) && x < ColorReal(1.0)) {
+				ColorReal f = x*ColorReal(TABLE_SIZE);
+				int i = (int)f;
+				f -= ColorReal(i);
+				x = table[i]*(ColorReal(1.0) - f) + table[i + 1]*f;
+				return;
+			}
+			x = pow(x);
+		}
+
+		bool is_copy() const
+			{ return copy; }
+	};
+
+	struct Kernel {
+		bool is_gamma;
+		GammaChannel channels[3];
+		ColorMatrix::BatchProcessor processor;
+
+		Kernel(): is_gamma() { }
+
+		void process(Color *pixels, int count) const
+		{
+			if (is_gamma) {
+				for(int j = 0; j < 3; ++j)
+					if (!channels[j].is_copy())
+						for(ColorReal *c = (ColorReal*)pixels + j, *end = c + 4*count; c < end; c += 4)
+							channels[j].process(*c);
+			} else {
+				processor.process(pixels, count, pixels, count, count, 1);
+			}
+		}
+	};
+
+	typedef std::vector<Kernel> KernelList;
+
+	void build_kernels(KernelList &kernels, bool use_tables) const
+	{
+		kernels.resize(steps.size());
+		for(int i = 0; i < (int)steps.size(); ++i) {
+			Kernel &kernel = kernels[i];
+			kernel.is_gamma = steps[i].is_gamma;
+			if (kernel.is_gamma) {
+				kernel.channels[0].init(steps[i].gamma.get_r(), use_tables);
+				kernel.channels[1].init(steps[i].gamma.get_g(), use_tables);
+				kernel.channels[2].init(steps[i].gamma.get_b(), use_tables);
+			} else {
+				kernel.processor = ColorMatrix::BatchProcessor(steps[i].matrix);
+			}
+		}
+	}
+
+	static Color process_color(const KernelList &kernels, Color color)
+	{
+		for(KernelList::const_iterator i = kernels.begin(); i != kernels.end(); ++i)
+			i->process(&color, 1);
+		return color;
+	}
+
+	static void process(
+		const KernelList &kernels,
+		Color *dst, int dst_stride,
+		const Color *src, int src_stride,
+		int width, int height )
+	{
+		for(int y = 0; y < height; ++y, dst += dst_stride, src += src_stride) {
+			for(int x = 0; x < width; x += CHUNK_SIZE) {
+				int count = std::min(width - x, (int)CHUNK_SIZE);
+				Color *d = dst + x;
+				memcpy(static_cast<void*>(d), src + x, count*sizeof(Color));
+				for(KernelList::const_iterator i = kernels.begin(); i != kernels.end(); ++i)
+					i->process(d, count);
+			}
+		}
+	}
+
+public:
+	virtual bool run(RunParams&) const {
+		if (!is_valid())
+			return true;
+
+		RectInt rd = target_rect;
+		std::vector<RectInt> constant_rects(1, rd);
+
+		// lookup tables are worth to build for large areas only
+		KernelList kernels;
+		build_kernels(kernels, rd.get_width()*rd.get_height() > 16*GammaChannel::TABLE_SIZE);
+
+		LockWrite ldst(this);
+		if (!ldst) return false;
+		synfig::Surface &dst = ldst->get_surface();
+
+		if (!is_constant() && sub_task() && sub_task()->is_valid())
+		{
+			VectorInt offset = get_offset();
+			RectInt rs = sub_task()->target_rect + rd.get_min() + offset;
+			rect_set_intersect(rs, rs, rd);
+			if (rs.is_valid())
+			{
+				LockRead lsrc(sub_task());
+				if (!lsrc) return false;
+				const synfig::Surface &src = lsrc->get_surface();
+
+				rs.list_subtract(constant_rects);
+				process(
+					kernels,
+					&dst[rs.miny][rs.minx],
+					dst.get_pitch()/sizeof(Color),
+					&src[rs.miny - rd.miny - offset[1]][rs.minx - rd.minx - offset[0]],
+					src.get_pitch()/sizeof(Color),
+					rs.get_width(),
+					rs.get_height() );
+			}
+		}
+
+		if (is_constant() || is_affects_transparent()) {
+			Color constant = process_color(kernels, Color());
+			for(std::vector<RectInt>::const_iterator i = constant_rects.begin(); i != constant_rects.end(); ++i)
+				dst.fill(constant, i->minx, i->miny, i->get_width(), i->get_height());
+		}
+
+		return true;
+	}
+};
+
+
+Task::Token TaskPixelChainSW::token(
+	DescReal<TaskPixelChainSW, TaskPixelChain>("PixelChainSW") );
+
+} // end of anonimous namespace
+
+/* === E N T R Y P O I N T ================================================= */
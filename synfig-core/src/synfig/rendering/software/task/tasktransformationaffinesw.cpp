@@ -38,6 +38,7 @@
 #include "../../common/task/taskpixelprocessor.h"
 #include "tasksw.h"
 
+#include "../surfaceswmipmap.h"
 #include "../surfaceswpacked.h"
 #include "../function/resample.h"
 
@@ -57,7 +58,8 @@ using namespace rendering;
 namespace {
 
 class TaskTransformationAffineSW: public TaskTransformationAffine, public TaskSW,
-	public TaskInterfaceBlendToTarget
+	public TaskInterfaceBlendToTarget,
+	public TaskInterfaceSplit
 {
 private:
 	class Helper;
@@ -100,6 +102,23 @@ public:
 
 		// resample
 		LockReadBase lsrc(sub_task());
+		if ( software::Resample::is_downscale(matrix, interpolation)
+		  && sub_task()->target_rect == RectInt(VectorInt(), sub_task()->target_surface->get_size())
+		  && lsrc.convert<SurfaceSWMipmap>() )
+		{
+			// mipmap is kept in source resource, so it will be reused by next frames
+			SurfaceSWMipmap::Handle src = lsrc.cast<SurfaceSWMipmap>();
+			if (!src) return false;
+			software::Resample::resample(
+				ldst->get_surface(),
+				target_rect,
+				src->get_mipmap(),
+				matrix,
+				interpolation,
+				blend,
+				amount,
+				blend_method );
+		} else
 		if (lsrc.convert<SurfaceSWPacked>(false)) {
 			SurfaceSWPacked::Handle src = lsrc.cast<SurfaceSWPacked>();
 			if (!src) return false;
@@ -330,6 +330,57 @@ SurfaceResource::assign(Surface::Handle surface)
 	blank = surface->is_blank();
 }
 
+bool
+SurfaceResource::is_opaque() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (blank || width <= 0 || height <= 0)
+		return false;
+	for(Map::const_iterator i = surfaces.begin(); i != surfaces.end(); ++i)
+		if (i->second->is_opaque())
+			return true;
+	return false;
+}
+
+bool
+SurfaceResource::convert_storage(const Surface::Token::Handle &token)
+{
+	if (!token)
+		return false;
+
+	Glib::Threads::RWLock::WriterLock lock(rwlock);
+	std::lock_guard<std::mutex> short_lock(mutex);
+
+	if (width <= 0 || height <= 0)
+		return false;
+	if (blank)
+		{ surfaces.clear(); return true; } // blank surface will be created on demand
+
+	Surface::Handle surface;
+	Map::const_iterator i = surfaces.find(token);
+	if (i != surfaces.end()) {
+		surface = i->second;
+	} else {
+		surface = token->fabric();
+		if (!surface)
+			return false;
+
+		bool found = false;
+		for(Map::const_iterator i = surfaces.begin(); i != surfaces.end() && !found; ++i)
+			if (i->second->get_pixels_pointer() && surface->assign(*i->second))
+				found = true;
+		for(Map::const_iterator i = surfaces.begin(); i != surfaces.end() && !found; ++i)
+			if (!i->second->get_pixels_pointer() && surface->assign(*i->second))
+				found = true;
+		if (!found)
+			return false;
+	}
+
+	surfaces.clear();
+	surfaces[token] = surface;
+	return true;
+}
+
 void
 SurfaceResource::clear()
 {
@@ -132,6 +132,9 @@ public:
 
 	virtual bool is_read_only() const
 		{ return false; }
+	//! Returns true when all pixels are known to be fully opaque
+	virtual bool is_opaque() const
+		{ return false; }
 
 	bool create(int width, int height);
 	bool assign(const Surface &other);
@@ -357,6 +360,11 @@ public:
 	void create(const VectorInt &x)
 		{ create(x[0], x[1]); }
 
+	//! Converts content to surface of selected type and releases all other representations.
+	//! Returns false and keeps content as is when conversion is not possible
+	//! (for example when values are out of range of surface of narrow type)
+	bool convert_storage(const Surface::Token::Handle &token);
+
 	int get_id() const //!< helps to debug of renderer optimizers
 		{ return id; }
 	int get_width() const
@@ -369,6 +377,7 @@ public:
 		{ std::lock_guard<std::mutex> lock(mutex); return width > 0 && height > 0; }
 	bool is_blank() const
 		{ std::lock_guard<std::mutex> lock(mutex); return blank; }
+	bool is_opaque() const;
 	bool has_surface(const Surface::Token::Handle &token) const
 		{ std::lock_guard<std::mutex> lock(mutex); return surfaces.count(token); }
 	template<typename T>
@@ -57,6 +57,8 @@ SYNFIG_EXPORT Task::Token TaskSurface::token(
 	DescSpecial<TaskSurface>("Surface") );
 Task::Token TaskLockSurface::token(
 	DescSpecial<TaskLockSurface>("LoskSurface") );
+Task::Token TaskSurfaceConvert::token(
+	DescSpecial<TaskSurfaceConvert>("SurfaceConvert") );
 Task::Token TaskList::token(
 	DescSpecial<TaskList>("List") );
 SYNFIG_EXPORT Task::Token TaskEvent::token(
@@ -320,6 +322,35 @@ Task::run(RunParams & /* params */) const
 	{ return false; }
 
 
+// TaskSurface
+
+Rect
+TaskSurface::calc_opaque_rect() const
+{
+	// whole surface should be used
+	if ( !is_valid()
+	  || target_rect.minx != 0
+	  || target_rect.miny != 0
+	  || target_surface->get_size() != target_rect.get_max()
+	  || !target_surface->is_opaque() )
+		return Rect::zero();
+	return source_rect;
+}
+
+
+// TaskSurfaceConvert
+
+bool
+TaskSurfaceConvert::run(RunParams&) const
+{
+	if (target_surface)
+		for(std::vector<Surface::Token::Handle>::const_iterator i = tokens.begin(); i != tokens.end(); ++i)
+			if (target_surface->convert_storage(*i))
+				break;
+	return true;
+}
+
+
 // TaskList
 
 VectorInt
@@ -91,6 +91,42 @@ public:
 };
 
 
+//! Accumulates 64-bit FNV-1a hash of task parameters, see Task::hash_params()
+class TaskHash
+{
+public:
+	typedef unsigned long long Value;
+
+private:
+	Value value;
+
+public:
+	TaskHash(): value(14695981039346656037ull) { }
+
+	void add(const void *data, size_t size) {
+		const unsigned char *c = (const unsigned char*)data;
+		for(const unsigned char *end = c + size; c < end; ++c)
+			{ value ^= *c; value *= 1099511628211ull; }
+	}
+	void add(const String &x)
+		{ add(x.size()); add(x.c_str(), x.size()); }
+	void add(const Rect &x)
+		{ add(x.minx); add(x.miny); add(x.maxx); add(x.maxy); }
+	void add(const RectInt &x)
+		{ add(x.minx); add(x.miny); add(x.maxx); add(x.maxy); }
+	void add(const Vector &x)
+		{ add(x[0]); add(x[1]); }
+	void add(const VectorInt &x)
+		{ add(x[0]); add(x[1]); }
+	template<typename T>
+	void add(const T &x)
+		{ add(&x, sizeof(x)); }
+
+	Value get() const
+		{ return value; }
+};
+
+
 // Mode
 
 
@@ -413,6 +449,10 @@ public:
 	Task::Handle clone_recursive() const;
 
 	virtual Rect calc_bounds() const;
+	//! Rect (in source units) where result of task is known to be fully opaque,
+	//! zero rect when task cannot tell it
+	virtual Rect calc_opaque_rect() const
+		{ return Rect::zero(); }
 	void reset_bounds()
 		{ bounds_calculated = false; }
 	const Rect& get_bounds() const {
@@ -453,6 +493,12 @@ public:
 	void set_coords_zero();
 	virtual void set_coords_sub_tasks();
 	virtual bool run(RunParams &params) const;
+
+	//! Adds own parameters of task (without coordinates and sub-tasks) to the hash.
+	//! Returns false when result of task depends on data which cannot be hashed,
+	//! such tasks will never be taken from RenderCache.
+	virtual bool hash_params(TaskHash & /* hash */) const
+		{ return false; }
 };
 
 
@@ -510,6 +556,8 @@ public:
 	typedef etl::handle<TaskSurface> Handle;
 	SYNFIG_EXPORT static Token token;
 	virtual Token::Handle get_token() const { return token.handle(); }
+
+	virtual Rect calc_opaque_rect() const;
 };
 
 
@@ -540,6 +588,22 @@ public:
 };
 
 
+//! Converts target surface to the first of listed surface types
+//! which can hold its range of values, all other representations are released.
+//! Keeps intermediate results compact while they are waiting for tasks which read them.
+class TaskSurfaceConvert: public Task
+{
+public:
+	typedef etl::handle<TaskSurfaceConvert> Handle;
+	static Token token;
+	virtual Token::Handle get_token() const { return token.handle(); }
+
+	std::vector<Surface::Token::Handle> tokens;
+
+	virtual bool run(RunParams&) const;
+};
+
+
 //! Tasks in TaskList executes sequentially and all of them draws at TaskList target surface.
 //! So all tasks inside TaskList should to have the same target surface
 //! which should be same as TaskList target surface.
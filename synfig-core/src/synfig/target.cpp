@@ -116,7 +116,7 @@ Target::create(const String &name, const String &filename,
 }
 
 int
-Target::next_frame(Time& time)
+Target::get_frame_time(int frame, Time& time)const
 {
 	int
 	total_frames(1),
@@ -145,19 +145,23 @@ Target::next_frame(Time& time)
 	}
 	else
 	{
-		time=(time_end-time_start)*curr_frame_/(total_frames-(exclude_last_frame?0:1))+time_start;
+		time=(time_end-time_start)*frame/(total_frames-(exclude_last_frame?0:1))+time_start;
 	}
 
-//	synfig::info("before curr_frame_: %d",curr_frame_);
-	curr_frame_++;
-	
-//	synfig::info("before curr_frame_: %d",curr_frame_);
 //	synfig::info("total_frames: %d",total_frames);
 //	synfig::info("time_end: %s",time_end.get_string().c_str());
 //	synfig::info("time_start: %s",time_start.get_string().c_str());
 //	synfig::info("time: %s",time.get_string().c_str());
-//	synfig::info("remaining frames %d", total_frames-curr_frame_);
+//	synfig::info("remaining frames %d", total_frames-frame-1);
+
+	return total_frames-frame-1;
+}
 
-	return total_frames- curr_frame_;
+int
+Target::next_frame(Time& time)
+{
+	int frames=get_frame_time(curr_frame_, time);
+	curr_frame_++;
+	return frames;
 }
 
@@ -203,6 +203,12 @@ public:
 	TargetAlphaMode get_alpha_mode()const { return alpha_mode; }
 	//! Sets how to handle alpha
 	void set_alpha_mode(TargetAlphaMode x=TARGET_ALPHA_MODE_KEEP) { alpha_mode=x; }
+	//! Tells if finished frames may be written by a separate thread
+	/*! When true, frames are put into a bounded queue and written
+	 ** while the next frames are rendering. Such a target must not depend
+	 ** on the canvas time or curr_frame_ while writing a frame.
+	 */
+	virtual bool supports_async_output()const { return false; }
 	//! Sets the target canvas. Must be defined by derived targets
 	virtual void set_canvas(etl::handle<Canvas> c);
 	//! Gets the target canvas.
@@ -238,6 +244,12 @@ public:
 	 **	\sa curr_frame_
 	*/
 	virtual int	next_frame(Time& time);
+
+	//!	Calculates the time of frame number \a frame (counting from zero)
+	/*!	Unlike next_frame() it doesn't touch curr_frame_
+	 **	\return The number of frames after this one
+	*/
+	int get_frame_time(int frame, Time& time)const;
 }; // END of class Target
 
 }; // END of namespace synfig
@@ -33,6 +33,11 @@
 
 #include "target_scanline.h"
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 #include "general.h"
 #include <synfig/localization.h>
 
@@ -67,12 +72,182 @@ using namespace rendering;
 
 /* === M E T H O D S ======================================================= */
 
+//! Frame which rendering task graph is already built and enqueued
+struct Target_Scanline::PendingFrame
+{
+	int curr_frame;
+	SurfaceResource::Handle surface;
+	TaskEvent::Handle event;
+	PendingFrame(): curr_frame() { }
+};
+
+//! Passes calls to the callback under mutex,
+//! so it may be shared by render loop and writer thread
+class Target_Scanline::LockedCallback: public ProgressCallback
+{
+private:
+	ProgressCallback *cb;
+	std::mutex mutex;
+
+public:
+	explicit LockedCallback(ProgressCallback *cb): cb(cb) { }
+
+	virtual bool task(const String &task)
+		{ std::lock_guard<std::mutex> lock(mutex); return cb->task(task); }
+	virtual bool error(const String &task)
+		{ std::lock_guard<std::mutex> lock(mutex); return cb->error(task); }
+	virtual bool warning(const String &task)
+		{ std::lock_guard<std::mutex> lock(mutex); return cb->warning(task); }
+	virtual bool amount_complete(int current, int total)
+		{ std::lock_guard<std::mutex> lock(mutex); return cb->amount_complete(current, total); }
+	virtual bool valid() const
+		{ return cb->valid(); }
+};
+
+//! Writes finished frames to the target in a separate thread,
+//! so the next frames are rendering while previous ones are encoding.
+//! Frames are put by add_frame() with curr_frame_ of the frame,
+//! progress is reported when frame is written.
+//! curr_frame_ is also used by next_frame() of the render loop,
+//! so both of them change it under frame_mutex.
+class Target_Scanline::FrameWriter
+{
+private:
+	Target_Scanline &target;
+	ProgressCallback *cb;
+	const int max_queue;
+	const int total_frames;
+
+	std::mutex mutex;
+	std::mutex frame_mutex;
+	std::condition_variable cond;
+	std::deque<PendingFrame> queue;
+	int written;
+	bool stop;
+	bool failed;
+	bool cancelled;
+	std::thread thread;
+
+	void run()
+	{
+		while(true)
+		{
+			PendingFrame frame;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				while(!stop && queue.empty())
+					cond.wait(lock);
+				if (stop)
+					return;
+				frame = queue.front();
+			}
+
+			// frame stays in queue until it's written, so flush() waits for it
+			bool success = false;
+			try
+			{
+				SurfaceResource::LockRead<SurfaceSW> lock(frame.surface);
+				if (!lock)
+				{
+					if(cb)cb->error(_("Bad surface"));
+				}
+				else
+				{
+					std::lock_guard<std::mutex> frame_lock(frame_mutex);
+					target.curr_frame_ = frame.curr_frame;
+					success = target.add_frame(&lock->get_surface(), cb);
+				}
+			}
+			catch(...) { }
+
+			// If we have a callback, and it returns
+			// false, go ahead and bail. (it may be a user cancel)
+			bool proceed = !success || !cb || cb->amount_complete(written + 1, total_frames);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.pop_front();
+				if (success) ++written;
+				if (!success || !proceed)
+				{
+					failed = true;
+					cancelled = success;
+					queue.clear();
+				}
+			}
+			cond.notify_all();
+		}
+	}
+
+public:
+	FrameWriter(Target_Scanline &target, ProgressCallback *cb, int max_queue, int total_frames):
+		target(target),
+		cb(cb),
+		max_queue(std::max(1, max_queue)),
+		total_frames(total_frames),
+		written(0),
+		stop(false),
+		failed(false),
+		cancelled(false),
+		thread(&FrameWriter::run, this)
+	{ }
+
+	//! Drops frames which are not written yet,
+	//! waits until the frame being written is finished
+	~FrameWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		cond.notify_all();
+		thread.join();
+	}
+
+	//! Adds rendered frame to queue, waits while queue is full
+	//! \return false if writing of some previous frame failed or was cancelled
+	bool push(const PendingFrame &frame)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while(!failed && (int)queue.size() >= max_queue)
+			cond.wait(lock);
+		if (failed)
+			return false;
+		queue.push_back(frame);
+		cond.notify_all();
+		return true;
+	}
+
+	//! Waits until all queued frames are written
+	bool flush()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while(!failed && !queue.empty())
+			cond.wait(lock);
+		return !failed;
+	}
+
+	//! Should be locked while curr_frame_ is used outside of writer thread
+	std::mutex& get_frame_mutex()
+		{ return frame_mutex; }
+
+	//! Count of frames which are already written
+	int get_written()
+		{ std::lock_guard<std::mutex> lock(mutex); return written; }
+	//! Tells if writing was stopped by callback (user cancel)
+	bool is_cancelled()
+		{ std::lock_guard<std::mutex> lock(mutex); return cancelled; }
+};
+
 Target_Scanline::Target_Scanline():
-	threads_(2)
+	threads_(2),
+	frames_in_flight_(2)
 {
 	curr_frame_=0;
 	if (const char *s = getenv("SYNFIG_TARGET_DEFAULT_ENGINE"))
 		set_engine(s);
+	if (const char *s = getenv("SYNFIG_TARGET_FRAMES_IN_FLIGHT"))
+		set_frames_in_flight(atoi(s));
 }
 
 int
@@ -81,8 +256,8 @@ Target_Scanline::next_frame(Time& time)
 	return Target::next_frame(time);
 }
 
-bool
-synfig::Target_Scanline::call_renderer(
+rendering::Task::Handle
+synfig::Target_Scanline::build_rendering_task(
 	const etl::handle<rendering::SurfaceResource> &surface,
 	Canvas &canvas,
 	const ContextParams &context_params,
@@ -93,10 +268,6 @@ synfig::Target_Scanline::call_renderer(
 
 	if (task)
 	{
-		rendering::Renderer::Handle renderer = rendering::Renderer::get_renderer(get_engine());
-		if (!renderer)
-			throw "Renderer '" + get_engine() + "' not found";
-
 		Vector p0 = renddesc.get_tl();
 		Vector p1 = renddesc.get_br();
 		if (p0[0] > p1[0] || p0[1] > p1[1]) {
@@ -112,6 +283,24 @@ synfig::Target_Scanline::call_renderer(
 		task->target_surface = surface;
 		task->target_rect = RectInt( VectorInt(), surface->get_size() );
 		task->source_rect = Rect(p0, p1);
+	}
+	return task;
+}
+
+bool
+synfig::Target_Scanline::call_renderer(
+	const etl::handle<rendering::SurfaceResource> &surface,
+	Canvas &canvas,
+	const ContextParams &context_params,
+	const RendDesc &renddesc )
+{
+	rendering::Task::Handle task = build_rendering_task(surface, canvas, context_params, renddesc);
+
+	if (task)
+	{
+		rendering::Renderer::Handle renderer = rendering::Renderer::get_renderer(get_engine());
+		if (!renderer)
+			throw "Renderer '" + get_engine() + "' not found";
 
 		rendering::Task::List list;
 		list.push_back(task);
@@ -120,6 +309,113 @@ synfig::Target_Scanline::call_renderer(
 	return true;
 }
 
+void
+synfig::Target_Scanline::enqueue_frame(
+	PendingFrame &frame,
+	Canvas &canvas,
+	const ContextParams &context_params,
+	const RendDesc &renddesc )
+{
+	// Task graph holds own copies of layer parameters for the current time
+	// (see Layer::build_rendering_task_vfunc), so canvas may be switched to the
+	// next frame while this one is still rasterizing
+	frame.surface = new SurfaceResource();
+	frame.event = new TaskEvent();
+
+	rendering::Task::Handle task = build_rendering_task(frame.surface, canvas, context_params, renddesc);
+
+	rendering::Task::List list;
+	if (task) list.push_back(task);
+
+	rendering::Renderer::Handle renderer = rendering::Renderer::get_renderer(get_engine());
+	if (!renderer)
+		throw "Renderer '" + get_engine() + "' not found";
+	renderer->enqueue(list, frame.event);
+}
+
+bool
+synfig::Target_Scanline::finish_frame(PendingFrame &frame, FrameWriter *writer, ProgressCallback *cb)
+{
+	frame.event->wait();
+
+	if (writer)
+	{
+		// surface will be read and put onto the target by writer thread
+		if (!writer->push(frame))
+		{
+			if(cb && !writer->is_cancelled())cb->error(_("Unable to put surface on target"));
+			return false;
+		}
+		return true;
+	}
+
+	SurfaceResource::LockRead<SurfaceSW> lock(frame.surface);
+	if(!lock)
+	{
+		if(cb)cb->error(_("Bad surface"));
+		return false;
+	}
+
+	// targets may check the frame number while writing
+	curr_frame_ = frame.curr_frame;
+
+	// Put the surface we renderer
+	// onto the target.
+	if(!add_frame(&lock->get_surface(), cb))
+	{
+		if(cb)cb->error(_("Unable to put surface on target"));
+		return false;
+	}
+	return true;
+}
+
+void
+synfig::Target_Scanline::cancel_frames(std::deque<PendingFrame> &frames)
+{
+	for(std::deque<PendingFrame>::const_iterator i = frames.begin(); i != frames.end(); ++i)
+		rendering::Renderer::cancel(i->event);
+	frames.clear();
+}
+
+bool
+synfig::Target_Scanline::finish_frames(
+	std::deque<PendingFrame> &frames,
+	int keep,
+	FrameWriter *writer,
+	int &frames_done,
+	int total_frames,
+	ProgressCallback *cb )
+{
+	for(; (int)frames.size() > keep; frames.pop_front())
+	{
+		if (!finish_frame(frames.front(), writer, cb))
+			{ cancel_frames(frames); return false; }
+
+		// writer reports progress by itself when frame is written
+		if (writer)
+			continue;
+
+		// If we have a callback, and it returns
+		// false, go ahead and bail. (it may be a user cancel)
+		if (cb && !cb->amount_complete(++frames_done, total_frames))
+			{ cancel_frames(frames); return false; }
+	}
+	return true;
+}
+
+bool
+synfig::Target_Scanline::split_to_strips()const
+{
+	#if USE_PIXELRENDERING_LIMIT
+	// Renderer splits large frames to tiles by itself (see Renderer::get_tile_size()),
+	// so strips are needed only when tiling is disabled
+	return rendering::Renderer::get_tile_size() <= 0
+	    && desc.get_w()*desc.get_h() > PIXEL_RENDERING_LIMIT;
+	#else
+	return false;
+	#endif
+}
+
 bool
 synfig::Target_Scanline::render(ProgressCallback *cb)
 {
@@ -149,20 +445,46 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 	total_frames=frame_end-frame_start+1;
 	if(total_frames<=0)total_frames=1;
 
+	// Frames which are rendering now, in order of output
+	std::deque<PendingFrame> pending_frames;
+
+	// Frames which are written to target while next ones are rendering,
+	// callback is shared with writer thread
+	LockedCallback locked_cb(cb);
+	std::unique_ptr<FrameWriter> writer;
+	if (supports_async_output() && get_frames_in_flight() > 1)
+	{
+		if (cb) cb = &locked_cb;
+		writer.reset(new FrameWriter(*this, cb, get_frames_in_flight(), total_frames));
+	}
+
 	try {
 
 	//synfig::info("1time_set_to %s",t.get_string().c_str());
 
 	if(total_frames>=1)
 	{
+		// Count of frames which are already put onto the target
+		int frames_done=0;
+		// Number of the current frame, counting from one like curr_frame_
+		// after next_frame(), keeps the number of frame for the output,
+		// because curr_frame_ is changed when previous frames are put onto the target
+		int frame=0;
+
 		do{
 			// Grab the time
-			frames=next_frame(t);
+			{
+				std::unique_lock<std::mutex> frame_lock;
+				if (writer) frame_lock = std::unique_lock<std::mutex>(writer->get_frame_mutex());
+				curr_frame_=frame;
+				frames=next_frame(t);
+				++frame;
+			}
 
 			// If we have a callback, and it returns
 			// false, go ahead and bail. (it may be a user cancel)
-			if(cb && !cb->amount_complete(total_frames-frames,total_frames))
-				return false;
+			if(cb && !cb->amount_complete(frames_done + (writer ? writer->get_written() : 0),total_frames))
+				{ cancel_frames(pending_frames); return false; }
 
 			// Set the time that we wish to render
 			if(!get_avoid_time_sync() || canvas->get_time()!=t) {
@@ -173,9 +495,17 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 
 			// If quality is set otherwise, then we use the accelerated renderer
 			{
-				#if USE_PIXELRENDERING_LIMIT
-				if(desc.get_w()*desc.get_h() > PIXEL_RENDERING_LIMIT)
+				if(split_to_strips())
 				{
+					// output all previous frames before the start of this one
+					if (!finish_frames(pending_frames, 0, writer.get(), frames_done, total_frames, cb))
+						return false;
+					if (writer && !writer->flush())
+					{
+						if(cb)cb->error(_("Unable to put surface on target"));
+						return false;
+					}
+
 					SurfaceResource::Handle surface = new SurfaceResource();
 
 					int rowheight = PIXEL_RENDERING_LIMIT/desc.get_w();
@@ -189,6 +519,7 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 								 rows-1, rows==2?"":"s", rowheight, lastrowheight);
 
 					// loop through all the full rows
+					curr_frame_=frame;
 					if(!start_frame())
 					{
 //						throw(string("add_frame(): target panic on start_frame()"));
@@ -282,37 +613,31 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 
 					end_frame();
 
+					++frames_done;
+					if(cb && !cb->amount_complete(frames_done + (writer ? writer->get_written() : 0),total_frames))
+						return false;
 				}else //use normal rendering...
 				{
-				#endif
-					SurfaceResource::Handle surface = new SurfaceResource();
-
-					if (!call_renderer(surface, *canvas, context_params, desc))
-					{
-						// For some reason, the accelerated renderer failed.
-						if(cb)cb->error(_("Accelerated Renderer Failure"));
-						return false;
-					}
-
-					SurfaceResource::LockRead<SurfaceSW> lock(surface);
-					if(!lock)
-					{
-						if(cb)cb->error(_("Bad surface"));
-						return false;
-					}
+					pending_frames.push_back(PendingFrame());
+					pending_frames.back().curr_frame = frame;
+					enqueue_frame(pending_frames.back(), *canvas, context_params, desc);
 
-					// Put the surface we renderer
-					// onto the target.
-					if(!add_frame(&lock->get_surface(), cb))
-					{
-						if(cb)cb->error(_("Unable to put surface on target"));
+					// build next frames while this one is rendering,
+					// output the oldest frame when limit is reached
+					if (!finish_frames(pending_frames, get_frames_in_flight() - 1, writer.get(), frames_done, total_frames, cb))
 						return false;
-					}
-				#if USE_PIXELRENDERING_LIMIT
 				}
-				#endif
 			}
 		}while(frames);
+
+		if (!finish_frames(pending_frames, 0, writer.get(), frames_done, total_frames, cb))
+			return false;
+
+		if (writer && !writer->flush())
+		{
+			if(cb)cb->error(_("Unable to put surface on target"));
+			return false;
+		}
 	}
     else
     {
@@ -325,8 +650,7 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 
 		// If quality is set otherwise, then we use the accelerated renderer
 		{
-			#if USE_PIXELRENDERING_LIMIT
-			if(desc.get_w()*desc.get_h() > PIXEL_RENDERING_LIMIT)
+			if(split_to_strips())
 			{
 				SurfaceResource::Handle surface(new SurfaceResource());
 
@@ -442,7 +766,6 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 
 			}else
 			{
-			#endif
 				SurfaceResource::Handle surface = new SurfaceResource();
 
 				if (!call_renderer(surface, *canvas, context_params, desc))
@@ -466,25 +789,26 @@ synfig::Target_Scanline::render(ProgressCallback *cb)
 					if(cb)cb->error(_("Unable to put surface on target"));
 					return false;
 				}
-			#if USE_PIXELRENDERING_LIMIT
 			}
-			#endif
 		}
 	}
 
 	}
 	catch(const String& str)
 	{
+		cancel_frames(pending_frames);
 		if (cb) cb->error(_("Caught string: ")+str);
 		return false;
 	}
 	catch (std::bad_alloc&)
 	{
+		cancel_frames(pending_frames);
 		if (cb) cb->error(_("Ran out of memory (Probably a bug)"));
 		return false;
 	}
 	catch (...)
 	{
+		cancel_frames(pending_frames);
 		if(cb)cb->error(_("Caught unknown error, rethrowing..."));
 		throw;
 	}
@@ -28,6 +28,8 @@
 
 /* === H E A D E R S ======================================================= */
 
+#include <deque>
+
 #include "target.h"
 
 /* === M A C R O S ========================================================= */
@@ -38,7 +40,7 @@
 
 namespace synfig {
 
-namespace rendering { class SurfaceResource; }
+namespace rendering { class SurfaceResource; class Task; class TaskEvent; }
 
 /*!	\class Target_Scanline
 **	\brief This is a Target class that implements the render function
@@ -48,15 +50,46 @@ class Target_Scanline : public Target
 {
 	//! Number of threads to use
 	int threads_;
+	//! Number of frames which may be rendered simultaneously
+	int frames_in_flight_;
 
 	String engine_;
 
+	struct PendingFrame;
+	class LockedCallback;
+	class FrameWriter;
+
+	etl::handle<rendering::Task> build_rendering_task(
+		const etl::handle<rendering::SurfaceResource> &surface,
+		Canvas &canvas,
+		const ContextParams &context_params,
+		const RendDesc &renddesc );
+
 	bool call_renderer(
 		const etl::handle<rendering::SurfaceResource> &surface,
 		Canvas &canvas,
 		const ContextParams &context_params,
 		const RendDesc &renddesc );
 
+	void enqueue_frame(
+		PendingFrame &frame,
+		Canvas &canvas,
+		const ContextParams &context_params,
+		const RendDesc &renddesc );
+	bool finish_frame(PendingFrame &frame, FrameWriter *writer, ProgressCallback *cb);
+	static void cancel_frames(std::deque<PendingFrame> &frames);
+	//! Finishes the oldest frames until \a keep frames left,
+	//! reports progress, cancels all frames on failure or user cancel
+	bool finish_frames(
+		std::deque<PendingFrame> &frames,
+		int keep,
+		FrameWriter *writer,
+		int &frames_done,
+		int total_frames,
+		ProgressCallback *cb );
+	//! Tells if frame should be rendered by horizontal strips to limit memory usage
+	bool split_to_strips()const;
+
 public:
 	typedef etl::handle<Target_Scanline> Handle;
 	typedef etl::loose_handle<Target_Scanline> LooseHandle;
@@ -102,6 +135,15 @@ public:
 	void set_threads(int x) { threads_=x; }
 	//! Gets the number of threads
 	int get_threads()const { return threads_; }
+	//! Sets the number of frames which may be rendered simultaneously.
+	/*! Task graph of the next frame is built while previous frames
+	**	are rasterized. The same count of finished frames may wait for
+	**	writing when target supports_async_output().
+	**	Value 1 disables this pipelining.
+	*/
+	void set_frames_in_flight(int x) { frames_in_flight_=x < 1 ? 1 : x; }
+	//! Gets the number of frames which may be rendered simultaneously
+	int get_frames_in_flight()const { return frames_in_flight_; }
 	//! Gets engine
 	const String& get_engine()const { return engine_; }
 	//! Sets engine
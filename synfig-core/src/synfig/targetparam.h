@@ -45,12 +45,19 @@ struct TargetParam
 	 *  its own valid default settings.
 	 */
 	TargetParam (const std::string& Video_codec = "none", int Bitrate = -1):
-		video_codec(Video_codec), bitrate(Bitrate), sequence_separator("."), offset_x(0), offset_y(0),rows(0),columns(0),append(true),dir(HR)
+		video_codec(Video_codec), bitrate(Bitrate), sequence_separator("."), compression_level(-1), bit_depth(0), offset_x(0), offset_y(0),rows(0),columns(0),append(true),dir(HR)
 	{ }
 
 	std::string video_codec;
 	int bitrate;
 	std::string sequence_separator;
+	//! Compression level of image targets (0..9), -1 for target default
+	int compression_level;
+	//! Bits per channel of image targets, 0 for target default
+	int bit_depth;
+	//! PNG row filter: "none", "sub", "up", "avg", "paeth" or "all",
+	//! empty for target default
+	std::string png_filter;
 	//TODO: It is a spike. Need to separate this class.
 	int offset_x;
 	int offset_y;
@@ -57,6 +57,7 @@
 #include <synfig/string.h>
 #include <synfig/paramdesc.h>
 #include <synfig/main.h>
+#include <synfig/debug/trace.h>
 #include <autorevision.h>
 #include "definitions.h"
 #include "progress.h"
@@ -122,6 +123,13 @@ int main(int argc, char* argv[])
 		return SYNFIGTOOL_BADVERSION;
 	}
 
+	// writes file if trace was started by --trace-file,
+	// on any exit from main() including errors
+	class TraceGuard {
+	public:
+		~TraceGuard() { synfig::debug::Trace::stop(); }
+	} trace_guard;
+
 	try
 	{
 		if(argc == 1)
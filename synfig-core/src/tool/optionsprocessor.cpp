@@ -29,6 +29,7 @@
 #	include <config.h>
 #endif
 
+#include <algorithm>
 #include <iostream>
 
 #include <autorevision.h>
@@ -46,6 +47,7 @@
 #include <synfig/filesystemgroup.h>
 #include <synfig/filesystemnative.h>
 #include <synfig/filecontainerzip.h>
+#include <synfig/debug/trace.h>
 
 #include "definitions.h"
 #include "job.h"
@@ -98,7 +100,11 @@ SynfigCommandLineParser::SynfigCommandLineParser() :
 	set_num_threads(),
 	set_input_file(),
 	set_output_file(),
+	set_trace_file(),
 	set_sequence_separator(),
+	set_compression_level(-1),
+	set_bit_depth(),
+	set_png_filter(),
 	set_canvas_id(),
 	set_fps(),
 	set_time(),
@@ -156,7 +162,11 @@ SynfigCommandLineParser::SynfigCommandLineParser() :
 	add_option(og_set, "threads",     'T', set_num_threads, _("Enable multithreaded renderer using the specified number of threads"), "NUM");
 	add_option(og_set, "input-file",  'i', set_input_file, 	_("Specify input filename"), "filename");
 	add_option(og_set, "output-file", 'o', set_output_file, _("Specify output filename"), "filename");
+	add_option(og_set, "trace-file",  ' ', set_trace_file,  _("Write trace of rendering tasks in Chrome trace format to <filename>"), "filename");
 	add_option(og_set, "sequence-separator", ' ', set_sequence_separator, _("Output file sequence separator string (Use double quotes if you want to use spaces)"), "string");
+	add_option(og_set, "compression-level", ' ', set_compression_level, _("Set compression level of image targets (0 is fastest, 9 is smallest)"), "0..9");
+	add_option(og_set, "bit-depth",   ' ', set_bit_depth,   _("Set bits per channel of image targets (8 or 16)"), "NUM");
+	add_option(og_set, "png-filter",  ' ', set_png_filter,  _("Set row filter of PNG target (none, sub, up, avg, paeth or all)"), "filter");
 	add_option(og_set, "canvas",      'c', set_canvas_id, 	_("Render the canvas with the given id instead of the root."), "id");
 	add_option(og_set, "fps",         ' ', set_fps, 		_("Set the frame rate"), "NUM");
 	add_option(og_set, "time",        ' ', set_time, 		_("Render a single frame at <seconds>"), "seconds");
@@ -218,6 +228,7 @@ SynfigCommandLineParser::SynfigCommandLineParser() :
 	context.add_group(og_debug);
 #endif
 
+	_allowed_video_codecs.push_back(VideoCodec("ffv1", "FFV1 lossless video (16-bit RGBA input)."));
 	_allowed_video_codecs.push_back(VideoCodec("flv", "Flash Video (FLV) / Sorenson Spark / Sorenson H.263."));
 	_allowed_video_codecs.push_back(VideoCodec("h263p", "H.263+ / H.263-1998 / H.263 version 2."));
 	_allowed_video_codecs.push_back(VideoCodec("huffyuv", "Huffyuv / HuffYUV."));
@@ -231,6 +242,7 @@ SynfigCommandLineParser::SynfigCommandLineParser() :
 	_allowed_video_codecs.push_back(VideoCodec("msmpeg4", "MPEG-4 part 2 Microsoft variant version 3."));
 	_allowed_video_codecs.push_back(VideoCodec("msmpeg4v1", "MPEG-4 part 2 Microsoft variant version 1."));
 	_allowed_video_codecs.push_back(VideoCodec("msmpeg4v2", "MPEG-4 part 2 Microsoft variant version 2."));
+	_allowed_video_codecs.push_back(VideoCodec("prores_ks", "Apple ProRes 4444 (16-bit RGBA input)."));
 	_allowed_video_codecs.push_back(VideoCodec("wmv1", "Windows Media Video 7."));
 	_allowed_video_codecs.push_back(VideoCodec("wmv2", "Windows Media Video 8."));
 
@@ -358,6 +370,12 @@ void SynfigCommandLineParser::process_settings_options() const
 
 	VERBOSE_OUT(1) << _("Threads set to ")
 				   << SynfigToolGeneralOptions::instance()->get_threads() << std::endl;
+
+	if (!set_trace_file.empty())
+	{
+		synfig::debug::Trace::start(set_trace_file);
+		VERBOSE_OUT(1) << _("Trace file set to ") << set_trace_file << std::endl;
+	}
 }
 
 void SynfigCommandLineParser::process_trivial_info_options()
@@ -635,6 +653,21 @@ TargetParam SynfigCommandLineParser::extract_targetparam()
                        << "'."
 					   << std::endl;
 	}
+	if (set_compression_level >= 0)
+	{
+		params.compression_level = std::min(set_compression_level, 9);
+		VERBOSE_OUT(1) << _("Compression level set to: ") << params.compression_level << std::endl;
+	}
+	if (set_bit_depth > 0)
+	{
+		params.bit_depth = set_bit_depth;
+		VERBOSE_OUT(1) << _("Bit depth set to: ") << params.bit_depth << std::endl;
+	}
+	if (!set_png_filter.empty())
+	{
+		params.png_filter = set_png_filter;
+		VERBOSE_OUT(1) << _("PNG filter set to: ") << params.png_filter << std::endl;
+	}
 
 	return params;
 }
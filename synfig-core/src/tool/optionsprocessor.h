@@ -160,7 +160,11 @@ private:
 	int				set_num_threads;
 	Glib::ustring	set_input_file;
 	Glib::ustring	set_output_file;
+	Glib::ustring	set_trace_file;
 	Glib::ustring	set_sequence_separator;
+	int				set_compression_level;
+	int				set_bit_depth;
+	Glib::ustring	set_png_filter;
 	Glib::ustring	set_canvas_id;
 	double			set_fps;
 	Glib::ustring	set_time;
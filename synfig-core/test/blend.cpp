@@ -0,0 +1,107 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file test/blend.cpp
+**	\brief Test vectorized blend functions
+**
+**	$Id$
+**
+**	\legal
+**	Copyright (c) 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+#include <synfig/color.h>
+#include <synfig/general.h>
+#include <synfig/rendering/software/function/blend.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include <iostream>
+
+using namespace std;
+using namespace synfig;
+using namespace synfig::rendering;
+
+ostream& operator<<(ostream& os, const Color& c)
+{
+	os << '(' << c.get_r() << ',' << c.get_g() << ',' << c.get_b() << ',' << c.get_a() << ')';
+	return os;
+}
+
+static ColorReal random_value(int i, int zero_step)
+	{ return i % zero_step == 0 ? 0 : (ColorReal)rand()/(ColorReal)RAND_MAX; }
+
+//! compares vectorized blending with Color::blend for all supported instructions
+bool test_blend_row_exactness() {
+	const Color::BlendMethod methods[] = {
+		Color::BLEND_COMPOSITE,
+		Color::BLEND_STRAIGHT,
+		Color::BLEND_ONTO,
+		Color::BLEND_BEHIND,
+		Color::BLEND_ADD,
+		Color::BLEND_MULTIPLY,
+		Color::BLEND_SCREEN,
+		Color::BLEND_ALPHA_OVER };
+	const ColorReal amounts[] = { 1.0, 0.5, 0.0, -0.3, 1.5 };
+
+	// odd count to check the tail of two-pixel kernels
+	const int count = 1001;
+	std::vector<Color> src(count), dest(count);
+	srand(0);
+	for(int i = 0; i < count; ++i) {
+		src[i] = Color(random_value(i, 11), random_value(i, 13), random_value(i, 17), random_value(i, 7));
+		dest[i] = Color(random_value(i, 19), random_value(i, 23), random_value(i, 29), random_value(i, 5));
+	}
+
+	const int supported = software::Blend::get_supported_instructions();
+	for(int instructions = software::Blend::SCALAR; instructions <= supported; ++instructions)
+		for(int m = 0; m < (int)(sizeof(methods)/sizeof(methods[0])); ++m)
+			for(int a = 0; a < (int)(sizeof(amounts)/sizeof(amounts[0])); ++a) {
+				std::vector<Color> expected(dest), value(dest);
+				software::Blend::blend_row_scalar(&expected.front(), &src.front(), count, amounts[a], methods[m]);
+				software::Blend::blend_row(&value.front(), &src.front(), count, amounts[a], methods[m], (software::Blend::Instructions)instructions);
+				for(int i = 0; i < count; ++i)
+					if (expected[i] != value[i]) {
+						std::cerr << __FUNCTION__ << ": instructions " << instructions
+						          << ", method " << methods[m] << ", amount " << amounts[a]
+						          << ", pixel " << i << " - expected " << expected[i]
+						          << ", but got " << value[i] << std::endl;
+						return true;
+					}
+			}
+
+	return false;
+}
+
+#define TEST_FUNCTION(function_name) {\
+	fail = function_name(); \
+	if (fail) { \
+		error("%s FAILED", #function_name); \
+		failures++; \
+	} \
+}
+
+int main() {
+	int failures = 0;
+	bool fail;
+
+	TEST_FUNCTION(test_blend_row_exactness)
+
+	if (failures)
+		error("Test finished with %i errors", failures);
+	else
+		info("Success");
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,221 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file test/rendercache.cpp
+**	\brief Test of persistent cache of rendered surfaces
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+#include <synfig/general.h>
+#include <synfig/main.h>
+#include <synfig/surface.h>
+#include <synfig/rendering/rendercache.h>
+#include <synfig/rendering/common/task/taskpixelprocessor.h>
+#include <synfig/rendering/software/surfacesw.h>
+
+#include <iostream>
+
+using namespace std;
+using namespace synfig;
+using namespace rendering;
+
+static String cache_path;
+
+//! size of cache file with surface of \a width x \a height pixels, without header
+static long long pixels_size(int width, int height)
+	{ return (long long)width*height*sizeof(Color); }
+
+//! Creates chain of \a count tasks, \a value makes hash of chain unique
+static Task::Handle create_chain(int count, ColorReal value, int width, int height)
+{
+	SurfaceResource::Handle surface(new SurfaceResource());
+	surface->create(width, height);
+
+	// constant color at the bottom, gamma tasks above it
+	Task::Handle task;
+	for(int i = 0; i < count; ++i) {
+		Task::Handle t;
+		if (task) {
+			TaskPixelGamma::Handle gamma(new TaskPixelGamma());
+			gamma->gamma = Gamma(2.0);
+			gamma->sub_task() = task;
+			t = gamma;
+		} else {
+			TaskPixelColorMatrix::Handle color(new TaskPixelColorMatrix());
+			color->matrix.set_translate(value, 0.0, 0.0, 1.0);
+			t = color;
+		}
+		t->source_rect = Rect(0, 0, 1, 1);
+		t->target_rect = RectInt(0, 0, width, height);
+		t->target_surface = surface;
+		task = t;
+	}
+	return task;
+}
+
+//! Fills target of task with color, as renderer would do
+static void fill(const Task::Handle &task, const Color &color)
+{
+	SurfaceResource::LockWrite<SurfaceSW> lock(task->target_surface);
+	if (lock) lock->get_surface().fill(color);
+}
+
+//! Runs store tasks returned by RenderCache::process()
+static void run_stores(const Task::List &stores)
+{
+	for(Task::List::const_iterator i = stores.begin(); i != stores.end(); ++i) {
+		Task::RunParams params;
+		(*i)->run(params);
+	}
+}
+
+static bool check_stats(
+	const char *function,
+	const RenderCache &cache,
+	long long hits, long long misses, long long stores, long long evictions )
+{
+	RenderCache::Stats stats = cache.get_stats();
+	if ( stats.hits != hits
+	  || stats.misses != misses
+	  || stats.stores != stores
+	  || stats.evictions != evictions )
+	{
+		std::cerr << function << ": expected "
+		          << hits << " hits, " << misses << " misses, "
+		          << stores << " stores, " << evictions << " evictions, but got "
+		          << stats.hits << ", " << stats.misses << ", "
+		          << stats.stores << ", " << stats.evictions << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//! stored frame should be loaded at next process() instead of rendering
+bool test_hit_after_miss() {
+	RenderCache cache(cache_path, 1024*1024, 4);
+	cache.clear();
+
+	Task::List list, stores;
+	list.push_back(create_chain(4, 1.0, 16, 16));
+	cache.process(list, "test", stores);
+	if (list.size() != 1 || stores.size() != 1) {
+		std::cerr << __FUNCTION__ << ": expected one task and one store, but got "
+		          << list.size() << " and " << stores.size() << std::endl;
+		return true;
+	}
+	fill(list.front(), Color(0.25, 0.5, 0.75, 1.0));
+	run_stores(stores);
+	if (!check_stats(__FUNCTION__, cache, 0, 1, 1, 0))
+		return true;
+
+	Task::Handle task = create_chain(4, 1.0, 16, 16);
+	list.clear();
+	stores.clear();
+	list.push_back(task);
+	cache.process(list, "test", stores);
+	if (!list.empty() || !stores.empty()) {
+		std::cerr << __FUNCTION__ << ": frame was not taken from cache" << std::endl;
+		return true;
+	}
+	if (!check_stats(__FUNCTION__, cache, 1, 1, 1, 0))
+		return true;
+
+	SurfaceResource::LockRead<SurfaceSW> lock(task->target_surface);
+	if (!lock || lock->get_surface()[7][7] != Color(0.25, 0.5, 0.75, 1.0)) {
+		std::cerr << __FUNCTION__ << ": loaded frame differs" << std::endl;
+		return true;
+	}
+
+	cache.clear();
+	return false;
+}
+
+//! small subtrees and surfaces bigger than quarter of cache should not be stored
+bool test_limits() {
+	RenderCache cache(cache_path, 4*(pixels_size(32, 32) + 1024), 4);
+	cache.clear();
+
+	Task::List list, stores;
+	list.push_back(create_chain(3, 1.0, 16, 16));
+	list.push_back(create_chain(4, 2.0, 64, 64));
+	cache.process(list, "test", stores);
+	if (list.size() != 2 || !stores.empty()) {
+		std::cerr << __FUNCTION__ << ": expected no stores, but got " << stores.size() << std::endl;
+		return true;
+	}
+	if (!check_stats(__FUNCTION__, cache, 0, 0, 0, 0))
+		return true;
+
+	cache.clear();
+	return false;
+}
+
+//! least recently used files should be removed when cache is full
+bool test_eviction() {
+	// each file takes quarter of cache
+	RenderCache cache(cache_path, 4*(pixels_size(32, 32) + 1024), 4);
+	cache.clear();
+
+	for(int i = 0; i < 5; ++i) {
+		Task::List list, stores;
+		list.push_back(create_chain(4, 1.0 + i, 32, 32));
+		cache.process(list, "test", stores);
+		fill(list.front(), Color(0.0, 0.0, 0.0, 1.0));
+		run_stores(stores);
+	}
+	if (!check_stats(__FUNCTION__, cache, 0, 5, 5, 1))
+		return true;
+
+	// first frame is removed, last is still in cache
+	Task::List list, stores;
+	list.push_back(create_chain(4, 1.0, 32, 32));
+	list.push_back(create_chain(4, 5.0, 32, 32));
+	cache.process(list, "test", stores);
+	if (list.size() != 1 || !check_stats(__FUNCTION__, cache, 1, 6, 5, 1)) {
+		std::cerr << __FUNCTION__ << ": wrong frames was removed" << std::endl;
+		return true;
+	}
+
+	cache.clear();
+	return false;
+}
+
+#define TEST_FUNCTION(function_name) {\
+	fail = function_name(); \
+	if (fail) { \
+		error("%s FAILED", #function_name); \
+		failures++; \
+	} \
+}
+
+int main(int /* argc */, char* argv[]) {
+	String binary_path = etl::dirname(synfig::get_binary_path(argv[0]));
+	synfig::Main synfig_main(binary_path);
+	cache_path = binary_path + ETL_DIRECTORY_SEPARATOR + "rendercache.tmp";
+
+	int failures = 0;
+	bool fail;
+
+	TEST_FUNCTION(test_hit_after_miss)
+	TEST_FUNCTION(test_limits)
+	TEST_FUNCTION(test_eviction)
+
+	if (failures)
+		error("Test finished with %i errors", failures);
+	else
+		info("Success");
+
+	return failures ? 1 : 0;
+}
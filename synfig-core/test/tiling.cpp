@@ -0,0 +1,160 @@
+/* === S Y N F I G ========================================================= */
+/*!	\file test/tiling.cpp
+**	\brief Test of tiled rendering of large frames
+**
+**	\legal
+**	......... ... 2020 Synfig contributors
+**
+**	This package is free software; you can redistribute it and/or
+**	modify it under the terms of the GNU General Public License as
+**	published by the Free Software Foundation; either version 2 of
+**	the License, or (at your option) any later version.
+**
+**	This package is distributed in the hope that it will be useful,
+**	but WITHOUT ANY WARRANTY; without even the implied warranty of
+**	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**	General Public License for more details.
+**	\endlegal
+*/
+/* ========================================================================= */
+
+#include <synfig/canvas.h>
+#include <synfig/color.h>
+#include <synfig/general.h>
+#include <synfig/main.h>
+#include <synfig/surface.h>
+#include <synfig/target_scanline.h>
+#include <synfig/layer.h>
+#include <synfig/rendering/renderer.h>
+
+#include <cmath>
+#include <vector>
+
+#include <iostream>
+
+using namespace std;
+using namespace synfig;
+
+//! Keeps all frames of render in memory
+class TargetMemory: public Target_Scanline
+{
+public:
+	std::vector<synfig::Surface> frames;
+
+	virtual bool start_frame(ProgressCallback * /* cb */)
+	{
+		frames.push_back(synfig::Surface(desc.get_w(), desc.get_h()));
+		return true;
+	}
+	virtual void end_frame() { }
+	virtual Color* start_scanline(int scanline)
+		{ return frames.back()[scanline]; }
+	virtual bool end_scanline()
+		{ return true; }
+};
+
+static Canvas::Handle create_canvas(int width, int height)
+{
+	Canvas::Handle canvas = Canvas::create();
+	RendDesc &desc = canvas->rend_desc();
+	desc.set_wh(width, height);
+	desc.set_tl(Point(-4.0, 4.0*height/width));
+	desc.set_br(Point(4.0, -4.0*height/width));
+	desc.set_frame_rate(24);
+	desc.set_time_start(0);
+	desc.set_time_end(Time(2)/24);
+
+	Layer::Handle background = Layer::create("solid_color");
+	background->set_param("color", Color(0.2, 0.3, 0.4, 1.0));
+	canvas->push_back(background);
+
+	// star crossing borders of tiles
+	ValueBase::List points;
+	for(int i = 0; i < 10; ++i) {
+		Real a = 2.0*PI*i/10;
+		Real r = i % 2 ? 1.0 : 3.0;
+		points.push_back(Point(r*cos(a), r*sin(a)));
+	}
+	Layer::Handle polygon = Layer::create("polygon");
+	polygon->set_param("color", Color(1.0, 0.5, 0.0, 1.0));
+	polygon->set_param("amount", Real(0.75));
+	polygon->set_param("vector_list", points);
+	canvas->push_front(polygon);
+
+	return canvas;
+}
+
+static bool render(const Canvas::Handle &canvas, int tile_size, std::vector<synfig::Surface> &out_frames)
+{
+	rendering::Renderer::set_tile_size(tile_size);
+	etl::handle<TargetMemory> target = new TargetMemory();
+	target->set_engine("software");
+	target->set_canvas(canvas);
+	RendDesc desc = canvas->rend_desc();
+	target->set_rend_desc(&desc);
+	bool success = target->render();
+	out_frames = target->frames;
+	return success;
+}
+
+//! renders frames through Target_Scanline with and without tiling and compares results
+bool test_tiled_target_matches_untiled() {
+	// width and height are not multiple of tile size to check partial tiles
+	Canvas::Handle canvas = create_canvas(700, 500);
+
+	int tile_size = rendering::Renderer::get_tile_size();
+	std::vector<synfig::Surface> expected, value;
+	bool success = render(canvas, 0, expected)
+	            && render(canvas, 128, value);
+	rendering::Renderer::set_tile_size(tile_size);
+
+	if (!success) {
+		std::cerr << __FUNCTION__ << ": rendering failed" << std::endl;
+		return true;
+	}
+	if (expected.size() != 3 || value.size() != expected.size()) {
+		std::cerr << __FUNCTION__ << ": expected 3 frames, but got "
+		          << expected.size() << " and " << value.size() << std::endl;
+		return true;
+	}
+
+	for(int f = 0; f < (int)expected.size(); ++f)
+		for(int y = 0; y < expected[f].get_h(); ++y)
+			for(int x = 0; x < expected[f].get_w(); ++x) {
+				const Color &a = expected[f][y][x], &b = value[f][y][x];
+				if ( std::fabs(a.get_r() - b.get_r()) > 1e-5
+				  || std::fabs(a.get_g() - b.get_g()) > 1e-5
+				  || std::fabs(a.get_b() - b.get_b()) > 1e-5
+				  || std::fabs(a.get_a() - b.get_a()) > 1e-5 )
+				{
+					std::cerr << __FUNCTION__ << ": frame " << f << ", pixel (" << x << ", " << y << ") differs" << std::endl;
+					return true;
+				}
+			}
+
+	return false;
+}
+
+#define TEST_FUNCTION(function_name) {\
+	fail = function_name(); \
+	if (fail) { \
+		error("%s FAILED", #function_name); \
+		failures++; \
+	} \
+}
+
+int main(int /* argc */, char* argv[]) {
+	synfig::Main synfig_main(etl::dirname(synfig::get_binary_path(argv[0])));
+
+	int failures = 0;
+	bool fail;
+
+	TEST_FUNCTION(test_tiled_target_matches_untiled)
+
+	if (failures)
+		error("Test finished with %i errors", failures);
+	else
+		info("Success");
+
+	return failures ? 1 : 0;
+}
@@ -54,9 +54,9 @@ using namespace studio;
  */
 const char* allowed_video_codecs[] =
 {
-	"flv", "h263p", "huffyuv", "libtheora", "libx264", "libx264-lossless",
+	"ffv1", "flv", "h263p", "huffyuv", "libtheora", "libx264", "libx264-lossless",
 	"mjpeg", "mpeg1video", "mpeg2video", "mpeg4", "msmpeg4",
-	"msmpeg4v1", "msmpeg4v2", "wmv1", "wmv2", CUSTOM_VCODEC, NULL
+	"msmpeg4v1", "msmpeg4v2", "prores_ks", "wmv1", "wmv2", CUSTOM_VCODEC, NULL
 };
 
 //! Allowed video codecs description.
@@ -65,6 +65,7 @@ const char* allowed_video_codecs[] =
  */
 const char* allowed_video_codecs_description[] =
 {
+	_("FFV1 lossless video (16-bit RGBA input)"),
 	_("Flash Video (FLV) / Sorenson Spark / Sorenson H.263"),
 	_("H.263+ / H.263-1998 / H.263 version 2"),
 	_("Huffyuv / HuffYUV"),
@@ -78,6 +79,7 @@ const char* allowed_video_codecs_description[] =
 	_("MPEG-4 part 2 Microsoft variant version 3"),
 	_("MPEG-4 part 2 Microsoft variant version 1"),
 	_("MPEG-4 part 2 Microsoft variant version 2"),
+	_("Apple ProRes 4444 (16-bit RGBA input)"),
 	_("Windows Media Video 7"),
 	_("Windows Media Video 8"),
 	CUSTOM_VCODEC_DESCRIPTION,